@@ -47,6 +47,9 @@
 #include "tb-hash.h"
 #include "tb-context.h"
 #include "internal.h"
+#ifdef TARGET_CHERI
+#include "cheri_tagmem.h"
+#endif
 
 /* -icount align implementation. */
 
@@ -150,6 +153,37 @@ static void init_delay_params(SyncClocks *sc, const CPUState *cpu)
 }
 #endif /* CONFIG USER ONLY */
 
+#ifdef CONFIG_TCG_LOG_INSTR
+/*
+ * Apply the instruction trace filter to the cflags used to look up the TB
+ * at pc. TBs outside the filter are translated without logging calls and
+ * are kept apart from the logged copies by CF_LOG_INSTR_FILTERED.
+ *
+ * With an ASID or mode filter, a TB outside the filter may be found again
+ * under an ASID inside it (e.g. shared library or kernel code excluded by
+ * its pc or mode in one process). Its chained jumps and inline caches would
+ * then skip the filter, so such TBs always leave through a lookup instead.
+ * TBs inside the filter only run in matching state and may chain freely.
+ */
+static inline uint32_t log_instr_tb_cflags(CPUArchState *env, target_ulong pc,
+                                           uint32_t cflags)
+{
+    if (unlikely(qemu_log_instr_tb_filter_enabled)) {
+        cflags &= ~CF_LOG_INSTR_FILTERED;
+        if (qemu_log_instr_enabled(env) &&
+            !qemu_log_instr_tb_filter_match(env, pc)) {
+            cflags |= CF_LOG_INSTR_FILTERED;
+            if (qemu_log_instr_tb_filter_stateful) {
+                cflags |= CF_NO_GOTO_TB;
+            }
+        }
+    }
+    return cflags;
+}
+#else
+#define log_instr_tb_cflags(env, pc, cflags) (cflags)
+#endif
+
 uint32_t curr_cflags(CPUState *cpu)
 {
     uint32_t cflags = cpu->tcg_cflags;
@@ -192,8 +226,7 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
     if (likely(tb &&
                tb->pc == pc &&
                tb->cs_base == cs_base &&
-               tb->pcc_base == pcc_base &&
-               tb->pcc_top == pcc_top &&
+               tb_pcc_bounds_match(tb, pcc_base, pcc_top) &&
                tb->cheri_flags == cheri_flags &&
                tb->flags == flags &&
                tb->trace_vcpu_dstate == *cpu->trace_dstate &&
@@ -311,15 +344,7 @@ static bool check_for_breakpoints(CPUState *cpu, target_ulong pc,
     return false;
 }
 
-/**
- * helper_lookup_tb_ptr: quick check for next tb
- * @env: current cpu state
- *
- * Look for an existing TB matching the current cpu state.
- * If found, return the code pointer.  If not found, return
- * the tcg epilogue so that we return into cpu_tb_exec.
- */
-const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
+static inline TranslationBlock *lookup_tb_for_goto_ptr(CPUArchState *env)
 {
     CPUState *cpu = env_cpu(env);
     TranslationBlock *tb;
@@ -330,22 +355,191 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
     cpu_get_tb_cpu_state_ext(env, &pc, &cs_base, &pcc_base, &pcc_top,
                              &cheri_flags, &flags);
 
-    cflags = curr_cflags(cpu);
+    cflags = log_instr_tb_cflags(env, pc, curr_cflags(cpu));
     if (check_for_breakpoints(cpu, pc, &cflags)) {
         cpu_loop_exit(cpu);
     }
 
     tb = tb_lookup(cpu, pc, cs_base, pcc_base, pcc_top, cheri_flags, flags,
                    cflags);
+    if (tb) {
+        log_cpu_exec(pc, cpu, tb);
+    }
+    return tb;
+}
+
+/**
+ * helper_lookup_tb_ptr: quick check for next tb
+ * @env: current cpu state
+ *
+ * Look for an existing TB matching the current cpu state.
+ * If found, return the code pointer.  If not found, return
+ * the tcg epilogue so that we return into cpu_tb_exec.
+ */
+const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
+{
+    TranslationBlock *tb = lookup_tb_for_goto_ptr(env);
+
+    return tb ? tb->tc.ptr : tcg_code_gen_epilogue;
+}
+
+/*
+ * The inline cache only compares the pc (and the guard) of its targets with
+ * the jump destination, so a TB can only be cached if it is the one the
+ * lookup finds on every execution of the jump that reaches its pc.
+ *
+ * Plain jumps leave the rest of the CPU state as it was on entry to @site,
+ * so that holds for TBs with the key of @site apart from pc, as long as the
+ * PCC bounds do not vary: @site may be shared between PCC bounds unless it
+ * is tied to its exact bounds.
+ *
+ * Guarded jumps may also install a new PCC, which the guard and the pc
+ * determine, so the flags that only depend on PCC and the PCC bounds may
+ * differ from @site.
+ */
+static bool tb_ic_cacheable(const TranslationBlock *site,
+                            const TranslationBlock *tb, bool guarded)
+{
+    uint32_t cheri_flags_mask = ~0;
+
+    if (guarded) {
+#ifdef TARGET_CHERI
+        cheri_flags_mask = ~TB_FLAG_CHERI_PCC_FLAGS;
+#endif
+    }
+    if (tb->cs_base != site->cs_base ||
+        ((tb->cheri_flags ^ site->cheri_flags) & cheri_flags_mask) ||
+        tb->flags != site->flags ||
+        tb->trace_vcpu_dstate != site->trace_vcpu_dstate ||
+        (tb_cflags(tb) & ~CF_INVALID) != (tb_cflags(site) & ~CF_INVALID)) {
+        return false;
+    }
+    return guarded || tb_pcc_bounds_cover(site, tb);
+}
+
+/**
+ * helper_lookup_tb_ptr_ic: lookup_tb_ptr for a jump with an inline cache
+ * @env: current cpu state
+ * @site: the TB containing the jump
+ * @guard: value of the guard, if @guarded
+ * @guarded: the jump is guarded, see translator_lookup_and_goto_ptr_guarded()
+ *
+ * Called when the inline cache of @site misses. Add the TB found to the
+ * cache entry of @site, see translator_lookup_and_goto_ptr().
+ */
+const void *HELPER(lookup_tb_ptr_ic)(CPUArchState *env, const void *site,
+                                     uint64_t guard, uint32_t guarded)
+{
+    CPUState *cpu = env_cpu(env);
+    TBICEntry *entry = &cpu->tb_ic[tb_ic_hash_func(
+                                       ((const TranslationBlock *)site)->pc)];
+    TranslationBlock *tb = lookup_tb_for_goto_ptr(env);
+
+    qatomic_set(&cpu->tb_ic_misses, cpu->tb_ic_misses + 1);
     if (tb == NULL) {
         return tcg_code_gen_epilogue;
     }
+    if (tb_ic_cacheable(site, tb, guarded)) {
+        if (entry->site == site) {
+            memmove(&entry->tb[1], &entry->tb[0],
+                    (TB_IC_WAYS - 1) * sizeof(entry->tb[0]));
+            memmove(&entry->guard[1], &entry->guard[0],
+                    (TB_IC_WAYS - 1) * sizeof(entry->guard[0]));
+            entry->tb[0] = tb;
+            entry->guard[0] = guard;
+        } else {
+            for (int i = 0; i < TB_IC_WAYS; i++) {
+                entry->tb[i] = tb;
+                entry->guard[i] = guard;
+            }
+            qatomic_set(&entry->site, site);
+        }
+        qatomic_set(&cpu->tb_ic_fills, cpu->tb_ic_fills + 1);
+    }
+    return tb->tc.ptr;
+}
 
-    log_cpu_exec(pc, cpu, tb);
+/**
+ * helper_lookup_tb_ptr_ras: lookup_tb_ptr for a return
+ * @env: current cpu state
+ * @site: the TB containing the return
+ * @guard: value of the guard, if @guarded
+ * @guarded: the return is guarded
+ *
+ * Called when the return address stack entry popped by @site misses. If the
+ * entry predicted the return address, cache the TB found in it, see
+ * translator_return_and_goto_ptr().
+ */
+const void *HELPER(lookup_tb_ptr_ras)(CPUArchState *env, const void *site,
+                                      uint64_t guard, uint32_t guarded)
+{
+    CPUState *cpu = env_cpu(env);
+    TBRASEntry *entry = &cpu->tb_ras[(cpu->tb_ras_top + 1) % TB_RAS_SIZE];
+    TranslationBlock *tb = lookup_tb_for_goto_ptr(env);
 
+    qatomic_set(&cpu->tb_ras_misses, cpu->tb_ras_misses + 1);
+    if (tb == NULL) {
+        return tcg_code_gen_epilogue;
+    }
+    if (entry->pc == tb->pc && tb_ic_cacheable(site, tb, guarded)) {
+        entry->tb = tb;
+        entry->guard = guard;
+        qatomic_set(&entry->site, site);
+    }
     return tb->tc.ptr;
 }
 
+/*
+ * Clear the inline cache entries with a target that may overlap
+ * [addr, addr + len), like tb_flush_jmp_cache() does for the jump cache.
+ */
+void tb_ic_clear_range(CPUState *cpu, target_ulong addr, target_ulong len)
+{
+    target_ulong start = (addr & TARGET_PAGE_MASK) - TARGET_PAGE_SIZE;
+    target_ulong size = len + (addr & ~TARGET_PAGE_MASK) + TARGET_PAGE_SIZE;
+
+    for (int i = 0; i < TB_IC_SIZE; i++) {
+        TBICEntry *entry = &cpu->tb_ic[i];
+
+        if (!qatomic_read(&entry->site)) {
+            continue;
+        }
+        for (int j = 0; j < TB_IC_WAYS; j++) {
+            if (entry->tb[j]->pc - start < size) {
+                qatomic_set(&entry->site, NULL);
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < TB_RAS_SIZE; i++) {
+        TBRASEntry *entry = &cpu->tb_ras[i];
+
+        if (qatomic_read(&entry->site) && entry->tb->pc - start < size) {
+            qatomic_set(&entry->site, NULL);
+        }
+    }
+}
+
+void tb_ic_counts(size_t *hits, size_t *misses, size_t *fills,
+                  size_t *ras_hits, size_t *ras_misses)
+{
+    CPUState *cpu;
+    size_t h = 0, m = 0, f = 0, rh = 0, rm = 0;
+
+    CPU_FOREACH(cpu) {
+        h += qatomic_read(&cpu->tb_ic_hits);
+        m += qatomic_read(&cpu->tb_ic_misses);
+        f += qatomic_read(&cpu->tb_ic_fills);
+        rh += qatomic_read(&cpu->tb_ras_hits);
+        rm += qatomic_read(&cpu->tb_ras_misses);
+    }
+    *hits = h;
+    *misses = m;
+    *fills = f;
+    *ras_hits = rh;
+    *ras_misses = rm;
+}
+
 /* Execute a TB, and fix up the CPU state afterwards if necessary */
 /*
  * Disable CFI checks.
@@ -456,6 +650,7 @@ void cpu_exec_step_atomic(CPUState *cpu)
         cflags &= ~CF_PARALLEL;
         /* After 1 insn, return and release the exclusive lock. */
         cflags |= CF_NO_GOTO_TB | CF_NO_GOTO_PTR | 1;
+        cflags = log_instr_tb_cflags(env, pc, cflags);
         /*
          * No need to check_for_breakpoints here.
          * We only arrive in cpu_exec_step_atomic after beginning execution
@@ -522,8 +717,9 @@ static bool tb_lookup_cmp(const void *p, const void *d)
     const struct tb_desc *desc = d;
 
     if (tb->pc == desc->pc && tb->page_addr[0] == desc->phys_page1 &&
-        tb->cs_base == desc->cs_base && tb->pcc_base == desc->pcc_base &&
-        tb->pcc_top == desc->pcc_top && tb->cheri_flags == desc->cheri_flags &&
+        tb->cs_base == desc->cs_base &&
+        tb_pcc_bounds_match(tb, desc->pcc_base, desc->pcc_top) &&
+        tb->cheri_flags == desc->cheri_flags &&
         tb->flags == desc->flags &&
         tb->trace_vcpu_dstate == desc->trace_vcpu_dstate &&
         tb_cflags(tb) == desc->cflags) {
@@ -964,6 +1160,10 @@ int cpu_exec(CPUState *cpu)
         if (qemu_mutex_iothread_locked()) {
             qemu_mutex_unlock_iothread();
         }
+#ifdef TARGET_CHERI
+        /* A store in a parallel TB faulted with its tags locked. */
+        cheri_tag_store_abort();
+#endif
         qemu_plugin_disable_mem_helpers(cpu);
 
         assert_no_pages_locked();
@@ -996,6 +1196,7 @@ int cpu_exec(CPUState *cpu)
             } else {
                 cpu->cflags_next_tb = -1;
             }
+            cflags = log_instr_tb_cflags(cpu->env_ptr, pc, cflags);
 
             if (check_for_breakpoints(cpu, pc, &cflags)) {
                 break;
@@ -1008,6 +1209,11 @@ int cpu_exec(CPUState *cpu)
                 tb = tb_gen_code(cpu, pc, cs_base, pcc_base, pcc_top, cheri_flags,
                                  flags, cflags);
                 mmap_unlock();
+#ifdef CONFIG_SOFTMMU
+                if (tb_spec_enabled) {
+                    tb_spec_queue_successors(cpu, tb);
+                }
+#endif
                 /*
                  * We add the TB in the virtual pc hash table
                  * for the fast lookup
@@ -1026,8 +1232,11 @@ int cpu_exec(CPUState *cpu)
                 last_tb = NULL;
             }
 #endif
-            /* See if we can patch the calling TB. */
-            if (last_tb) {
+            /*
+             * See if we can patch the calling TB. The chained jump skips the
+             * lookup, so @tb must be valid for any PCC @last_tb may run with.
+             */
+            if (last_tb && tb_pcc_bounds_cover(last_tb, tb)) {
                 tb_add_jump(last_tb, tb_exit, tb);
             }
 
@@ -114,6 +114,7 @@ static void tb_flush_jmp_cache(CPUState *cpu, target_ulong addr)
        overlap the flushed page.  */
     tb_jmp_cache_clear_page(cpu, addr - TARGET_PAGE_SIZE);
     tb_jmp_cache_clear_page(cpu, addr);
+    tb_ic_clear_range(cpu, addr, TARGET_PAGE_SIZE);
 }
 
 /**
@@ -237,8 +238,10 @@ static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
     desc->large_page_addr = -1;
     desc->large_page_mask = -1;
     desc->vindex = 0;
+    desc->lindex = 0;
     memset(fast->table, -1, sizeof_tlb(fast));
     memset(desc->vtable, -1, sizeof(desc->vtable));
+    memset(desc->ltlb, -1, sizeof(desc->ltlb));
 }
 
 static void tlb_flush_one_mmuidx_locked(CPUArchState *env, int mmu_idx,
@@ -340,6 +343,21 @@ void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
     *pelide = elide;
 }
 
+void tlb_large_page_counts(size_t *prefill, size_t *pflush)
+{
+    CPUState *cpu;
+    size_t refill = 0, flush = 0;
+
+    CPU_FOREACH(cpu) {
+        CPUArchState *env = cpu->env_ptr;
+
+        refill += qatomic_read(&env_tlb(env)->c.large_refill_count);
+        flush += qatomic_read(&env_tlb(env)->c.large_flush_count);
+    }
+    *prefill = refill;
+    *pflush = flush;
+}
+
 static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
 {
     CPUArchState *env = cpu->env_ptr;
@@ -494,6 +512,84 @@ static inline void tlb_flush_vtlb_page_locked(CPUArchState *env, int mmu_idx,
     tlb_flush_vtlb_page_mask_locked(env, mmu_idx, page, -1);
 }
 
+/* Called with tlb_c.lock held */
+static bool tlb_flush_entry_range_locked(CPUTLBEntry *tlb_entry,
+                                         target_ulong addr, target_ulong len)
+{
+    target_ulong cmp[] = {
+        tlb_entry->addr_read, tlb_addr_write(tlb_entry), tlb_entry->addr_code
+    };
+
+    for (int i = 0; i < ARRAY_SIZE(cmp); i++) {
+        if (cmp[i] != -1 && (cmp[i] & TARGET_PAGE_MASK) - addr < len) {
+            memset(tlb_entry, -1, sizeof(*tlb_entry));
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Flush all the pages of the large page @lp from the tlb and forget it.
+ * Called with tlb_c.lock held.
+ */
+static void tlb_flush_large_page_locked(CPUArchState *env, int midx,
+                                        CPUTLBLargeEntry *lp)
+{
+    CPUTLBDesc *d = &env_tlb(env)->d[midx];
+    CPUTLBDescFast *f = &env_tlb(env)->f[midx];
+    target_ulong addr = lp->vaddr;
+    target_ulong size = lp->size;
+    size_t n = tlb_n_entries(f);
+
+    tlb_debug("large page flush midx %d (" TARGET_FMT_lx "+" TARGET_FMT_lx
+              ")\n", midx, addr, size);
+    lp->vaddr = -1;
+    lp->leaf_vaddr = -1;
+
+    /* Visit whichever is fewer, the pages or the tlb entries. */
+    if ((size >> TARGET_PAGE_BITS) > n) {
+        for (size_t i = 0; i < n; i++) {
+            if (tlb_flush_entry_range_locked(&f->table[i], addr, size)) {
+                tlb_n_used_entries_dec(env, midx);
+            }
+        }
+    } else {
+        for (target_ulong i = 0; i < size; i += TARGET_PAGE_SIZE) {
+            if (tlb_flush_entry_locked(tlb_entry(env, midx, addr + i),
+                                       addr + i)) {
+                tlb_n_used_entries_dec(env, midx);
+            }
+        }
+    }
+    for (int k = 0; k < CPU_VTLB_SIZE; k++) {
+        if (tlb_flush_entry_range_locked(&d->vtable[k], addr, size)) {
+            tlb_n_used_entries_dec(env, midx);
+        }
+    }
+    qatomic_set(&env_tlb(env)->c.large_flush_count,
+                env_tlb(env)->c.large_flush_count + 1);
+}
+
+/*
+ * Flush the large pages in ltlb that overlap [addr, addr + len).
+ * Called with tlb_c.lock held.
+ */
+static void tlb_flush_large_pages_locked(CPUArchState *env, int midx,
+                                         target_ulong addr, target_ulong len)
+{
+    CPUTLBDesc *d = &env_tlb(env)->d[midx];
+
+    for (int i = 0; i < CPU_LTLB_SIZE; i++) {
+        CPUTLBLargeEntry *lp = &d->ltlb[i];
+
+        if (lp->vaddr != -1 &&
+            (lp->vaddr - addr < len || addr - lp->vaddr < lp->size)) {
+            tlb_flush_large_page_locked(env, midx, lp);
+        }
+    }
+}
+
 static void tlb_flush_page_locked(CPUArchState *env, int midx,
                                   target_ulong page)
 {
@@ -507,6 +603,7 @@ static void tlb_flush_page_locked(CPUArchState *env, int midx,
                   midx, lp_addr, lp_mask);
         tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
     } else {
+        tlb_flush_large_pages_locked(env, midx, page, TARGET_PAGE_SIZE);
         if (tlb_flush_entry_locked(tlb_entry(env, midx, page), page)) {
             tlb_n_used_entries_dec(env, midx);
         }
@@ -746,6 +843,7 @@ static void tlb_flush_range_locked(CPUArchState *env, int midx,
         tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
         return;
     }
+    tlb_flush_large_pages_locked(env, midx, addr, len);
 
     for (target_ulong i = 0; i < len; i += TARGET_PAGE_SIZE) {
         target_ulong page = addr + i;
@@ -794,8 +892,10 @@ static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
     }
 
     for (target_ulong i = 0; i < d.len; i += TARGET_PAGE_SIZE) {
-        tb_flush_jmp_cache(cpu, d.addr + i);
+        tb_jmp_cache_clear_page(cpu, d.addr + i - TARGET_PAGE_SIZE);
+        tb_jmp_cache_clear_page(cpu, d.addr + i);
     }
+    tb_ic_clear_range(cpu, d.addr, d.len);
 }
 
 static void tlb_flush_range_by_mmuidx_async_1(CPUState *cpu,
@@ -1039,11 +1139,33 @@ void tlb_reset_dirty(CPUState *cpu, ram_addr_t start1, ram_addr_t length)
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 }
 
+#ifdef TARGET_CHERI
+/*
+ * With parallel TBs, data stores to a page with a populated tag block have to
+ * write their data and clear the tag with the granule locked (see
+ * cheri_tag_stores_locked()). Such pages keep TLB_NOTDIRTY even once they are
+ * dirty, which sends the stores to them to store_helper(), while stores to
+ * pages that have never held a tag stay in the fast path.
+ */
+static inline bool tlb_cheri_tags_locked(CPUState *cpu,
+                                         CPUIOTLBEntry *iotlbentry)
+{
+    return (cpu->tcg_cflags & CF_PARALLEL) &&
+           IOTLB_GET_TAGMEM(iotlbentry, write) != ALL_ZERO_TAGBLK;
+}
+#endif
+
 /* Called with tlb_c.lock held */
-static inline void tlb_set_dirty1_locked(CPUTLBEntry *tlb_entry,
+static inline void tlb_set_dirty1_locked(CPUState *cpu, CPUTLBEntry *tlb_entry,
+                                         CPUIOTLBEntry *iotlbentry,
                                          target_ulong vaddr)
 {
     if (tlb_entry->addr_write == (vaddr | TLB_NOTDIRTY)) {
+#ifdef TARGET_CHERI
+        if (tlb_cheri_tags_locked(cpu, iotlbentry)) {
+            return;
+        }
+#endif
         tlb_entry->addr_write = vaddr;
     }
 }
@@ -1060,22 +1182,26 @@ void tlb_set_dirty(CPUState *cpu, target_ulong vaddr)
     vaddr &= TARGET_PAGE_MASK;
     qemu_spin_lock(&env_tlb(env)->c.lock);
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
-        tlb_set_dirty1_locked(tlb_entry(env, mmu_idx, vaddr), vaddr);
+        uintptr_t index = tlb_index(env, mmu_idx, vaddr);
+
+        tlb_set_dirty1_locked(cpu, tlb_entry(env, mmu_idx, vaddr),
+                              &env_tlb(env)->d[mmu_idx].iotlb[index], vaddr);
     }
 
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
         int k;
         for (k = 0; k < CPU_VTLB_SIZE; k++) {
-            tlb_set_dirty1_locked(&env_tlb(env)->d[mmu_idx].vtable[k], vaddr);
+            tlb_set_dirty1_locked(cpu, &env_tlb(env)->d[mmu_idx].vtable[k],
+                                  &env_tlb(env)->d[mmu_idx].viotlb[k], vaddr);
         }
     }
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 }
 
-/* Our TLB does not support large pages, so remember the area covered by
-   large pages and trigger a full TLB flush if these are invalidated.  */
-static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
-                               target_ulong vaddr, target_ulong size)
+/* Remember the area covered by large pages that are no longer in ltlb
+   and trigger a full TLB flush if these are invalidated.  */
+static void tlb_add_large_page_region(CPUArchState *env, int mmu_idx,
+                                      target_ulong vaddr, target_ulong size)
 {
     target_ulong lp_addr = env_tlb(env)->d[mmu_idx].large_page_addr;
     target_ulong lp_mask = ~(size - 1);
@@ -1096,16 +1222,85 @@ static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
     env_tlb(env)->d[mmu_idx].large_page_mask = lp_mask;
 }
 
+/*
+ * Our TLB does not support large pages, so remember the large page in ltlb
+ * to flush all of its pages together and, if the target reported its leaf,
+ * to refill the leaf's pages without calling tlb_fill, see
+ * tlb_fill_large_page().  The arguments are those passed to
+ * tlb_set_page_leaf for one of its pages.
+ * Called with tlb_c.lock held.
+ */
+static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
+                               target_ulong vaddr, hwaddr paddr,
+                               MemTxAttrs attrs, int prot, target_ulong size,
+                               target_ulong leaf_size)
+{
+    CPUTLBDesc *d = &env_tlb(env)->d[mmu_idx];
+    target_ulong lp_vaddr = vaddr & ~(size - 1);
+    CPUTLBLargeEntry *lp = NULL;
+
+    for (int i = 0; i < CPU_LTLB_SIZE; i++) {
+        if (d->ltlb[i].vaddr == lp_vaddr && d->ltlb[i].size == size) {
+            lp = &d->ltlb[i];
+            break;
+        }
+    }
+    if (!lp) {
+        /* Any overlapping large page is stale. */
+        tlb_flush_large_pages_locked(env, mmu_idx, lp_vaddr, size);
+        lp = &d->ltlb[d->lindex++ % CPU_LTLB_SIZE];
+        if (lp->vaddr != -1) {
+            tlb_add_large_page_region(env, mmu_idx, lp->vaddr, lp->size);
+        }
+    }
+
+    lp->vaddr = lp_vaddr;
+    lp->size = size;
+    if (leaf_size <= TARGET_PAGE_SIZE) {
+        lp->leaf_vaddr = -1;
+        return;
+    }
+    leaf_size = MIN(leaf_size, size);
+    lp->leaf_vaddr = vaddr & ~(leaf_size - 1);
+    lp->leaf_size = leaf_size;
+    lp->paddr = (paddr & TARGET_PAGE_MASK) -
+                ((vaddr & TARGET_PAGE_MASK) - lp->leaf_vaddr);
+    /* Tag memory is only allocated when filling for a tag store. */
+    attrs.tag_setting = 0;
+    lp->attrs = attrs;
+    lp->prot = prot;
+}
+
+/*
+ * Whether the page of the valid entry @te is part of a leaf in ltlb, and
+ * so can be refilled without tlb_fill.  Called with tlb_c.lock held.
+ */
+static bool tlb_entry_in_large_leaf_locked(CPUTLBDesc *d, CPUTLBEntry *te)
+{
+    /* Unused comparators are -1 and do not change the page bits. */
+    target_ulong page = te->addr_read & tlb_addr_write(te) & te->addr_code &
+                        TARGET_PAGE_MASK;
+
+    for (int i = 0; i < CPU_LTLB_SIZE; i++) {
+        if (d->ltlb[i].leaf_vaddr != -1 &&
+            page - d->ltlb[i].leaf_vaddr < d->ltlb[i].leaf_size) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /* Add a new TLB entry. At most one entry for a given virtual address
  * is permitted. Only a single TARGET_PAGE_SIZE region is mapped, the
- * supplied size is only used by tlb_flush_page.
+ * supplied size is used by tlb_flush_page and leaf_size to refill the
+ * other pages of a large page.
  *
  * Called from TCG-generated code, which is under an RCU read-side
  * critical section.
  */
-void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
-                             hwaddr paddr, MemTxAttrs attrs, int prot,
-                             int mmu_idx, target_ulong size)
+void tlb_set_page_leaf(CPUState *cpu, target_ulong vaddr,
+                       hwaddr paddr, MemTxAttrs attrs, int prot,
+                       int mmu_idx, target_ulong size, target_ulong leaf_size)
 {
     CPUArchState *env = cpu->env_ptr;
     CPUTLB *tlb = env_tlb(env);
@@ -1120,16 +1315,12 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
     target_ulong vaddr_page;
     int asidx = cpu_asidx_from_attrs(cpu, attrs);
     int wp_flags;
+    int target_prot = prot;
     bool is_ram, is_romd;
 
     assert_cpu_is_self(cpu);
 
-    if (size <= TARGET_PAGE_SIZE) {
-        sz = TARGET_PAGE_SIZE;
-    } else {
-        tlb_add_large_page(env, mmu_idx, vaddr, size);
-        sz = size;
-    }
+    sz = MAX(size, TARGET_PAGE_SIZE);
     vaddr_page = vaddr & TARGET_PAGE_MASK;
     paddr_page = paddr & TARGET_PAGE_MASK;
 
@@ -1185,6 +1376,13 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
             } else if (cpu_physical_memory_is_clean(iotlb)) {
                 write_address |= TLB_NOTDIRTY;
             }
+#ifdef TARGET_CHERI
+            /* See tlb_cheri_tags_locked(). */
+            if (!section->readonly && (cpu->tcg_cflags & CF_PARALLEL) &&
+                (void *)tagmem != ALL_ZERO_TAGBLK) {
+                write_address |= TLB_NOTDIRTY;
+            }
+#endif
         }
     } else {
         /* I/O or ROMD */
@@ -1218,20 +1416,29 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
     /* Note that the tlb is no longer clean.  */
     tlb->c.dirty |= 1 << mmu_idx;
 
+    if (size > TARGET_PAGE_SIZE) {
+        tlb_add_large_page(env, mmu_idx, vaddr, paddr, attrs, target_prot,
+                           size, leaf_size);
+    }
+
     /* Make sure there's no cached translation for the new page.  */
     tlb_flush_vtlb_page_locked(env, mmu_idx, vaddr_page);
 
     /*
      * Only evict the old entry to the victim tlb if it's for a
      * different page; otherwise just overwrite the stale data.
+     * The pages of a leaf in ltlb are refilled from there, so a large
+     * mapping takes up one ltlb entry rather than the victim tlb.
      */
     if (!tlb_hit_page_anyprot(te, vaddr_page) && !tlb_entry_is_empty(te)) {
-        unsigned vidx = desc->vindex++ % CPU_VTLB_SIZE;
-        CPUTLBEntry *tv = &desc->vtable[vidx];
+        if (!tlb_entry_in_large_leaf_locked(desc, te)) {
+            unsigned vidx = desc->vindex++ % CPU_VTLB_SIZE;
+            CPUTLBEntry *tv = &desc->vtable[vidx];
 
-        /* Evict the old entry into the victim tlb.  */
-        copy_tlb_helper_locked(tv, te);
-        desc->viotlb[vidx] = desc->iotlb[index];
+            /* Evict the old entry into the victim tlb.  */
+            copy_tlb_helper_locked(tv, te);
+            desc->viotlb[vidx] = desc->iotlb[index];
+        }
         tlb_n_used_entries_dec(env, mmu_idx);
     }
 
@@ -1309,6 +1516,15 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
     qemu_spin_unlock(&tlb->c.lock);
 }
 
+/* Add a new TLB entry, without a leaf that may be refilled from ltlb. */
+void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
+                             hwaddr paddr, MemTxAttrs attrs, int prot,
+                             int mmu_idx, target_ulong size)
+{
+    tlb_set_page_leaf(cpu, vaddr, paddr, attrs, prot, mmu_idx, size,
+                      TARGET_PAGE_SIZE);
+}
+
 /* Add a new TLB entry, but without specifying the memory
  * transaction attributes to be used.
  */
@@ -1332,6 +1548,51 @@ static inline ram_addr_t qemu_ram_addr_from_host_nofail(void *ptr)
     return ram_addr;
 }
 
+/*
+ * Refill the TLB entry for addr from a large page in ltlb, which saves the
+ * page table walk of tlb_fill.  Return false if addr is not part of the
+ * leaf of a large page, or the leaf does not permit the access.
+ */
+static bool tlb_fill_large_page(CPUState *cpu, target_ulong addr,
+                                MMUAccessType access_type, int mmu_idx)
+{
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLBDesc *d = &env_tlb(env)->d[mmu_idx];
+    target_ulong page = addr & TARGET_PAGE_MASK;
+    int prot;
+
+    switch (access_type) {
+    case MMU_DATA_LOAD:
+    case MMU_DATA_CAP_LOAD:
+        prot = PAGE_READ;
+        break;
+    case MMU_DATA_STORE:
+        prot = PAGE_WRITE;
+        break;
+    case MMU_INST_FETCH:
+        prot = PAGE_EXEC;
+        break;
+    default:
+        /* Capability stores may need tlb_fill to allocate tag memory. */
+        return false;
+    }
+
+    for (int i = 0; i < CPU_LTLB_SIZE; i++) {
+        CPUTLBLargeEntry lp = d->ltlb[i];
+
+        if (lp.leaf_vaddr != -1 &&
+            addr - lp.leaf_vaddr < lp.leaf_size && (lp.prot & prot) == prot) {
+            tlb_set_page_leaf(cpu, page, lp.paddr + (page - lp.leaf_vaddr),
+                              lp.attrs, lp.prot, mmu_idx, lp.size,
+                              lp.leaf_size);
+            qatomic_set(&env_tlb(env)->c.large_refill_count,
+                        env_tlb(env)->c.large_refill_count + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
 /*
  * Note: tlb_fill() can trigger a resize of the TLB. This means that all of the
  * caller's prior references to the TLB table (e.g. CPUTLBEntry pointers) must
@@ -1343,6 +1604,10 @@ static void tlb_fill(CPUState *cpu, target_ulong addr, int size,
     CPUClass *cc = CPU_GET_CLASS(cpu);
     bool ok;
 
+    if (tlb_fill_large_page(cpu, addr, access_type, mmu_idx)) {
+        return;
+    }
+
     /*
      * This is not a probe, so only valid return is success; failure
      * should result in exception + longjmp to the cpu loop.
@@ -1599,6 +1864,14 @@ static void notdirty_write(CPUState *cpu, vaddr mem_vaddr, unsigned size,
 {
     ram_addr_t ram_addr = mem_vaddr + iotlbentry->addr;
 
+#ifdef TARGET_CHERI
+    /* Only pages with tags stay TLB_NOTDIRTY once dirty, nothing to do. */
+    if (tlb_cheri_tags_locked(cpu, iotlbentry) &&
+        !cpu_physical_memory_is_clean(ram_addr)) {
+        return;
+    }
+#endif
+
     trace_memory_notdirty_write_access(mem_vaddr, ram_addr, size);
 
     if (!cpu_physical_memory_get_dirty_flag(ram_addr, DIRTY_MEMORY_CODE)) {
@@ -1672,7 +1945,8 @@ probe_access_internal(CPUArchState *env, target_ulong addr, int fault_size,
             CPUState *cs = env_cpu(env);
             CPUClass *cc = CPU_GET_CLASS(cs);
 
-            if (!cc->tcg_ops->tlb_fill(cs, addr, fault_size, access_type,
+            if (!tlb_fill_large_page(cs, addr, access_type, mmu_idx) &&
+                !cc->tcg_ops->tlb_fill(cs, addr, fault_size, access_type,
                                        mmu_idx, nonfault, retaddr)) {
                 /* Non-faulting page table read failed.  */
                 *phost = NULL;
@@ -2558,6 +2832,16 @@ store_helper(CPUArchState *env, target_ulong addr, uint64_t val,
 
         haddr = (void *)((uintptr_t)addr + entry->addend);
 
+#ifdef TARGET_CHERI
+        /* Handle pages with tags, see tlb_cheri_tags_locked(). */
+        bool tags_locked = (tlb_addr & TLB_NOTDIRTY) &&
+                           tlb_cheri_tags_locked(env_cpu(env), iotlbentry) &&
+                           cheri_tag_stores_locked(env_cpu(env));
+        if (tags_locked) {
+            cheri_tag_write_lock(haddr);
+        }
+#endif
+
         /*
          * Keep these two store_memop separate to ensure that the compiler
          * is able to fold the entire function to a single instruction.
@@ -2568,6 +2852,12 @@ store_helper(CPUArchState *env, target_ulong addr, uint64_t val,
         } else {
             store_memop(haddr, val, op);
         }
+#ifdef TARGET_CHERI
+        if (tags_locked) {
+            cheri_tag_update_locked(env, addr, mmu_idx, false);
+            cheri_tag_write_unlock(haddr);
+        }
+#endif
         return;
     }
 
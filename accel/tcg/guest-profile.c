@@ -0,0 +1,130 @@
+/*
+ * Statistical guest profiler for TCG
+ *
+ * A host timer periodically asks every vCPU to record the guest pc it is
+ * about to execute. The sample is taken by the vCPU thread between TBs, so
+ * translated code is unchanged and the overhead only depends on the
+ * sampling frequency.
+ *
+ * Samples are written in the `perf script` text format, so the output can
+ * be fed to the FlameGraph scripts or imported in speedscope and similar
+ * tools. Symbols are resolved from the ELF images loaded by the machine
+ * (-kernel, -bios), see lookup_symbol().
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/error-report.h"
+#include "qemu/notify.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "qapi/error.h"
+#include "hw/core/cpu.h"
+#include "disas/disas.h"
+#include "exec/exec-all.h"
+#ifdef CONFIG_TCG_LOG_INSTR
+#include "exec/log_instr.h"
+#endif
+#include "sysemu/runstate.h"
+#include "sysemu/sysemu.h"
+#include "sysemu/tcg.h"
+
+static struct {
+    FILE *out;
+    /* Serialises output from the vCPU threads */
+    QemuMutex lock;
+    QEMUTimer *timer;
+    int64_t period_ns;
+    Notifier exit_notifier;
+} guest_profile;
+
+static void guest_profile_sample(CPUState *cpu, run_on_cpu_data data)
+{
+    CPUArchState *env = cpu->env_ptr;
+    target_ulong cs_base, pcc_base = 0, pcc_top = 0, pc;
+    uint32_t cheri_flags = 0;
+    uint32_t flags;
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    unsigned asid = 0;
+    bool user = false;
+    const char *sym;
+
+    cpu_get_tb_cpu_state_ext(env, &pc, &cs_base, &pcc_base, &pcc_top,
+                             &cheri_flags, &flags);
+#ifdef CONFIG_TCG_LOG_INSTR
+    asid = cpu_get_asid(env, pc);
+    user = cpu_in_user_mode(env);
+#endif
+    if (cpu->halted) {
+        sym = "[idle]";
+    } else {
+        sym = lookup_symbol(pc);
+        if (*sym == '\0') {
+            sym = "[unknown]";
+        }
+    }
+
+    qemu_mutex_lock(&guest_profile.lock);
+    if (guest_profile.out) {
+        fprintf(guest_profile.out,
+                "qemu %u/%u [%03d] %" PRId64 ".%06" PRId64 ": 1 cpu-clock:%s:\n"
+                "\t%16" PRIx64 " %s (%s)\n\n",
+                asid, asid, cpu->cpu_index,
+                now / NANOSECONDS_PER_SECOND,
+                (now % NANOSECONDS_PER_SECOND) / SCALE_US,
+                user ? "u" : "k", (uint64_t)pc, sym,
+                user ? "[user]" : "[kernel]");
+    }
+    qemu_mutex_unlock(&guest_profile.lock);
+}
+
+static void guest_profile_tick(void *opaque)
+{
+    CPUState *cpu;
+
+    if (runstate_is_running()) {
+        CPU_FOREACH(cpu) {
+            async_run_on_cpu(cpu, guest_profile_sample, RUN_ON_CPU_NULL);
+        }
+    }
+    timer_mod(guest_profile.timer,
+              qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + guest_profile.period_ns);
+}
+
+static void guest_profile_exit(Notifier *n, void *data)
+{
+    timer_del(guest_profile.timer);
+    qemu_mutex_lock(&guest_profile.lock);
+    fclose(guest_profile.out);
+    guest_profile.out = NULL;
+    qemu_mutex_unlock(&guest_profile.lock);
+}
+
+void tcg_guest_profile_start(const char *path, uint64_t freq, Error **errp)
+{
+    if (guest_profile.out) {
+        error_setg(errp, "Guest profiling is already active");
+        return;
+    }
+    if (freq == 0 || freq > NANOSECONDS_PER_SECOND) {
+        error_setg(errp, "Invalid guest profile frequency %" PRIu64, freq);
+        return;
+    }
+    guest_profile.out = fopen(path, "w");
+    if (guest_profile.out == NULL) {
+        error_setg_errno(errp, errno, "Could not open guest profile '%s'",
+                         path);
+        return;
+    }
+
+    qemu_mutex_init(&guest_profile.lock);
+    guest_profile.period_ns = NANOSECONDS_PER_SECOND / freq;
+    guest_profile.timer = timer_new_ns(QEMU_CLOCK_REALTIME,
+                                       guest_profile_tick, NULL);
+    timer_mod(guest_profile.timer,
+              qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + guest_profile.period_ns);
+    guest_profile.exit_notifier.notify = guest_profile_exit;
+    qemu_add_exit_notifier(&guest_profile.exit_notifier);
+}
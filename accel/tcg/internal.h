@@ -20,4 +20,43 @@ void QEMU_NORETURN cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 void page_init(void);
 void tb_htable_init(void);
 
+/* cpu-exec.c */
+void tb_ic_clear_range(CPUState *cpu, target_ulong addr, target_ulong len);
+void tb_ic_counts(size_t *hits, size_t *misses, size_t *fills,
+                  size_t *ras_hits, size_t *ras_misses);
+
+#ifdef CONFIG_SOFTMMU
+/* tb-profile.c */
+extern bool tb_profile_enabled;
+void tb_profile_init(const char *path);
+void tb_profile_record(CPUState *cpu, TranslationBlock *tb,
+                       tb_page_addr_t phys_pc, tb_page_addr_t phys_page2);
+void tb_profile_dump_info(GString *buf);
+
+/* tb-spec.c */
+extern bool tb_spec_enabled;
+void tb_spec_init(unsigned nthreads);
+void tb_spec_queue_successors(CPUState *cpu, TranslationBlock *tb);
+void tb_spec_queue(CPUState *cpu, target_ulong pc, target_ulong cs_base,
+                   target_ulong pcc_base, target_ulong pcc_top,
+                   uint32_t cheri_flags, uint32_t flags, uint32_t cflags,
+                   tb_page_addr_t phys_pc);
+void tb_spec_flush_begin(void);
+void tb_spec_flush_end(void);
+void tb_spec_dump_info(GString *buf);
+
+/* translate-all.c */
+TranslationBlock *tb_gen_code_background(CPUState *cpu, target_ulong pc,
+                                         target_ulong cs_base,
+                                         target_ulong pcc_base,
+                                         target_ulong pcc_top,
+                                         uint32_t cheri_flags, uint32_t flags,
+                                         int cflags, tb_page_addr_t phys_pc,
+                                         const void *host_page);
+bool tb_exists_phys(CPUState *cpu, target_ulong pc, target_ulong cs_base,
+                    target_ulong pcc_base, target_ulong pcc_top,
+                    uint32_t cheri_flags, uint32_t flags, uint32_t cflags,
+                    tb_page_addr_t phys_pc);
+#endif
+
 #endif /* ACCEL_TCG_INTERNAL_H */
@@ -34,7 +34,12 @@
 
 #include "qemu/osdep.h"
 #include "qemu/range.h"
+#include "qemu/cutils.h"
+#include "qemu/xxhash.h"
+#include "qapi/error.h"
 #include "qemu/log.h"
+#include "qemu/thread.h"
+#include "qemu/units.h"
 #include "cpu-param.h"
 #include "cpu.h"
 #include "exec/exec-all.h"
@@ -46,6 +51,9 @@
 #include "exec/translator.h"
 #include "tcg/tcg.h"
 #include "tcg/tcg-op.h"
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
 
 /*
  * CHERI common instruction logging.
@@ -540,6 +548,421 @@ static void emit_cvtrace_stop(CPUArchState *env, target_ulong pc)
     // TODO(am2419) Emit an event for instruction logging stop
 }
 
+/* Binary trace format emitters */
+
+/*
+ * The binary trace format is designed to be cheap to produce: each vCPU
+ * serializes fixed-layout records into a private single-producer
+ * single-consumer ring buffer and a dedicated writer thread drains all the
+ * rings to the log file (optionally compressing the stream with zstd).
+ * Records are in host byte order, which is recorded in the file header.
+ *
+ * Each record starts with a binary_trace_entry_t header, followed by
+ * nregs binary_trace_reg_t, nmem binary_trace_mem_t and text_len bytes of
+ * extra text, padded to a multiple of 8 bytes. The text is truncated so that
+ * the record size fits in 16 bits; records are never dropped.
+ */
+#define BTE_QEMU_MAGIC      "QEMUBinTraceV01"
+#define BTE_BYTE_ORDER_MARK 0x01020304
+
+typedef struct {
+    char magic[16];
+    uint32_t byte_order;
+    uint16_t target_long_bits;
+    uint16_t max_insn_size;
+} binary_trace_header_t;
+
+typedef struct {
+    uint16_t size;      /* Size of the record including the payload */
+    uint8_t type;
+#define BTE_INSN  1
+#define BTE_START 2
+#define BTE_STOP  3
+    uint8_t flags;      /* LI_FLAG_* */
+    uint16_t cpu;
+    uint16_t asid;
+    uint8_t nregs;
+    uint8_t nmem;
+    uint8_t insn_size;
+    uint8_t next_cpu_mode;
+    uint32_t intr_code;
+    uint64_t pc;
+    uint64_t intr_vector;
+    uint64_t intr_faultaddr;
+    uint16_t text_len;
+    uint8_t insn_bytes[QEMU_ALIGN_UP(TARGET_MAX_INSN_SIZE + 2, 8) - 2];
+} binary_trace_entry_t;
+
+typedef struct {
+    uint16_t index;
+    uint8_t flags;      /* LRI_* */
+    uint8_t tag;
+    uint32_t pad;
+    uint64_t value;     /* GPR value or capability cursor */
+    uint64_t pesbt;     /* Capability PESBT (in-memory format) */
+} binary_trace_reg_t;
+
+typedef struct {
+    uint8_t flags;      /* LMI_* */
+    uint8_t size;
+    uint8_t tag;
+    uint8_t pad[5];
+    uint64_t addr;
+    uint64_t value;     /* Data value or capability cursor */
+    uint64_t pesbt;     /* Capability PESBT (in-memory format) */
+} binary_trace_mem_t;
+
+QEMU_BUILD_BUG_ON(sizeof(binary_trace_entry_t) % 8 != 0);
+
+/* Largest record that can be described by binary_trace_entry_t.size */
+#define BINARY_RECORD_MAX_SIZE ROUND_DOWN(UINT16_MAX, 8)
+
+/* Default per-cpu ring size, must be a power of two */
+#define BINARY_RING_SIZE (4 * MiB)
+/* Any record must fit while the writer drains the other half of the ring */
+QEMU_BUILD_BUG_ON(BINARY_RECORD_MAX_SIZE > BINARY_RING_SIZE / 2);
+QEMU_BUILD_BUG_ON(sizeof(binary_trace_entry_t) +
+                  UINT8_MAX * (sizeof(binary_trace_reg_t) +
+                               sizeof(binary_trace_mem_t)) >
+                  BINARY_RECORD_MAX_SIZE);
+/* Interval for the writer thread to drain partially filled rings */
+#define BINARY_WRITER_INTERVAL_MS 100
+
+struct qemu_log_binary_ring {
+    uint8_t *buf;
+    size_t size;
+    /* Free-running producer position, only written by the vCPU thread */
+    size_t head;
+    /* Free-running consumer position, only written by the writer thread */
+    size_t tail;
+    /* Set by the writer thread after freeing ring space */
+    QemuEvent drained;
+};
+
+static struct {
+    bool started;
+    bool stopping;
+    bool compress;
+    QemuThread thread;
+    QemuSemaphore wakeup;
+    bool wakeup_pending;
+    QemuMutex lock; /* protects rings */
+    GPtrArray *rings;
+#ifdef CONFIG_ZSTD
+    ZSTD_CStream *zstream;
+    uint8_t *zbuf;
+    size_t zbuf_size;
+#endif
+} binary_trace;
+
+static void binary_trace_write(FILE *logfile, const void *data, size_t len)
+{
+#ifdef CONFIG_ZSTD
+    if (binary_trace.compress) {
+        ZSTD_inBuffer in = { data, len, 0 };
+        while (in.pos < in.size) {
+            ZSTD_outBuffer out = { binary_trace.zbuf, binary_trace.zbuf_size, 0 };
+            size_t ret = ZSTD_compressStream(binary_trace.zstream, &out, &in);
+            if (ZSTD_isError(ret)) {
+                error_report("binary trace compression failed: %s",
+                             ZSTD_getErrorName(ret));
+                return;
+            }
+            fwrite(binary_trace.zbuf, out.pos, 1, logfile);
+        }
+        return;
+    }
+#endif
+    fwrite(data, len, 1, logfile);
+}
+
+#ifdef CONFIG_ZSTD
+static void binary_trace_flush_zstd(FILE *logfile, bool end)
+{
+    size_t ret;
+
+    do {
+        ZSTD_outBuffer out = { binary_trace.zbuf, binary_trace.zbuf_size, 0 };
+        ret = end ? ZSTD_endStream(binary_trace.zstream, &out)
+                  : ZSTD_flushStream(binary_trace.zstream, &out);
+        if (ZSTD_isError(ret)) {
+            error_report("binary trace compression failed: %s",
+                         ZSTD_getErrorName(ret));
+            return;
+        }
+        fwrite(binary_trace.zbuf, out.pos, 1, logfile);
+    } while (ret != 0);
+}
+#endif
+
+/*
+ * Drain all the per-cpu rings to the log file.
+ * Returns the number of bytes written.
+ */
+static size_t binary_trace_drain(void)
+{
+    size_t total = 0;
+    FILE *logfile = qemu_log_lock();
+
+    qemu_mutex_lock(&binary_trace.lock);
+    for (int i = 0; i < binary_trace.rings->len; i++) {
+        struct qemu_log_binary_ring *ring =
+            g_ptr_array_index(binary_trace.rings, i);
+        size_t head = qatomic_load_acquire(&ring->head);
+        size_t tail = ring->tail;
+
+        if (head == tail) {
+            continue;
+        }
+        if (logfile) {
+            size_t start = tail & (ring->size - 1);
+            size_t len = head - tail;
+            size_t first = MIN(len, ring->size - start);
+            binary_trace_write(logfile, ring->buf + start, first);
+            if (first < len) {
+                binary_trace_write(logfile, ring->buf, len - first);
+            }
+        }
+        total += head - tail;
+        qatomic_store_release(&ring->tail, head);
+        qemu_event_set(&ring->drained);
+    }
+    qemu_mutex_unlock(&binary_trace.lock);
+#ifdef CONFIG_ZSTD
+    if (total && logfile && binary_trace.compress) {
+        binary_trace_flush_zstd(logfile, false);
+    }
+#endif
+    qemu_log_unlock(logfile);
+    return total;
+}
+
+static void *binary_trace_writer_thread(void *arg)
+{
+    binary_trace_header_t header = {
+        .byte_order = BTE_BYTE_ORDER_MARK,
+        .target_long_bits = TARGET_LONG_BITS,
+        .max_insn_size = TARGET_MAX_INSN_SIZE,
+    };
+    FILE *logfile;
+
+    rcu_register_thread();
+    g_strlcpy(header.magic, BTE_QEMU_MAGIC, sizeof(header.magic));
+    logfile = qemu_log_lock();
+    if (logfile) {
+        binary_trace_write(logfile, &header, sizeof(header));
+    }
+    qemu_log_unlock(logfile);
+
+    while (!qatomic_read(&binary_trace.stopping)) {
+        qemu_sem_timedwait(&binary_trace.wakeup, BINARY_WRITER_INTERVAL_MS);
+        qatomic_set(&binary_trace.wakeup_pending, false);
+        binary_trace_drain();
+    }
+    binary_trace_drain();
+#ifdef CONFIG_ZSTD
+    if (binary_trace.compress) {
+        logfile = qemu_log_lock();
+        if (logfile) {
+            binary_trace_flush_zstd(logfile, true);
+        }
+        qemu_log_unlock(logfile);
+    }
+#endif
+    rcu_unregister_thread();
+    return NULL;
+}
+
+static void binary_trace_shutdown(void)
+{
+    qatomic_set(&binary_trace.stopping, true);
+    qemu_sem_post(&binary_trace.wakeup);
+    qemu_thread_join(&binary_trace.thread);
+    qemu_log_flush();
+}
+
+static inline void binary_trace_kick_writer(void)
+{
+    if (!qatomic_xchg(&binary_trace.wakeup_pending, true)) {
+        qemu_sem_post(&binary_trace.wakeup);
+    }
+}
+
+static struct qemu_log_binary_ring *binary_ring_new(void)
+{
+    struct qemu_log_binary_ring *ring = g_new0(struct qemu_log_binary_ring, 1);
+
+    ring->size = BINARY_RING_SIZE;
+    ring->buf = g_malloc(ring->size);
+    qemu_event_init(&ring->drained, false);
+
+    qemu_mutex_lock(&binary_trace.lock);
+    g_ptr_array_add(binary_trace.rings, ring);
+    qemu_mutex_unlock(&binary_trace.lock);
+    return ring;
+}
+
+/* Reserve @p len bytes in the ring, waiting for the writer thread if needed. */
+static void binary_ring_reserve(struct qemu_log_binary_ring *ring, size_t len)
+{
+    assert(len <= BINARY_RECORD_MAX_SIZE);
+    while (ring->size - (ring->head - qatomic_load_acquire(&ring->tail)) < len) {
+        qemu_event_reset(&ring->drained);
+        if (ring->size - (ring->head - qatomic_load_acquire(&ring->tail)) >=
+            len) {
+            break;
+        }
+        binary_trace_kick_writer();
+        qemu_event_wait(&ring->drained);
+    }
+}
+
+static void binary_ring_put(struct qemu_log_binary_ring *ring, size_t *pos,
+                            const void *data, size_t len)
+{
+    size_t start = *pos & (ring->size - 1);
+    size_t first = MIN(len, ring->size - start);
+
+    memcpy(ring->buf + start, data, first);
+    if (first < len) {
+        memcpy(ring->buf, (const uint8_t *)data + first, len - first);
+    }
+    *pos += len;
+}
+
+static void binary_ring_commit(struct qemu_log_binary_ring *ring, size_t pos)
+{
+    qatomic_store_release(&ring->head, pos);
+    if (pos - qatomic_read(&ring->tail) >= ring->size / 2) {
+        binary_trace_kick_writer();
+    }
+}
+
+static void emit_binary_header(CPUArchState *env)
+{
+    binary_trace.rings = g_ptr_array_new();
+    binary_trace.compress = qemu_log_instr_format == QLI_FMT_BINARY_ZSTD;
+#ifdef CONFIG_ZSTD
+    if (binary_trace.compress) {
+        binary_trace.zstream = ZSTD_createCStream();
+        ZSTD_initCStream(binary_trace.zstream, 1);
+        binary_trace.zbuf_size = ZSTD_CStreamOutSize();
+        binary_trace.zbuf = g_malloc(binary_trace.zbuf_size);
+    }
+#endif
+    qemu_mutex_init(&binary_trace.lock);
+    qemu_sem_init(&binary_trace.wakeup, 0);
+    qemu_thread_create(&binary_trace.thread, "trace-writer",
+                       binary_trace_writer_thread, NULL, QEMU_THREAD_JOINABLE);
+    binary_trace.started = true;
+    atexit(binary_trace_shutdown);
+}
+
+static void emit_binary_event(CPUArchState *env, uint8_t type, target_ulong pc)
+{
+    cpu_log_instr_state_t *cpulog = get_cpu_log_state(env);
+    binary_trace_entry_t entry = {
+        .size = sizeof(entry),
+        .type = type,
+        .cpu = env_cpu(env)->cpu_index,
+        .asid = cpu_get_asid(env, pc),
+        .pc = pc,
+    };
+    size_t pos = cpulog->binary_ring->head;
+
+    binary_ring_reserve(cpulog->binary_ring, sizeof(entry));
+    binary_ring_put(cpulog->binary_ring, &pos, &entry, sizeof(entry));
+    binary_ring_commit(cpulog->binary_ring, pos);
+}
+
+static void emit_binary_start(CPUArchState *env, target_ulong pc)
+{
+    emit_binary_event(env, BTE_START, pc);
+}
+
+static void emit_binary_stop(CPUArchState *env, target_ulong pc)
+{
+    emit_binary_event(env, BTE_STOP, pc);
+}
+
+static void emit_binary_entry(CPUArchState *env, cpu_log_instr_info_t *iinfo)
+{
+    struct qemu_log_binary_ring *ring = get_cpu_log_state(env)->binary_ring;
+    static const uint8_t zero_pad[8];
+    size_t nregs = MIN(iinfo->regs->len, UINT8_MAX);
+    size_t nmem = MIN(iinfo->mem->len, UINT8_MAX);
+    size_t fixed_size = sizeof(binary_trace_entry_t) +
+                        nregs * sizeof(binary_trace_reg_t) +
+                        nmem * sizeof(binary_trace_mem_t);
+    size_t text_len = MIN(iinfo->txt_buffer->len,
+                          BINARY_RECORD_MAX_SIZE - fixed_size);
+    size_t size = fixed_size + ROUND_UP(text_len, 8);
+    binary_trace_entry_t entry = {
+        .size = size,
+        .type = BTE_INSN,
+        .flags = iinfo->flags,
+        .cpu = env_cpu(env)->cpu_index,
+        .asid = iinfo->asid,
+        .nregs = nregs,
+        .nmem = nmem,
+        .insn_size = iinfo->insn_size,
+        .next_cpu_mode = iinfo->next_cpu_mode,
+        .intr_code = iinfo->intr_code,
+        .pc = iinfo->pc,
+        .intr_vector = iinfo->intr_vector,
+        .intr_faultaddr = iinfo->intr_faultaddr,
+        .text_len = text_len,
+    };
+    size_t pos;
+    int i;
+
+    binary_ring_reserve(ring, size);
+    memcpy(entry.insn_bytes, iinfo->insn_bytes,
+           MIN(sizeof(entry.insn_bytes), sizeof(iinfo->insn_bytes)));
+
+    pos = ring->head;
+    binary_ring_put(ring, &pos, &entry, sizeof(entry));
+    for (i = 0; i < nregs; i++) {
+        log_reginfo_t *rinfo = &g_array_index(iinfo->regs, log_reginfo_t, i);
+        binary_trace_reg_t r = {
+            .index = rinfo->index,
+            .flags = rinfo->flags,
+            .value = rinfo->gpr,
+        };
+#ifdef TARGET_CHERI
+        if (reginfo_has_cap(rinfo)) {
+            r.tag = rinfo->cap.cr_tag;
+            r.value = cap_get_cursor(&rinfo->cap);
+            r.pesbt = CAP_cc(compress_mem)(&rinfo->cap);
+        }
+#endif
+        binary_ring_put(ring, &pos, &r, sizeof(r));
+    }
+    for (i = 0; i < nmem; i++) {
+        log_meminfo_t *minfo = &g_array_index(iinfo->mem, log_meminfo_t, i);
+        binary_trace_mem_t m = {
+            .flags = minfo->flags,
+            .size = memop_size(minfo->op),
+            .addr = minfo->addr,
+            .value = minfo->value,
+        };
+#ifdef TARGET_CHERI
+        if (minfo->flags & LMI_CAP) {
+            m.size = CHERI_CAP_SIZE;
+            m.tag = minfo->cap.cr_tag;
+            m.value = cap_get_cursor(&minfo->cap);
+            m.pesbt = CAP_cc(compress_mem)(&minfo->cap);
+        }
+#endif
+        binary_ring_put(ring, &pos, &m, sizeof(m));
+    }
+    if (text_len) {
+        binary_ring_put(ring, &pos, iinfo->txt_buffer->str, text_len);
+        binary_ring_put(ring, &pos, zero_pad, ROUND_UP(text_len, 8) - text_len);
+    }
+    binary_ring_commit(ring, pos);
+}
+
 /* Core instruction logging implementation */
 
 static inline void emit_start_event(CPUArchState *env, target_ulong pc)
@@ -594,6 +1017,12 @@ static void do_instr_commit(CPUArchState *env)
     if (cpulog->force_drop)
         return;
 
+    if (cpulog->tb_filtered) {
+        /* Everything since the last commit ran in filtered TBs */
+        cpulog->tb_filtered = false;
+        return;
+    }
+
     if (cpulog->starting) {
         cpulog->starting = false;
         emit_start_event(env, cpu_get_recent_pc(env));
@@ -699,6 +1128,7 @@ static void do_cpu_loglevel_switch(CPUState *cpu, run_on_cpu_data data)
      */
     if (next_level_active) {
         cpulog->starting = true;
+        cpulog->tb_filtered = false;
         cpu->cflags_next_tb = curr_cflags(cpu) | CF_LOG_INSTR;
     } else {
         cpu->cflags_next_tb = curr_cflags(cpu) & ~CF_LOG_INSTR;
@@ -837,6 +1267,9 @@ void qemu_log_instr_init(CPUState *cpu)
         if (trace_format->emit_header)
             trace_format->emit_header(cpu->env_ptr);
     }
+    if (binary_trace.started) {
+        cpulog->binary_ring = binary_ring_new();
+    }
 
     /* If we are starting with instruction logging enabled, switch it on now */
     if (qemu_loglevel_mask(CPU_LOG_INSTR_U))
@@ -887,6 +1320,161 @@ void qemu_log_instr_set_buffer_size(unsigned long new_size)
     }
 }
 
+/*
+ * Translation-time trace filter.
+ * This is consulted when looking up a TB, TBs that do not match are tagged
+ * with CF_LOG_INSTR_FILTERED and contain no per-instruction logging calls.
+ * An empty clause list matches everything.
+ */
+static struct {
+    /* Range of pc values to log */
+    GArray *pc_ranges;
+    /* Address space identifiers to log */
+    GArray *asids;
+    /* -1: any mode, 0: privileged modes only, 1: user mode only */
+    int user_mode;
+    /* Log one every sample basic blocks, by pc hash */
+    uint32_t sample;
+} tb_filter = { .user_mode = -1 };
+
+bool qemu_log_instr_tb_filter_enabled;
+bool qemu_log_instr_tb_filter_stateful;
+
+static bool tb_filter_parse_range(const char *val, Range *range)
+{
+    const char *end;
+    uint64_t lob, upb;
+
+    if (qemu_strtou64(val, &end, 0, &lob) || (*end != '-' && *end != '+') ||
+        qemu_strtou64(end + 1, NULL, 0, &upb)) {
+        return false;
+    }
+    if (*end == '+') {
+        if (upb == 0 || lob + upb - 1 < lob) {
+            return false;
+        }
+        upb = lob + upb - 1;
+    }
+    if (upb < lob) {
+        return false;
+    }
+    range_set_bounds(range, lob, upb);
+    return true;
+}
+
+void qemu_log_instr_set_tb_filter(const char *spec, Error **errp)
+{
+    gchar **clauses = g_strsplit(spec, ",", 0);
+    GArray *pc_ranges = g_array_new(FALSE, FALSE, sizeof(Range));
+    GArray *asids = g_array_new(FALSE, FALSE, sizeof(unsigned));
+    int user_mode = -1;
+    uint64_t sample = 0;
+    int i;
+
+    for (i = 0; clauses[i]; i++) {
+        const char *clause = clauses[i];
+        const char *val = strchr(clause, '=');
+        uint64_t num;
+
+        if (val == NULL) {
+            error_setg(errp, "Invalid trace filter clause '%s'", clause);
+            goto fail;
+        }
+        val++;
+        if (g_str_has_prefix(clause, "pc=")) {
+            Range range;
+
+            if (!tb_filter_parse_range(val, &range)) {
+                error_setg(errp, "Invalid trace filter pc range '%s'", val);
+                goto fail;
+            }
+            g_array_append_val(pc_ranges, range);
+        } else if (g_str_has_prefix(clause, "asid=")) {
+            unsigned asid;
+
+            if (qemu_strtou64(val, NULL, 0, &num) || num > UINT_MAX) {
+                error_setg(errp, "Invalid trace filter asid '%s'", val);
+                goto fail;
+            }
+            asid = num;
+            g_array_append_val(asids, asid);
+        } else if (g_str_has_prefix(clause, "mode=")) {
+            if (strcmp(val, "user") == 0) {
+                user_mode = 1;
+            } else if (strcmp(val, "kernel") == 0) {
+                user_mode = 0;
+            } else {
+                error_setg(errp, "Invalid trace filter mode '%s'", val);
+                goto fail;
+            }
+        } else if (g_str_has_prefix(clause, "sample=")) {
+            if (qemu_strtou64(val, NULL, 0, &sample) || sample == 0 ||
+                sample > UINT32_MAX) {
+                error_setg(errp, "Invalid trace filter sample rate '%s'", val);
+                goto fail;
+            }
+        } else {
+            error_setg(errp, "Unknown trace filter clause '%s'", clause);
+            goto fail;
+        }
+    }
+
+    if (tb_filter.pc_ranges) {
+        g_array_unref(tb_filter.pc_ranges);
+        g_array_unref(tb_filter.asids);
+    }
+    tb_filter.pc_ranges = pc_ranges;
+    tb_filter.asids = asids;
+    tb_filter.user_mode = user_mode;
+    tb_filter.sample = sample;
+    qemu_log_instr_tb_filter_enabled = pc_ranges->len > 0 || asids->len > 0 ||
+        user_mode >= 0 || sample > 1;
+    qemu_log_instr_tb_filter_stateful = asids->len > 0 || user_mode >= 0;
+    g_strfreev(clauses);
+    return;
+
+fail:
+    g_array_unref(pc_ranges);
+    g_array_unref(asids);
+    g_strfreev(clauses);
+}
+
+bool qemu_log_instr_tb_filter_match(CPUArchState *env, target_ulong pc)
+{
+    bool match;
+    int i;
+
+    if (tb_filter.user_mode >= 0 &&
+        cpu_in_user_mode(env) != (tb_filter.user_mode == 1)) {
+        return false;
+    }
+    if (tb_filter.pc_ranges->len > 0) {
+        match = false;
+        for (i = 0; !match && i < tb_filter.pc_ranges->len; i++) {
+            match = range_contains(
+                &g_array_index(tb_filter.pc_ranges, Range, i), pc);
+        }
+        if (!match) {
+            return false;
+        }
+    }
+    if (tb_filter.asids->len > 0) {
+        unsigned asid = cpu_get_asid(env, pc);
+
+        match = false;
+        for (i = 0; !match && i < tb_filter.asids->len; i++) {
+            match = g_array_index(tb_filter.asids, unsigned, i) == asid;
+        }
+        if (!match) {
+            return false;
+        }
+    }
+    if (tb_filter.sample > 1 && qemu_xxhash2(pc) % tb_filter.sample != 0) {
+        return false;
+    }
+    return true;
+}
+
 /*
  * Check whether instruction logging is enabled on this CPU.
  */
@@ -1622,6 +2210,21 @@ void helper_qemu_log_instr_commit(CPUArchState *env)
     qemu_log_instr_commit(env);
 }
 
+/*
+ * Called on entry to a TB excluded by the trace filter.
+ * Commit the last instruction of the previous logged TB, anything recorded
+ * from now on is dropped by the commit at the start of the next logged TB.
+ */
+void helper_qemu_log_instr_filtered(CPUArchState *env)
+{
+    cpu_log_instr_state_t *cpulog = get_cpu_log_state(env);
+
+    if (!cpulog->tb_filtered) {
+        qemu_log_instr_commit(env);
+        cpulog->tb_filtered = true;
+    }
+}
+
 void helper_qemu_log_instr_load64(CPUArchState *env, target_ulong addr,
                                   uint64_t value, MemOpIdx oi)
 {
@@ -1680,6 +2283,18 @@ static trace_fmt_hooks_t trace_formats[] = {
         .emit_start = emit_nop_start,
         .emit_stop = emit_nop_stop,
         .emit_entry = emit_nop_entry
+    },
+    {
+        .emit_header = emit_binary_header,
+        .emit_start = emit_binary_start,
+        .emit_stop = emit_binary_stop,
+        .emit_entry = emit_binary_entry
+    },
+    {
+        .emit_header = emit_binary_header,
+        .emit_start = emit_binary_start,
+        .emit_stop = emit_binary_stop,
+        .emit_entry = emit_binary_entry
     }
 };
 
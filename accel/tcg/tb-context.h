@@ -35,6 +35,8 @@ struct TBContext {
     /* statistics */
     unsigned tb_flush_count;
     unsigned tb_phys_invalidate_count;
+    /* CHERI: translations of the same code for different PCC bounds */
+    unsigned tb_pcc_dup_count;
 };
 
 extern TBContext tb_ctx;
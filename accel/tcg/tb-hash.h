@@ -59,6 +59,13 @@ static inline unsigned int tb_jmp_cache_hash_func(target_ulong pc)
 
 #endif /* CONFIG_SOFTMMU */
 
+/* Inline cache entry of the TB at pc, see translator_lookup_and_goto_ptr() */
+static inline unsigned int tb_ic_hash_func(target_ulong pc)
+{
+    /* Ignore bit 0, most guests only have aligned instructions */
+    return ((pc >> 1) ^ (pc >> (TB_IC_BITS + 1))) & (TB_IC_SIZE - 1);
+}
+
 static inline
 uint32_t tb_hash_func(tb_page_addr_t phys_pc, target_ulong pc, uint32_t flags,
                       uint32_t cf_mask, uint32_t trace_vcpu_dstate)
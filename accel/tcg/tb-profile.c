@@ -0,0 +1,290 @@
+/*
+ * Persistent translation profile for TCG
+ *
+ * With -accel tcg,tb-profile=FILE the key of every translation block is
+ * recorded: guest pc, cs_base, PCC bounds, flags, cflags, cheri_flags,
+ * physical address and a hash of the guest code it was translated from.
+ * The keys are loaded from FILE at startup and written back (merged with
+ * the new ones) at exit.
+ *
+ * With spec-threads, the keys are used to translate ahead of the vCPUs:
+ * the first time a page is translated from in this run, every key
+ * recorded for that page whose guest code still has the same hash is
+ * queued for the background translation threads (see tb_profile_prewarm).
+ * Images that are loaded at the same address in every run, such as the
+ * firmware and the kernel, are then mostly translated off the vCPU
+ * threads.
+ *
+ * The generated host code itself is not stored. It is not position
+ * independent (helper calls, TB pointers for exit_tb and constant host
+ * pointers are all embedded), so loading it would need relocation support
+ * in every TCG backend.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/crc32c.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/notify.h"
+#include "qemu/thread.h"
+#include "qapi/error.h"
+#include "exec/exec-all.h"
+#include "exec/ram_addr.h"
+#include "sysemu/sysemu.h"
+#include "internal.h"
+
+#define TB_PROFILE_MAGIC "QEMUTBP2"
+
+typedef struct TBProfileHeader {
+    char magic[8];
+    uint32_t key_size;
+    uint32_t page_bits;
+    char target[16];
+} TBProfileHeader;
+
+typedef struct TBProfileKey {
+    uint64_t pc;
+    uint64_t cs_base;
+    uint64_t pcc_base;
+    uint64_t pcc_top;
+    uint64_t phys_pc;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t cheri_flags;
+    uint32_t size;
+    uint32_t code_hash;
+    uint32_t pad;
+} TBProfileKey;
+
+bool tb_profile_enabled;
+
+static struct {
+    char *path;
+    QemuMutex lock;
+    /* All keys, TBProfileKey -> GINT_TO_POINTER(seen in this run) */
+    GHashTable *keys;
+    /* Loaded keys of pages not yet translated from, page -> GArray */
+    GHashTable *pages;
+    size_t loaded;
+    uint64_t prewarmed;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t uncacheable;
+    Notifier exit_notifier;
+} tb_profile;
+
+static guint tb_profile_key_hash(gconstpointer v)
+{
+    const TBProfileKey *k = v;
+    return k->pc ^ (k->phys_pc >> 2) ^ k->flags ^ k->cheri_flags ^
+           k->code_hash;
+}
+
+static gboolean tb_profile_key_equal(gconstpointer a, gconstpointer b)
+{
+    return memcmp(a, b, sizeof(TBProfileKey)) == 0;
+}
+
+static void tb_profile_header_init(TBProfileHeader *header)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, TB_PROFILE_MAGIC, sizeof(header->magic));
+    header->key_size = sizeof(TBProfileKey);
+    header->page_bits = TARGET_PAGE_BITS;
+    pstrcpy(header->target, sizeof(header->target), TARGET_NAME);
+}
+
+static void tb_profile_load(FILE *f)
+{
+    TBProfileHeader header, expected;
+    TBProfileKey key;
+
+    tb_profile_header_init(&expected);
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(&header, &expected, sizeof(header)) != 0) {
+        warn_report("tb-profile: ignoring '%s', it was written by a "
+                    "different QEMU target or version", tb_profile.path);
+        return;
+    }
+    while (fread(&key, sizeof(key), 1, f) == 1) {
+        uint64_t page = key.phys_pc & TARGET_PAGE_MASK;
+        GArray *keys;
+
+        if (!g_hash_table_insert(tb_profile.keys,
+                                 g_memdup2(&key, sizeof(key)),
+                                 GINT_TO_POINTER(false))) {
+            continue;
+        }
+        keys = g_hash_table_lookup(tb_profile.pages, &page);
+        if (!keys) {
+            keys = g_array_new(false, false, sizeof(TBProfileKey));
+            g_hash_table_insert(tb_profile.pages,
+                                g_memdup2(&page, sizeof(page)), keys);
+        }
+        g_array_append_val(keys, key);
+    }
+    tb_profile.loaded = g_hash_table_size(tb_profile.keys);
+}
+
+/*
+ * Queue the loaded keys of a page that is translated from for the first
+ * time in this run.  Only keys whose guest code is unchanged are queued,
+ * tb_spec_translate() skips those that have been translated meanwhile.
+ */
+static void tb_profile_prewarm(CPUState *cpu, GArray *keys)
+{
+    uint64_t queued = 0;
+
+    for (guint i = 0; i < keys->len; i++) {
+        TBProfileKey *k = &g_array_index(keys, TBProfileKey, i);
+
+        /* The file may be stale, the page is known to be RAM. */
+        if ((k->phys_pc & ~TARGET_PAGE_MASK) + k->size > TARGET_PAGE_SIZE ||
+            crc32c(0xffffffff, qemu_map_ram_ptr(NULL, k->phys_pc),
+                   k->size) != k->code_hash) {
+            continue;
+        }
+        tb_spec_queue(cpu, k->pc, k->cs_base, k->pcc_base, k->pcc_top,
+                      k->cheri_flags, k->flags, k->cflags, k->phys_pc);
+        queued++;
+    }
+    g_array_unref(keys);
+
+    qemu_mutex_lock(&tb_profile.lock);
+    tb_profile.prewarmed += queued;
+    qemu_mutex_unlock(&tb_profile.lock);
+}
+
+static void tb_profile_save(Notifier *n, void *data)
+{
+    g_autofree char *tmp = g_strdup_printf("%s.tmp", tb_profile.path);
+    TBProfileHeader header;
+    GHashTableIter iter;
+    gpointer key;
+    FILE *f = fopen(tmp, "wb");
+
+    if (!f) {
+        warn_report("tb-profile: could not write '%s': %s", tmp,
+                    strerror(errno));
+        return;
+    }
+    tb_profile_header_init(&header);
+    fwrite(&header, sizeof(header), 1, f);
+    qemu_mutex_lock(&tb_profile.lock);
+    g_hash_table_iter_init(&iter, tb_profile.keys);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        fwrite(key, sizeof(TBProfileKey), 1, f);
+    }
+    qemu_mutex_unlock(&tb_profile.lock);
+    /* Replace the old profile atomically, concurrent runs may read it. */
+    if (fclose(f) != 0 || rename(tmp, tb_profile.path) != 0) {
+        warn_report("tb-profile: could not write '%s': %s", tb_profile.path,
+                    strerror(errno));
+        unlink(tmp);
+    }
+}
+
+void tb_profile_init(const char *path)
+{
+    FILE *f;
+
+    tb_profile.path = g_strdup(path);
+    qemu_mutex_init(&tb_profile.lock);
+    tb_profile.keys = g_hash_table_new_full(
+        tb_profile_key_hash, tb_profile_key_equal, g_free, NULL);
+    tb_profile.pages = g_hash_table_new_full(
+        g_int64_hash, g_int64_equal, g_free, (GDestroyNotify)g_array_unref);
+    f = fopen(path, "rb");
+    if (f) {
+        tb_profile_load(f);
+        fclose(f);
+    }
+    tb_profile.exit_notifier.notify = tb_profile_save;
+    qemu_add_exit_notifier(&tb_profile.exit_notifier);
+    tb_profile_enabled = true;
+}
+
+void tb_profile_record(CPUState *cpu, TranslationBlock *tb,
+                       tb_page_addr_t phys_pc, tb_page_addr_t phys_page2)
+{
+    TBProfileKey key = {
+        .pc = tb->pc,
+        .cs_base = tb->cs_base,
+        .pcc_base = tb->pcc_base,
+        .pcc_top = tb->pcc_top,
+        .phys_pc = phys_pc,
+        .flags = tb->flags,
+        .cflags = tb->cflags & ~CF_INVALID,
+        .cheri_flags = tb->cheri_flags,
+        .size = tb->size,
+    };
+
+    /*
+     * One-shot TBs for code outside RAM and TBs spanning two pages are rare
+     * and would need both pages hashed, so they are only counted.
+     */
+    if (phys_pc == -1 || phys_page2 != -1) {
+        qemu_mutex_lock(&tb_profile.lock);
+        tb_profile.uncacheable++;
+        qemu_mutex_unlock(&tb_profile.lock);
+        return;
+    }
+    key.code_hash = crc32c(0xffffffff, qemu_map_ram_ptr(NULL, phys_pc),
+                           tb->size);
+
+    uint64_t page = phys_pc & TARGET_PAGE_MASK;
+    GArray *prewarm = NULL;
+    gpointer seen, page_key;
+
+    qemu_mutex_lock(&tb_profile.lock);
+    if (tb_spec_enabled &&
+        g_hash_table_lookup_extended(tb_profile.pages, &page, &page_key,
+                                     (gpointer *)&prewarm)) {
+        g_hash_table_steal(tb_profile.pages, &page);
+        g_free(page_key);
+    }
+    if (g_hash_table_lookup_extended(tb_profile.keys, &key, NULL, &seen)) {
+        /* Retranslations within a run do not count as hits. */
+        if (!GPOINTER_TO_INT(seen)) {
+            tb_profile.hits++;
+            g_hash_table_replace(tb_profile.keys,
+                                 g_memdup2(&key, sizeof(key)),
+                                 GINT_TO_POINTER(true));
+        }
+    } else {
+        tb_profile.misses++;
+        g_hash_table_insert(tb_profile.keys, g_memdup2(&key, sizeof(key)),
+                            GINT_TO_POINTER(true));
+    }
+    qemu_mutex_unlock(&tb_profile.lock);
+
+    if (prewarm) {
+        tb_profile_prewarm(cpu, prewarm);
+    }
+}
+
+void tb_profile_dump_info(GString *buf)
+{
+    if (!tb_profile_enabled) {
+        return;
+    }
+    qemu_mutex_lock(&tb_profile.lock);
+    uint64_t total = tb_profile.hits + tb_profile.misses;
+    g_string_append_printf(buf, "\nTranslation profile (%s):\n",
+                           tb_profile.path);
+    g_string_append_printf(buf, "keys loaded         %zu\n",
+                           tb_profile.loaded);
+    g_string_append_printf(buf, "prewarmed           %" PRIu64 "\n",
+                           tb_profile.prewarmed);
+    g_string_append_printf(buf, "hits                %" PRIu64 " (%" PRIu64
+                           "%%)\n", tb_profile.hits,
+                           total ? tb_profile.hits * 100 / total : 0);
+    g_string_append_printf(buf, "misses              %" PRIu64 "\n",
+                           tb_profile.misses);
+    g_string_append_printf(buf, "uncacheable         %" PRIu64 "\n",
+                           tb_profile.uncacheable);
+    qemu_mutex_unlock(&tb_profile.lock);
+}
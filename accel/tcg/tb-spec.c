@@ -0,0 +1,286 @@
+/*
+ * Background translation for TCG
+ *
+ * With -accel tcg,spec-threads=N every TB a vCPU translates queues its direct
+ * successors on the same guest page (the fall-through and the goto_tb
+ * targets) for N worker threads, which translate them speculatively. When
+ * the vCPU gets there it finds the TB in the hash table instead of stalling
+ * in tb_gen_code, which mostly helps code-heavy phases such as boot and the
+ * start of large programs. With tb-profile, the translations recorded on a
+ * page in an earlier run are queued too (see tb_profile_prewarm).
+ *
+ * The workers cannot use the vCPU's softmmu TLB, which belongs to the vCPU
+ * thread. The successors are on the page of the TB that named them, whose
+ * physical address is known, so their code is read from that RAM page
+ * directly (see translator_set_code_page) and a translation that would need
+ * a second page is dropped. Workers translate with their own TCGContext and
+ * code region; tb_flush waits for the translation in progress and drops the
+ * queue.
+ *
+ * A worker runs the target's translator with the CPUState of a vCPU that
+ * keeps executing, so the translator must derive everything that can change
+ * at run time from the TB flags. Targets that have been checked for this set
+ * TARGET_SUPPORTS_TB_SPEC in their configs/targets file; others (e.g. MIPS,
+ * which reads env->btarget for a TB that starts in a branch delay slot)
+ * reject spec-threads.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/rcu.h"
+#include "qemu/thread.h"
+#include "exec/exec-all.h"
+#include "exec/ram_addr.h"
+#include "exec/translator.h"
+#include "hw/core/cpu.h"
+#include "semihosting/semihost.h"
+#include "tcg/tcg.h"
+#include "internal.h"
+
+/* Requests beyond this are dropped, the vCPU translates them if needed */
+#define TB_SPEC_QUEUE_SIZE 1024
+
+typedef struct TBSpecRequest {
+    CPUState *cpu;
+    target_ulong pc;
+    target_ulong cs_base;
+    target_ulong pcc_base;
+    target_ulong pcc_top;
+    tb_page_addr_t phys_pc;
+    uint32_t cheri_flags;
+    uint32_t flags;
+    uint32_t cflags;
+} TBSpecRequest;
+
+bool tb_spec_enabled;
+
+static struct {
+    /* Protects the queue and the statistics */
+    QemuMutex lock;
+    QemuCond cond;
+    TBSpecRequest queue[TB_SPEC_QUEUE_SIZE];
+    unsigned head;
+    unsigned count;
+    /* Held by a worker while it translates, see tb_spec_flush_begin() */
+    QemuMutex translate_lock;
+    unsigned nthreads;
+    uint64_t queued;
+    uint64_t dropped;
+    uint64_t translated;
+    uint64_t existing;
+    uint64_t failed;
+} tb_spec;
+
+static void tb_spec_translate(TBSpecRequest *req)
+{
+    TranslationBlock *tb = NULL;
+    bool exists;
+
+    qemu_mutex_lock(&tb_spec.translate_lock);
+    WITH_RCU_READ_LOCK_GUARD() {
+        exists = tb_exists_phys(req->cpu, req->pc, req->cs_base,
+                                req->pcc_base, req->pcc_top, req->cheri_flags,
+                                req->flags, req->cflags, req->phys_pc);
+        if (!exists) {
+            void *host = qemu_map_ram_ptr(NULL,
+                                          req->phys_pc & TARGET_PAGE_MASK);
+            tb = tb_gen_code_background(req->cpu, req->pc, req->cs_base,
+                                        req->pcc_base, req->pcc_top,
+                                        req->cheri_flags, req->flags,
+                                        req->cflags, req->phys_pc, host);
+        }
+    }
+    qemu_mutex_unlock(&tb_spec.translate_lock);
+
+    qemu_mutex_lock(&tb_spec.lock);
+    if (exists) {
+        tb_spec.existing++;
+    } else if (tb) {
+        tb_spec.translated++;
+    } else {
+        tb_spec.failed++;
+    }
+    qemu_mutex_unlock(&tb_spec.lock);
+}
+
+static void *tb_spec_thread(void *opaque)
+{
+    rcu_register_thread();
+    tcg_register_thread();
+
+    qemu_mutex_lock(&tb_spec.lock);
+    while (true) {
+        while (!tb_spec.count) {
+            qemu_cond_wait(&tb_spec.cond, &tb_spec.lock);
+        }
+        TBSpecRequest req = tb_spec.queue[tb_spec.head];
+        tb_spec.head = (tb_spec.head + 1) % TB_SPEC_QUEUE_SIZE;
+        tb_spec.count--;
+        qemu_mutex_unlock(&tb_spec.lock);
+
+        tb_spec_translate(&req);
+
+        qemu_mutex_lock(&tb_spec.lock);
+    }
+    return NULL;
+}
+
+void tb_spec_init(unsigned nthreads)
+{
+    qemu_mutex_init(&tb_spec.lock);
+    qemu_cond_init(&tb_spec.cond);
+    qemu_mutex_init(&tb_spec.translate_lock);
+    tb_spec.nthreads = nthreads;
+    for (unsigned i = 0; i < nthreads; i++) {
+        QemuThread thread;
+        g_autofree char *name = g_strdup_printf("tcg-spec/%u", i);
+
+        qemu_thread_create(&thread, name, tb_spec_thread, NULL,
+                           QEMU_THREAD_DETACHED);
+    }
+    tb_spec_enabled = true;
+}
+
+/* Only TBs that the translator builds from guest memory alone qualify */
+static bool tb_spec_cpu_ok(CPUState *cpu, uint32_t cflags)
+{
+    if (cflags & (CF_COUNT_MASK | CF_LAST_IO | CF_NO_GOTO_TB |
+                  CF_SINGLE_STEP | CF_NOIRQ | CF_LOG_INSTR |
+                  CF_LOG_INSTR_FILTERED)) {
+        return false;
+    }
+    if (!QTAILQ_EMPTY(&cpu->breakpoints) || semihosting_enabled()) {
+        return false;
+    }
+#ifdef CONFIG_PLUGIN
+    /* Translation callbacks expect to run on the vCPU thread. */
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_mask)) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+/* Called with tb_spec.lock held */
+static void tb_spec_queue_locked(const TBSpecRequest *req)
+{
+    if (tb_spec.count == TB_SPEC_QUEUE_SIZE) {
+        tb_spec.dropped++;
+        return;
+    }
+    tb_spec.queue[(tb_spec.head + tb_spec.count) % TB_SPEC_QUEUE_SIZE] = *req;
+    tb_spec.count++;
+    tb_spec.queued++;
+}
+
+void tb_spec_queue_successors(CPUState *cpu, TranslationBlock *tb)
+{
+    target_ulong pcs[TRANSLATOR_MAX_SUCCESSORS + 1];
+    target_ulong next_pc = tb->pc + tb->size;
+    uint32_t cflags = tb_cflags(tb) & ~CF_INVALID;
+    tb_page_addr_t phys_page = tb->page_addr[0];
+    int i, n;
+
+    if (phys_page == -1 || !tb_spec_cpu_ok(cpu, cflags)) {
+        return;
+    }
+    /* The goto_tb targets are on the TB's page, the fall-through may not be */
+    n = translator_get_successors(pcs);
+    for (i = 0; i < n && pcs[i] != next_pc; i++) {
+        continue;
+    }
+    if (i == n && ((next_pc ^ tb->pc) & TARGET_PAGE_MASK) == 0) {
+        pcs[n++] = next_pc;
+    }
+
+    qemu_mutex_lock(&tb_spec.lock);
+    for (i = 0; i < n; i++) {
+        tb_spec_queue_locked(&(TBSpecRequest) {
+            .cpu = cpu,
+            .pc = pcs[i],
+            .cs_base = tb->cs_base,
+            .pcc_base = tb->pcc_base,
+            .pcc_top = tb->pcc_top,
+            .phys_pc = phys_page | (pcs[i] & ~TARGET_PAGE_MASK),
+            .cheri_flags = tb->cheri_flags,
+            .flags = tb->flags,
+            .cflags = cflags,
+        });
+    }
+    qemu_cond_signal(&tb_spec.cond);
+    qemu_mutex_unlock(&tb_spec.lock);
+}
+
+/*
+ * Queue a translation that is not a successor of a TB, see
+ * tb_profile_prewarm().  The code must not cross the page of phys_pc.
+ */
+void tb_spec_queue(CPUState *cpu, target_ulong pc, target_ulong cs_base,
+                   target_ulong pcc_base, target_ulong pcc_top,
+                   uint32_t cheri_flags, uint32_t flags, uint32_t cflags,
+                   tb_page_addr_t phys_pc)
+{
+    if (!tb_spec_cpu_ok(cpu, cflags)) {
+        return;
+    }
+    qemu_mutex_lock(&tb_spec.lock);
+    tb_spec_queue_locked(&(TBSpecRequest) {
+        .cpu = cpu,
+        .pc = pc,
+        .cs_base = cs_base,
+        .pcc_base = pcc_base,
+        .pcc_top = pcc_top,
+        .phys_pc = phys_pc,
+        .cheri_flags = cheri_flags,
+        .flags = flags,
+        .cflags = cflags,
+    });
+    qemu_cond_signal(&tb_spec.cond);
+    qemu_mutex_unlock(&tb_spec.lock);
+}
+
+/*
+ * Called by tb_flush with all vCPUs stopped: wait for the translation in
+ * progress, which uses the code buffer, and drop the queued requests as the
+ * TBs that made them are gone.
+ */
+void tb_spec_flush_begin(void)
+{
+    if (!tb_spec_enabled) {
+        return;
+    }
+    qemu_mutex_lock(&tb_spec.translate_lock);
+    qemu_mutex_lock(&tb_spec.lock);
+    tb_spec.count = 0;
+    qemu_mutex_unlock(&tb_spec.lock);
+}
+
+void tb_spec_flush_end(void)
+{
+    if (tb_spec_enabled) {
+        qemu_mutex_unlock(&tb_spec.translate_lock);
+    }
+}
+
+void tb_spec_dump_info(GString *buf)
+{
+    if (!tb_spec_enabled) {
+        return;
+    }
+    qemu_mutex_lock(&tb_spec.lock);
+    g_string_append_printf(buf, "\nBackground translation (%u threads):\n",
+                           tb_spec.nthreads);
+    g_string_append_printf(buf, "queued              %" PRIu64 "\n",
+                           tb_spec.queued);
+    g_string_append_printf(buf, "dropped             %" PRIu64 "\n",
+                           tb_spec.dropped);
+    g_string_append_printf(buf, "translated          %" PRIu64 "\n",
+                           tb_spec.translated);
+    g_string_append_printf(buf, "already present     %" PRIu64 "\n",
+                           tb_spec.existing);
+    g_string_append_printf(buf, "failed              %" PRIu64 "\n",
+                           tb_spec.failed);
+    qemu_mutex_unlock(&tb_spec.lock);
+}
@@ -44,6 +44,8 @@ struct TCGState {
     bool mttcg_enabled;
     int splitwx_enabled;
     unsigned long tb_size;
+    char *tb_profile;
+    uint32_t spec_threads;
 };
 typedef struct TCGState TCGState;
 
@@ -118,13 +120,16 @@ static int tcg_init_machine(MachineState *ms)
 #else
     unsigned max_cpus = ms->smp.max_cpus;
 #endif
+    unsigned max_threads;
 
     tcg_allowed = true;
     mttcg_enabled = s->mttcg_enabled;
+    /* One TCG thread per vCPU with MTTCG, plus the background translators */
+    max_threads = (mttcg_enabled ? max_cpus : 1) + s->spec_threads;
 
     page_init();
     tb_htable_init();
-    tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_cpus);
+    tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_threads);
 
 #if defined(CONFIG_SOFTMMU)
     /*
@@ -132,6 +137,13 @@ static int tcg_init_machine(MachineState *ms)
      * initialize the prologue now.
      */
     tcg_prologue_init(tcg_ctx);
+
+    if (s->tb_profile) {
+        tb_profile_init(s->tb_profile);
+    }
+    if (s->spec_threads) {
+        tb_spec_init(s->spec_threads);
+    }
 #endif
 
     return 0;
@@ -208,6 +220,60 @@ static void tcg_set_splitwx(Object *obj, bool value, Error **errp)
     s->splitwx_enabled = value;
 }
 
+static char *tcg_get_tb_profile(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return g_strdup(s->tb_profile);
+}
+
+static void tcg_set_tb_profile(Object *obj, const char *value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+#ifdef CONFIG_USER_ONLY
+    error_setg(errp, "tb-profile is only supported in system emulation");
+#else
+    g_free(s->tb_profile);
+    s->tb_profile = g_strdup(value);
+#endif
+}
+
+static void tcg_get_spec_threads(Object *obj, Visitor *v,
+                                 const char *name, void *opaque,
+                                 Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->spec_threads;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_spec_threads(Object *obj, Visitor *v,
+                                 const char *name, void *opaque,
+                                 Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+#ifdef CONFIG_USER_ONLY
+    if (value) {
+        error_setg(errp, "spec-threads is only supported in system emulation");
+        return;
+    }
+#elif !defined(TARGET_SUPPORTS_TB_SPEC)
+    /* The translator may read vCPU state that changes while it runs. */
+    if (value) {
+        error_setg(errp, "spec-threads is not supported for this target");
+        return;
+    }
+#endif
+    s->spec_threads = value;
+}
+
 static void tcg_accel_class_init(ObjectClass *oc, void *data)
 {
     AccelClass *ac = ACCEL_CLASS(oc);
@@ -229,6 +295,18 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
         "Map jit pages into separate RW and RX regions");
+
+    object_class_property_add_str(oc, "tb-profile",
+                                  tcg_get_tb_profile,
+                                  tcg_set_tb_profile);
+    object_class_property_set_description(oc, "tb-profile",
+        "File to load and save translation block keys in");
+
+    object_class_property_add(oc, "spec-threads", "int",
+        tcg_get_spec_threads, tcg_set_spec_threads,
+        NULL, NULL);
+    object_class_property_set_description(oc, "spec-threads",
+        "Number of threads translating successor blocks in the background");
 }
 
 static const TypeInfo tcg_accel_type = {
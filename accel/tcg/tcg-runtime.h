@@ -25,6 +25,10 @@ DEF_HELPER_FLAGS_1(ctpop_i32, TCG_CALL_NO_RWG_SE, i32, i32)
 DEF_HELPER_FLAGS_1(ctpop_i64, TCG_CALL_NO_RWG_SE, i64, i64)
 
 DEF_HELPER_FLAGS_1(lookup_tb_ptr, TCG_CALL_NO_WG_SE, cptr, env)
+DEF_HELPER_FLAGS_4(lookup_tb_ptr_ic, TCG_CALL_NO_WG_SE, cptr, env, cptr,
+                   i64, i32)
+DEF_HELPER_FLAGS_4(lookup_tb_ptr_ras, TCG_CALL_NO_WG_SE, cptr, env, cptr,
+                   i64, i32)
 
 DEF_HELPER_FLAGS_1(exit_atomic, TCG_CALL_NO_WG, noreturn, env)
 
@@ -123,6 +127,10 @@ DEF_HELPER_3(cheri_invalidate_tags, void, env, cap_checked_ptr, memop_idx)
 /* Clear tags due to a store, last argument is whether the store succeeded. */
 DEF_HELPER_4(cheri_invalidate_tags_condition, void, env, cap_checked_ptr,
              memop_idx, i32)
+/* Lock the tags of an atomic in a parallel TB, see cheri_tag_store_begin(). */
+DEF_HELPER_3(cheri_tag_store_begin, void, env, cap_checked_ptr, memop_idx)
+/* Clear the tags if the last argument is set and unlock them again. */
+DEF_HELPER_2(cheri_tag_store_end, void, env, i32)
 
 #endif
 
@@ -315,6 +323,7 @@ DEF_HELPER_FLAGS_0(qemu_log_instr_allcpu_start, TCG_CALL_NO_WG, void)
 DEF_HELPER_FLAGS_0(qemu_log_instr_allcpu_user_start, TCG_CALL_NO_WG, void)
 DEF_HELPER_FLAGS_0(qemu_log_instr_allcpu_stop, TCG_CALL_NO_WG, void)
 DEF_HELPER_FLAGS_1(qemu_log_instr_commit, TCG_CALL_NO_WG, void, env)
+DEF_HELPER_FLAGS_1(qemu_log_instr_filtered, TCG_CALL_NO_WG, void, env)
 DEF_HELPER_FLAGS_4(qemu_log_instr_load64, TCG_CALL_NO_WG, void, env,
                    cap_checked_ptr, i64, memop_idx)
 DEF_HELPER_FLAGS_4(qemu_log_instr_store64, TCG_CALL_NO_WG, void, env,
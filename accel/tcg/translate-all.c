@@ -47,6 +47,7 @@
 
 #include "exec/cputlb.h"
 #include "exec/translate-all.h"
+#include "exec/translator.h"
 #include "qemu/bitmap.h"
 #include "qemu/qemu-print.h"
 #include "qemu/timer.h"
@@ -893,8 +894,11 @@ static bool tb_cmp(const void *ap, const void *bp)
 
     return a->pc == b->pc &&
         a->cs_base == b->cs_base &&
-        a->pcc_base == b->pcc_base &&
-        a->pcc_top == b->pcc_top &&
+        a->pcc_bounds_exact == b->pcc_bounds_exact &&
+        (a->pcc_bounds_exact ?
+         (a->pcc_base == b->pcc_base && a->pcc_top == b->pcc_top) :
+         (a->pcc_used_base == b->pcc_used_base &&
+          a->pcc_used_top == b->pcc_used_top)) &&
         a->cheri_flags == b->cheri_flags &&
         a->flags == b->flags &&
         (tb_cflags(a) & ~CF_INVALID) == (tb_cflags(b) & ~CF_INVALID) &&
@@ -978,6 +982,9 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
         goto done;
     }
     did_flush = true;
+#ifdef CONFIG_SOFTMMU
+    tb_spec_flush_begin();
+#endif
 
     if (DEBUG_TB_FLUSH_GATE) {
         size_t nb_tbs = tcg_nb_tbs();
@@ -999,6 +1006,9 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
     /* XXX: flush processor icache at this point if cache flush is
        expensive */
     qatomic_mb_set(&tb_ctx.tb_flush_count, tb_ctx.tb_flush_count + 1);
+#ifdef CONFIG_SOFTMMU
+    tb_spec_flush_end();
+#endif
 
 done:
     mmap_unlock();
@@ -1381,15 +1391,75 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
     return tb;
 }
 
-/* Called with mmap_lock held for user mode emulation.  */
-TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
-                              target_ulong cs_base, target_ulong pcc_base,
-                              target_ulong pcc_top, uint32_t cheri_flags,
-                              uint32_t flags, int cflags)
+#ifdef TARGET_CHERI
+struct tb_pcc_dup_desc {
+    const TranslationBlock *tb;
+    tb_page_addr_t phys_page1;
+};
+
+/* Match TBs for the same code that were translated for other PCC bounds */
+static bool tb_pcc_dup_cmp(const void *p, const void *d)
+{
+    const TranslationBlock *tb = p;
+    const struct tb_pcc_dup_desc *desc = d;
+
+    return tb->pc == desc->tb->pc &&
+        tb->page_addr[0] == desc->phys_page1 &&
+        tb->cs_base == desc->tb->cs_base &&
+        tb->cheri_flags == desc->tb->cheri_flags &&
+        tb->flags == desc->tb->flags &&
+        tb->trace_vcpu_dstate == desc->tb->trace_vcpu_dstate &&
+        (tb_cflags(tb) & ~CF_INVALID) == desc->tb->cflags;
+}
+
+/*
+ * Count translations that duplicate an existing TB only because the PCC
+ * bounds are different. These are reported by "info jit".
+ */
+static void tb_count_pcc_duplicate(const TranslationBlock *tb,
+                                   tb_page_addr_t phys_pc)
+{
+    struct tb_pcc_dup_desc desc = {
+        .tb = tb,
+        .phys_page1 = phys_pc & TARGET_PAGE_MASK,
+    };
+    uint32_t h = tb_hash_func(phys_pc, tb->pc, tb->flags, tb->cflags,
+                              tb->trace_vcpu_dstate);
+
+    if (qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_pcc_dup_cmp)) {
+        qatomic_inc(&tb_ctx.tb_pcc_dup_count);
+    }
+}
+#endif
+
+/* Give the space of a TB that will not be used back to the code buffer. */
+static void tb_gen_code_discard(TranslationBlock *tb,
+                                tcg_insn_unit *gen_code_buf)
+{
+    uintptr_t orig_aligned = (uintptr_t)gen_code_buf;
+
+    orig_aligned -= ROUND_UP(sizeof(*tb), qemu_icache_linesize);
+    qatomic_set(&tcg_ctx->code_gen_ptr, (void *)orig_aligned);
+}
+
+/*
+ * Translate the TB at @pc, whose first byte is at @phys_pc. A @background
+ * translation runs on a thread other than the vCPU's and reads the guest code
+ * through translator_set_code_page(): it returns NULL instead of flushing the
+ * code buffer or translating code outside of that page.
+ */
+static TranslationBlock *tb_gen_code_phys(CPUState *cpu, target_ulong pc,
+                                          target_ulong cs_base,
+                                          target_ulong pcc_base,
+                                          target_ulong pcc_top,
+                                          uint32_t cheri_flags,
+                                          uint32_t flags, int cflags,
+                                          tb_page_addr_t phys_pc,
+                                          bool background)
 {
     CPUArchState *env = cpu->env_ptr;
     TranslationBlock *tb, *existing_tb;
-    tb_page_addr_t phys_pc, phys_page2;
+    tb_page_addr_t phys_page2;
     target_ulong virt_page2;
     tcg_insn_unit *gen_code_buf;
     int gen_code_size, search_size, max_insns;
@@ -1398,11 +1468,8 @@ TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
     int64_t ti;
 #endif
 
-    assert_memory_lock();
     qemu_thread_jit_write();
 
-    phys_pc = get_page_addr_code(env, pc);
-
     if (phys_pc == -1) {
         /* Generate a one-shot TB with 1 insn in it */
         cflags = (cflags & ~CF_COUNT_MASK) | CF_LAST_IO | 1;
@@ -1417,6 +1484,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
  buffer_overflow:
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
+        if (background) {
+            return NULL;
+        }
         /* flush must be done */
         tb_flush(cpu);
         mmap_unlock();
@@ -1431,6 +1501,10 @@ TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
     tb->cs_base = cs_base;
     tb->pcc_base = pcc_base;
     tb->pcc_top = pcc_top;
+    /* Updated by the translator if the code does not depend on exact bounds */
+    tb->pcc_used_base = pcc_base;
+    tb->pcc_used_top = pcc_top;
+    tb->pcc_bounds_exact = true;
     tb->cheri_flags = cheri_flags;
     tb->flags = flags;
     tb->cflags = cflags;
@@ -1457,6 +1531,12 @@ TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
     tcg_ctx->cpu = NULL;
     max_insns = tb->icount;
 
+    if (background && translator_code_page_fault()) {
+        /* The TB needs code from another page, leave it to the vCPU. */
+        tb_gen_code_discard(tb, gen_code_buf);
+        return NULL;
+    }
+
     trace_translate_block(tb, tb->pc, tb->tc.ptr);
 
     /* generate machine code */
@@ -1643,8 +1723,13 @@ TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
     virt_page2 = (pc + tb->size - 1) & TARGET_PAGE_MASK;
     phys_page2 = -1;
     if ((pc & TARGET_PAGE_MASK) != virt_page2) {
+        /* Background translations cannot load from a second page. */
+        g_assert(!background);
         phys_page2 = get_page_addr_code(env, virt_page2);
     }
+#ifdef TARGET_CHERI
+    tb_count_pcc_duplicate(tb, phys_pc);
+#endif
     /*
      * No explicit memory barrier is required -- tb_link_page() makes the
      * TB visible in a consistent state.
@@ -1652,16 +1737,99 @@ TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
     existing_tb = tb_link_page(tb, phys_pc, phys_page2);
     /* if the TB already exists, discard what we just translated */
     if (unlikely(existing_tb != tb)) {
-        uintptr_t orig_aligned = (uintptr_t)gen_code_buf;
-
-        orig_aligned -= ROUND_UP(sizeof(*tb), qemu_icache_linesize);
-        qatomic_set(&tcg_ctx->code_gen_ptr, (void *)orig_aligned);
         tcg_tb_remove(tb);
+        tb_gen_code_discard(tb, gen_code_buf);
         return existing_tb;
     }
+#ifdef CONFIG_SOFTMMU
+    if (unlikely(tb_profile_enabled)) {
+        tb_profile_record(cpu, tb, phys_pc, phys_page2);
+    }
+#endif
+    return tb;
+}
+
+/* Called with mmap_lock held for user mode emulation.  */
+TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
+                              target_ulong cs_base, target_ulong pcc_base,
+                              target_ulong pcc_top, uint32_t cheri_flags,
+                              uint32_t flags, int cflags)
+{
+    assert_memory_lock();
+
+    return tb_gen_code_phys(cpu, pc, cs_base, pcc_base, pcc_top, cheri_flags,
+                            flags, cflags, get_page_addr_code(cpu->env_ptr, pc),
+                            false);
+}
+
+#ifdef CONFIG_SOFTMMU
+TranslationBlock *tb_gen_code_background(CPUState *cpu, target_ulong pc,
+                                         target_ulong cs_base,
+                                         target_ulong pcc_base,
+                                         target_ulong pcc_top,
+                                         uint32_t cheri_flags, uint32_t flags,
+                                         int cflags, tb_page_addr_t phys_pc,
+                                         const void *host_page)
+{
+    TranslationBlock *tb;
+
+    translator_set_code_page(pc, host_page);
+    tb = tb_gen_code_phys(cpu, pc, cs_base, pcc_base, pcc_top, cheri_flags,
+                          flags, cflags, phys_pc, true);
+    translator_set_code_page(0, NULL);
     return tb;
 }
 
+struct tb_phys_desc {
+    target_ulong pc;
+    target_ulong cs_base;
+    target_ulong pcc_base;
+    target_ulong pcc_top;
+    tb_page_addr_t phys_page1;
+    uint32_t cheri_flags;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t trace_vcpu_dstate;
+};
+
+/* Like tb_lookup_cmp(), but single page TBs only as there is no TLB to use */
+static bool tb_lookup_phys_cmp(const void *p, const void *d)
+{
+    const TranslationBlock *tb = p;
+    const struct tb_phys_desc *desc = d;
+
+    return tb->pc == desc->pc && tb->page_addr[0] == desc->phys_page1 &&
+           tb->page_addr[1] == -1 && tb->cs_base == desc->cs_base &&
+           tb_pcc_bounds_match(tb, desc->pcc_base, desc->pcc_top) &&
+           tb->cheri_flags == desc->cheri_flags &&
+           tb->flags == desc->flags &&
+           tb->trace_vcpu_dstate == desc->trace_vcpu_dstate &&
+           tb_cflags(tb) == desc->cflags;
+}
+
+bool tb_exists_phys(CPUState *cpu, target_ulong pc, target_ulong cs_base,
+                    target_ulong pcc_base, target_ulong pcc_top,
+                    uint32_t cheri_flags, uint32_t flags, uint32_t cflags,
+                    tb_page_addr_t phys_pc)
+{
+    struct tb_phys_desc desc = {
+        .pc = pc,
+        .cs_base = cs_base,
+        .pcc_base = pcc_base,
+        .pcc_top = pcc_top,
+        .phys_page1 = phys_pc & TARGET_PAGE_MASK,
+        .cheri_flags = cheri_flags,
+        .flags = flags,
+        .cflags = cflags,
+        .trace_vcpu_dstate = *cpu->trace_dstate,
+    };
+    uint32_t h = tb_hash_func(phys_pc, pc, flags, cflags,
+                              desc.trace_vcpu_dstate);
+
+    return qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_lookup_phys_cmp);
+}
+#endif
+
 /*
  * @p must be non-NULL.
  * user-mode: call with mmap_lock held.
@@ -2058,6 +2226,7 @@ struct tb_tree_stats {
     size_t direct_jmp_count;
     size_t direct_jmp2_count;
     size_t cross_page;
+    size_t pcc_exact;
 };
 
 static gboolean tb_tree_stats_iter(gpointer key, gpointer value, gpointer data)
@@ -2074,6 +2243,9 @@ static gboolean tb_tree_stats_iter(gpointer key, gpointer value, gpointer data)
     if (tb->page_addr[1] != -1) {
         tst->cross_page++;
     }
+    if (tb->pcc_bounds_exact) {
+        tst->pcc_exact++;
+    }
     if (tb->jmp_reset_offset[0] != TB_JMP_RESET_OFFSET_INVALID) {
         tst->direct_jmp_count++;
         if (tb->jmp_reset_offset[1] != TB_JMP_RESET_OFFSET_INVALID) {
@@ -2088,6 +2260,8 @@ void dump_exec_info(GString *buf)
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
     size_t nb_tbs, flush_full, flush_part, flush_elide;
+    size_t large_refill, large_flush;
+    size_t ic_hits, ic_misses, ic_fills, ras_hits, ras_misses;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -2118,6 +2292,11 @@ void dump_exec_info(GString *buf)
                            nb_tbs ? (tst.direct_jmp_count * 100) / nb_tbs : 0,
                            tst.direct_jmp2_count,
                            nb_tbs ? (tst.direct_jmp2_count * 100) / nb_tbs : 0);
+#ifdef TARGET_CHERI
+    g_string_append_printf(buf, "exact PCC TB count  %zu (%zu%%)\n",
+                           tst.pcc_exact,
+                           nb_tbs ? (tst.pcc_exact * 100) / nb_tbs : 0);
+#endif
 
     qht_statistics_init(&tb_ctx.htable, &hst);
     print_qht_statistics(hst, buf);
@@ -2128,12 +2307,34 @@ void dump_exec_info(GString *buf)
                            qatomic_read(&tb_ctx.tb_flush_count));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
+#ifdef TARGET_CHERI
+    g_string_append_printf(buf, "TB PCC dup count    %u\n",
+                           qatomic_read(&tb_ctx.tb_pcc_dup_count));
+#endif
+
+    tb_ic_counts(&ic_hits, &ic_misses, &ic_fills, &ras_hits, &ras_misses);
+    g_string_append_printf(buf, "IC hits             %zu (%zu%%)\n",
+                           ic_hits, ic_hits + ic_misses ?
+                           ic_hits * 100 / (ic_hits + ic_misses) : 0);
+    g_string_append_printf(buf, "IC misses           %zu\n", ic_misses);
+    g_string_append_printf(buf, "IC fills            %zu\n", ic_fills);
+    g_string_append_printf(buf, "RAS hits            %zu (%zu%%)\n",
+                           ras_hits, ras_hits + ras_misses ?
+                           ras_hits * 100 / (ras_hits + ras_misses) : 0);
+    g_string_append_printf(buf, "RAS misses          %zu\n", ras_misses);
 
     tlb_flush_counts(&flush_full, &flush_part, &flush_elide);
     g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
     g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+    tlb_large_page_counts(&large_refill, &large_flush);
+    g_string_append_printf(buf, "TLB large refills   %zu\n", large_refill);
+    g_string_append_printf(buf, "TLB large flushes   %zu\n", large_flush);
     tcg_dump_info(buf);
+#ifdef CONFIG_SOFTMMU
+    tb_profile_dump_info(buf);
+    tb_spec_dump_info(buf);
+#endif
 }
 
 void dump_opcount_info(GString *buf)
@@ -20,6 +20,7 @@
 #include "sysemu/replay.h"
 
 #include "cheri-translate-utils-base.h"
+#include "tb-hash.h"
 
 /* Pairs with tcg_clear_temp_count.
    To be called by #TranslatorOps.{translate_insn,tb_stop} if
@@ -34,6 +35,53 @@ void translator_loop_temp_check(DisasContextBase *db)
     }
 }
 
+/*
+ * Guest code page used instead of the vCPU's TLB when translating on a
+ * background thread, see translator_set_code_page().
+ */
+static __thread struct {
+    target_ulong vaddr;
+    const uint8_t *host;
+    bool fault;
+} translator_code_page;
+
+/* Direct successors of the TB last translated on this thread */
+static __thread struct {
+    target_ulong pc[TRANSLATOR_MAX_SUCCESSORS];
+    int n;
+} translator_successors;
+
+void translator_set_code_page(target_ulong vaddr, const void *host)
+{
+    translator_code_page.vaddr = vaddr & TARGET_PAGE_MASK;
+    translator_code_page.host = host;
+    translator_code_page.fault = false;
+}
+
+bool translator_code_page_fault(void)
+{
+    return translator_code_page.fault;
+}
+
+int translator_get_successors(target_ulong *pcs)
+{
+    memcpy(pcs, translator_successors.pc,
+           translator_successors.n * sizeof(target_ulong));
+    return translator_successors.n;
+}
+
+static void translator_add_successor(target_ulong dest)
+{
+    for (int i = 0; i < translator_successors.n; i++) {
+        if (translator_successors.pc[i] == dest) {
+            return;
+        }
+    }
+    if (translator_successors.n < TRANSLATOR_MAX_SUCCESSORS) {
+        translator_successors.pc[translator_successors.n++] = dest;
+    }
+}
+
 bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest)
 {
     /* Suppress goto_tb if requested. */
@@ -42,7 +90,233 @@ bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest)
     }
 
     /* Check for the dest on the same page as the start of the TB.  */
-    return ((db->pc_first ^ dest) & TARGET_PAGE_MASK) == 0;
+    if (((db->pc_first ^ dest) & TARGET_PAGE_MASK) != 0) {
+        return false;
+    }
+    translator_add_successor(dest);
+    return true;
+}
+
+/* Offset of a CPUState field from cpu_env */
+#define CPU_ENV_OFFSET(field) \
+    (offsetof(ArchCPU, parent_obj.field) - offsetof(ArchCPU, env))
+
+/* -d exec logs every TB from the lookup helper. */
+static bool translator_use_ic(DisasContextBase *db)
+{
+    return !(tb_cflags(db->tb) & (CF_NO_GOTO_TB | CF_NO_GOTO_PTR)) &&
+           !qemu_loglevel_mask(CPU_LOG_TB_CPU | CPU_LOG_EXEC);
+}
+
+/* Load the target_ulong at @guard_ofs in env, zero-extended. */
+static void gen_load_guard(TCGv_i64 guard, intptr_t guard_ofs)
+{
+#if TARGET_LONG_BITS == 32
+    tcg_gen_ld32u_i64(guard, cpu_env, guard_ofs);
+#else
+    tcg_gen_ld_i64(guard, cpu_env, guard_ofs);
+#endif
+}
+
+/*
+ * Jump to the cached TB at @base + @way if it starts at @pc and, for a
+ * guarded jump (@guard_ofs >= 0), the guard in env still has the value at
+ * @base + @way_guard. Branch to @miss if the TB has been invalidated. @base
+ * must be cpu_env or a local temp, since it is used across branches.
+ */
+static void gen_goto_cached_tb(TCGv_ptr base, intptr_t way, intptr_t way_guard,
+                               TCGv pc, intptr_t guard_ofs, intptr_t hits,
+                               TCGLabel *miss)
+{
+    TCGLabel *next = gen_new_label();
+    TCGv_ptr ptr = tcg_temp_new_ptr();
+    TCGv tb_pc = tcg_temp_new();
+    TCGv_i32 cflags = tcg_temp_new_i32();
+
+    /* Temps do not live across branches, reload the way after each. */
+    tcg_gen_ld_ptr(ptr, base, way);
+    tcg_gen_ld_tl(tb_pc, ptr, offsetof(TranslationBlock, pc));
+    tcg_gen_brcond_tl(TCG_COND_NE, tb_pc, pc, next);
+    if (guard_ofs >= 0) {
+        TCGv_i64 guard = tcg_temp_new_i64();
+        TCGv_i64 cached = tcg_temp_new_i64();
+
+        gen_load_guard(guard, guard_ofs);
+        tcg_gen_ld_i64(cached, base, way_guard);
+        tcg_gen_brcond_i64(TCG_COND_NE, guard, cached, next);
+        tcg_temp_free_i64(guard);
+        tcg_temp_free_i64(cached);
+    }
+    tcg_gen_ld_ptr(ptr, base, way);
+    tcg_gen_ld_i32(cflags, ptr, offsetof(TranslationBlock, cflags));
+    tcg_gen_andi_i32(cflags, cflags, CF_INVALID);
+    tcg_gen_brcondi_i32(TCG_COND_NE, cflags, 0, miss);
+
+    tcg_gen_ld_ptr(ptr, cpu_env, hits);
+    tcg_gen_addi_ptr(ptr, ptr, 1);
+    tcg_gen_st_ptr(ptr, cpu_env, hits);
+    tcg_gen_ld_ptr(ptr, base, way);
+    tcg_gen_ld_ptr(ptr, ptr, offsetof(TranslationBlock, tc.ptr));
+    tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(ptr));
+    gen_set_label(next);
+
+    tcg_temp_free_ptr(ptr);
+    tcg_temp_free(tb_pc);
+    tcg_temp_free_i32(cflags);
+}
+
+/* Call the miss @helper with the guard and jump to the TB it returns. */
+static void gen_goto_ptr_miss(DisasContextBase *db, intptr_t guard_ofs,
+                              void (*helper)(TCGv_ptr, TCGv_ptr, TCGv_ptr,
+                                             TCGv_i64, TCGv_i32))
+{
+    TCGv_ptr ptr = tcg_temp_new_ptr();
+    TCGv_ptr site = tcg_const_ptr(db->tb);
+    TCGv_i64 guard = tcg_const_i64(0);
+
+    if (guard_ofs >= 0) {
+        gen_load_guard(guard, guard_ofs);
+    }
+    helper(ptr, cpu_env, site, guard, tcg_constant_i32(guard_ofs >= 0));
+    tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(ptr));
+    tcg_temp_free_i64(guard);
+    tcg_temp_free_ptr(site);
+    tcg_temp_free_ptr(ptr);
+}
+
+static void gen_lookup_and_goto_ptr_ic(DisasContextBase *db, TCGv pc,
+                                       intptr_t guard_ofs)
+{
+    intptr_t entry = CPU_ENV_OFFSET(tb_ic) +
+                     tb_ic_hash_func(db->pc_first) * sizeof(TBICEntry);
+    TCGLabel *miss;
+    TCGv_ptr ptr;
+    int i;
+
+    if (!translator_use_ic(db)) {
+        tcg_gen_lookup_and_goto_ptr();
+        return;
+    }
+
+    plugin_gen_disable_mem_helpers();
+    miss = gen_new_label();
+    ptr = tcg_temp_new_ptr();
+    tcg_gen_ld_ptr(ptr, cpu_env, entry + offsetof(TBICEntry, site));
+    tcg_gen_brcondi_ptr(TCG_COND_NE, ptr, (intptr_t)db->tb, miss);
+    tcg_temp_free_ptr(ptr);
+
+    for (i = 0; i < TB_IC_WAYS; i++) {
+        gen_goto_cached_tb(cpu_env,
+                           entry + offsetof(TBICEntry, tb) +
+                               i * sizeof(TranslationBlock *),
+                           entry + offsetof(TBICEntry, guard) +
+                               i * sizeof(uint64_t),
+                           pc, guard_ofs, CPU_ENV_OFFSET(tb_ic_hits), miss);
+    }
+
+    gen_set_label(miss);
+    gen_goto_ptr_miss(db, guard_ofs, gen_helper_lookup_tb_ptr_ic);
+}
+
+void translator_lookup_and_goto_ptr(DisasContextBase *db, TCGv pc)
+{
+    gen_lookup_and_goto_ptr_ic(db, pc, -1);
+}
+
+void translator_lookup_and_goto_ptr_guarded(DisasContextBase *db, TCGv pc,
+                                            intptr_t guard_ofs)
+{
+    tcg_debug_assert(guard_ofs >= 0);
+    gen_lookup_and_goto_ptr_ic(db, pc, guard_ofs);
+}
+
+/* Load the address of the return address stack entry at the top into @entry */
+static void gen_ras_top(TCGv_ptr entry, TCGv_i32 top)
+{
+    TCGv_i32 ofs = tcg_temp_new_i32();
+
+    tcg_gen_muli_i32(ofs, top, sizeof(TBRASEntry));
+    tcg_gen_ext_i32_ptr(entry, ofs);
+    tcg_gen_add_ptr(entry, entry, cpu_env);
+    tcg_temp_free_i32(ofs);
+}
+
+void translator_push_return(DisasContextBase *db, target_ulong ret_pc)
+{
+    intptr_t ras = CPU_ENV_OFFSET(tb_ras);
+    TCGv_i32 top;
+    TCGv_ptr entry, null;
+    TCGv_i64 pc;
+    TCGLabel *same;
+
+    if (!translator_use_ic(db)) {
+        return;
+    }
+
+    top = tcg_temp_new_i32();
+    entry = tcg_temp_local_new_ptr();
+    pc = tcg_temp_new_i64();
+    same = gen_new_label();
+
+    tcg_gen_ld_i32(top, cpu_env, CPU_ENV_OFFSET(tb_ras_top));
+    tcg_gen_addi_i32(top, top, 1);
+    tcg_gen_andi_i32(top, top, TB_RAS_SIZE - 1);
+    tcg_gen_st_i32(top, cpu_env, CPU_ENV_OFFSET(tb_ras_top));
+    gen_ras_top(entry, top);
+
+    /* Keep the cached target if the entry already returns to ret_pc. */
+    tcg_gen_ld_i64(pc, entry, ras + offsetof(TBRASEntry, pc));
+    tcg_gen_brcondi_i64(TCG_COND_EQ, pc, ret_pc, same);
+    tcg_gen_st_i64(tcg_constant_i64(ret_pc), entry,
+                   ras + offsetof(TBRASEntry, pc));
+    null = tcg_const_ptr(NULL);
+    tcg_gen_st_ptr(null, entry, ras + offsetof(TBRASEntry, site));
+    tcg_temp_free_ptr(null);
+    gen_set_label(same);
+
+    tcg_temp_free_i32(top);
+    tcg_temp_free_ptr(entry);
+    tcg_temp_free_i64(pc);
+}
+
+void translator_return_and_goto_ptr(DisasContextBase *db, TCGv pc,
+                                    intptr_t guard_ofs)
+{
+    intptr_t ras = CPU_ENV_OFFSET(tb_ras);
+    TCGLabel *miss;
+    TCGv_i32 top;
+    TCGv_ptr entry, ptr;
+
+    if (!translator_use_ic(db)) {
+        tcg_gen_lookup_and_goto_ptr();
+        return;
+    }
+
+    plugin_gen_disable_mem_helpers();
+    miss = gen_new_label();
+    top = tcg_temp_new_i32();
+    entry = tcg_temp_local_new_ptr();
+    ptr = tcg_temp_new_ptr();
+
+    /* Pop the entry. On a miss, the helper fills the popped entry. */
+    tcg_gen_ld_i32(top, cpu_env, CPU_ENV_OFFSET(tb_ras_top));
+    gen_ras_top(entry, top);
+    tcg_gen_subi_i32(top, top, 1);
+    tcg_gen_andi_i32(top, top, TB_RAS_SIZE - 1);
+    tcg_gen_st_i32(top, cpu_env, CPU_ENV_OFFSET(tb_ras_top));
+
+    tcg_gen_ld_ptr(ptr, entry, ras + offsetof(TBRASEntry, site));
+    tcg_gen_brcondi_ptr(TCG_COND_NE, ptr, (intptr_t)db->tb, miss);
+    gen_goto_cached_tb(entry, ras + offsetof(TBRASEntry, tb),
+                       ras + offsetof(TBRASEntry, guard), pc, guard_ofs,
+                       CPU_ENV_OFFSET(tb_ras_hits), miss);
+
+    gen_set_label(miss);
+    gen_goto_ptr_miss(db, guard_ofs, gen_helper_lookup_tb_ptr_ras);
+
+    tcg_temp_free_i32(top);
+    tcg_temp_free_ptr(entry);
+    tcg_temp_free_ptr(ptr);
 }
 
 static inline void translator_page_protect(DisasContextBase *dcbase,
@@ -64,8 +338,11 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
      * Cache whether we are logging instructions in this tb
      * This assumes that the TCG buffer will be flushed on instruction
      * log level changes.
+     * TBs excluded by the trace filter are translated as if logging was off.
      */
-    const bool log_instr_enabled = qemu_log_instr_enabled(cpu->env_ptr);
+    const bool log_instr_filtered = (cflags & CF_LOG_INSTR_FILTERED) != 0;
+    const bool log_instr_enabled = qemu_log_instr_enabled(cpu->env_ptr) &&
+        !log_instr_filtered;
 #endif
 
     /* Initialize DisasContext */
@@ -76,12 +353,19 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
     db->num_insns = 0;
     db->max_insns = max_insns;
     db->singlestep_enabled = cflags & CF_SINGLE_STEP;
+    translator_successors.n = 0;
 #ifdef TARGET_CHERI
     db->pcc_base = tb->pcc_base;
     db->pcc_top = tb->pcc_top;
-    cheri_debug_assert(db->pcc_base ==
+    db->pcc_used_base = ~(target_ulong)0;
+    db->pcc_used_top = 0;
+    db->pcc_bounds_exact = false;
+    /* Background translations are for a future PCC of the vCPU. */
+    cheri_debug_assert(translator_code_page.host ||
+                       db->pcc_base ==
                        cap_get_base(cheri_get_recent_pcc(cpu->env_ptr)));
-    cheri_debug_assert(db->pcc_top ==
+    cheri_debug_assert(translator_code_page.host ||
+                       db->pcc_top ==
                        cap_get_top(cheri_get_recent_pcc(cpu->env_ptr)));
     db->cheri_flags = tb->cheri_flags;
     disas_capreg_reset_all(db);
@@ -117,6 +401,9 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
     if (unlikely(log_instr_enabled)) {
         qemu_log_gen_printf_flush(db, true, true);
         gen_helper_qemu_log_instr_commit(cpu_env);
+    } else if (unlikely(log_instr_filtered)) {
+        /* Commit the last logged instruction and drop until the next one */
+        gen_helper_qemu_log_instr_filtered(cpu_env);
     }
 #endif
 #ifdef TARGET_CHERI
@@ -209,6 +496,13 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
     ops->tb_stop(db, cpu);
     gen_tb_end(db->tb, db->num_insns);
 
+#ifdef TARGET_CHERI
+    /* Record which PCC bounds the generated code is valid for. */
+    tb->pcc_used_base = db->pcc_used_base;
+    tb->pcc_used_top = db->pcc_used_top;
+    tb->pcc_bounds_exact = db->pcc_bounds_exact;
+#endif
+
     if (plugin_enabled) {
         plugin_gen_tb_end(cpu);
     }
@@ -241,12 +535,33 @@ static inline void translator_maybe_page_protect(DisasContextBase *dcbase,
 #endif
 }
 
-#define GEN_TRANSLATOR_LD(fullname, type, load_fn, swap_fn)             \
+/*
+ * Load from the page set with translator_set_code_page(). Code outside of it
+ * reads as zero and marks the translation as unusable.
+ */
+static inline const void *translator_code_page_ptr(target_ulong pc,
+                                                   size_t len)
+{
+    if (((pc ^ translator_code_page.vaddr) & TARGET_PAGE_MASK) != 0 ||
+        ((pc + len - 1) ^ translator_code_page.vaddr) & TARGET_PAGE_MASK) {
+        translator_code_page.fault = true;
+        return NULL;
+    }
+    return translator_code_page.host + (pc & ~TARGET_PAGE_MASK);
+}
+
+#define GEN_TRANSLATOR_LD(fullname, type, load_fn, host_fn, swap_fn)    \
     type fullname ## _swap(CPUArchState *env, DisasContextBase *dcbase, \
                            abi_ptr pc, bool do_swap)                    \
     {                                                                   \
+        type ret;                                                       \
         translator_maybe_page_protect(dcbase, pc, sizeof(type));        \
-        type ret = load_fn(env, pc);                                    \
+        if (unlikely(translator_code_page.host)) {                      \
+            const void *host = translator_code_page_ptr(pc, sizeof(type)); \
+            ret = host ? host_fn(host) : 0;                             \
+        } else {                                                        \
+            ret = load_fn(env, pc);                                     \
+        }                                                               \
         if (do_swap) {                                                  \
             ret = swap_fn(ret);                                         \
         }                                                               \
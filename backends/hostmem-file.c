@@ -84,6 +84,27 @@ static void set_mem_path(Object *o, const char *str, Error **errp)
     fb->mem_path = g_strdup(str);
 }
 
+static char *get_cheri_tags_path(Object *o, Error **errp)
+{
+    HostMemoryBackend *backend = MEMORY_BACKEND(o);
+
+    return g_strdup(backend->cheri_tags_path);
+}
+
+static void set_cheri_tags_path(Object *o, const char *str, Error **errp)
+{
+    HostMemoryBackend *backend = MEMORY_BACKEND(o);
+
+    if (host_memory_backend_mr_inited(backend)) {
+        error_setg(errp, "cannot change property 'cheri-tags-path' of %s",
+                   object_get_typename(o));
+        return;
+    }
+    g_free(backend->cheri_tags_path);
+    backend->cheri_tags_path = g_strdup(str);
+    backend->cheri_tags = true;
+}
+
 static bool file_memory_backend_get_discard_data(Object *o, Error **errp)
 {
     return MEMORY_BACKEND_FILE(o)->discard_data;
@@ -204,6 +225,8 @@ file_backend_class_init(ObjectClass *oc, void *data)
     object_class_property_add_bool(oc, "readonly",
         file_memory_backend_get_readonly,
         file_memory_backend_set_readonly);
+    object_class_property_add_str(oc, "cheri-tags-path",
+        get_cheri_tags_path, set_cheri_tags_path);
 }
 
 static void file_backend_instance_finalize(Object *o)
@@ -211,6 +234,7 @@ static void file_backend_instance_finalize(Object *o)
     HostMemoryBackendFile *fb = MEMORY_BACKEND_FILE(o);
 
     g_free(fb->mem_path);
+    g_free(MEMORY_BACKEND(o)->cheri_tags_path);
 }
 
 static const TypeInfo file_backend_info = {
@@ -333,6 +333,17 @@ __attribute__((weak)) void cheri_tag_init(MemoryRegion *mr,
      */
 }
 
+bool cheri_tag_init_file(MemoryRegion *mr, uint64_t memory_size,
+                         const char *path, bool shared, Error **errp);
+__attribute__((weak)) bool cheri_tag_init_file(MemoryRegion *mr,
+                                               uint64_t memory_size,
+                                               const char *path, bool shared,
+                                               Error **errp)
+{
+    error_setg(errp, "CHERI tag files are only supported on CHERI targets");
+    return false;
+}
+
 static void
 host_memory_backend_memory_complete(UserCreatable *uc, Error **errp)
 {
@@ -409,8 +420,15 @@ host_memory_backend_memory_complete(UserCreatable *uc, Error **errp)
                 goto out;
             }
         }
-        if (backend->cheri_tags)
+        if (backend->cheri_tags_path) {
+            if (!cheri_tag_init_file(&backend->mr, sz,
+                                     backend->cheri_tags_path, backend->share,
+                                     &local_err)) {
+                goto out;
+            }
+        } else if (backend->cheri_tags) {
             cheri_tag_init(&backend->mr, sz);
+        }
     }
 out:
     error_propagate(errp, local_err);
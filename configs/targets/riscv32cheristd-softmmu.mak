@@ -8,5 +8,4 @@ TARGET_XML_FILES= gdb-xml/riscv-32bit-cpu.xml gdb-xml/riscv-32bit-fpu.xml gdb-xm
 TARGET_CHERI=y
 TARGET_CHERI_RISCV_STD=y
 TARGET_CHERI_RISCV_STD_093=y
-# Capability loads/stores+tagged memory don't work with MTTCG
-TARGET_SUPPORTS_MTTCG=n
+TARGET_SUPPORTS_MTTCG=y
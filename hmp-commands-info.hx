@@ -222,6 +222,56 @@ SRST
     Show virtual to physical memory mappings.
 ERST
 
+#if defined(TARGET_CHERI)
+    {
+        .name       = "cheri_tags",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show CHERI tag memory usage per RAM block",
+        .cmd        = hmp_info_cheri_tags,
+    },
+#endif
+
+SRST
+  ``info cheri_tags``
+    Show the number of populated CHERI tag blocks, set tags and host memory
+    used for tags (resident pages of the tag mapping) for each RAM block.
+ERST
+
+#if defined(TARGET_CHERI)
+    {
+        .name       = "cheri-stats",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show the CHERI statistics counters",
+        .cmd        = hmp_info_cheri_stats,
+    },
+#endif
+
+SRST
+  ``info cheri-stats``
+    Show the CHERI capability load/store and bounds counters of each vCPU
+    and, if QEMU was built with ``DO_CHERI_STATISTICS``, a summary of the
+    out-of-bounds capability histograms.
+ERST
+
+#if defined(TARGET_CHERI)
+    {
+        .name       = "cheri_provenance",
+        .args_type  = "addr:l",
+        .params     = "addr",
+        .help       = "show where the capability at a physical address was stored",
+        .cmd        = hmp_info_cheri_provenance,
+    },
+#endif
+
+SRST
+  ``info cheri_provenance`` *addr*
+    Show whether the capability-sized granule at guest physical address
+    *addr* is tagged and, if recorded (see ``-cheri-provenance``), the PC and
+    ASID of the instruction that stored it.
+ERST
+
 #if defined(TARGET_I386) || defined(TARGET_RISCV)
     {
         .name       = "mem",
@@ -1758,4 +1758,38 @@ ERST
 SRST
 ``cheri_trace_buffer_size`` *buffer_size*
   Set the instruction trace buffer size to the given number of entries..
+ERST
+
+#if defined(TARGET_CHERI)
+    {
+        .name       = "cheri_provenance",
+        .args_type  = "enable:b",
+        .params     = "on|off",
+        .help       = "record the PC of capability stores",
+        .cmd        = hmp_cheri_provenance,
+    },
+#endif
+
+SRST
+``cheri_provenance on|off``
+  Enable or disable recording of the PC and ASID of each tagged capability
+  store, like ``-cheri-provenance``. Use ``info cheri_provenance`` to query
+  the recorded information. Turning recording back on forgets everything
+  recorded before, since tags may have been set meanwhile without a record.
+ERST
+
+#if defined(TARGET_CHERI)
+    {
+        .name       = "cheri_provenance_dump",
+        .args_type  = "filename:F",
+        .params     = "filename",
+        .help       = "write the provenance of all tagged capabilities to a file",
+        .cmd        = hmp_cheri_provenance_dump,
+    },
+#endif
+
+SRST
+``cheri_provenance_dump`` *filename*
+  Write one ``ramblock offset pc asid`` line for each tagged capability in
+  guest RAM whose store was recorded to *filename*.
 ERST
\ No newline at end of file
@@ -0,0 +1,204 @@
+/*
+ * QEMU CHERI revocation sweep device
+ *
+ * Sweeps a range of guest physical memory and clears the tags of all
+ * capabilities whose base is marked in a guest-provided revocation bitmap,
+ * see include/hw/riscv/revoker.h for the register map. The sweep runs
+ * synchronously when CTRL is written, so the guest sees it complete once the
+ * store returns.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2 or later, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/riscv/revoker.h"
+#include "qapi/error.h"
+#include "qemu/log.h"
+#include "qemu/module.h"
+#include "exec/address-spaces.h"
+#include "hw/qdev-properties.h"
+#ifdef TARGET_CHERI
+#include "cheri_tagmem.h"
+#endif
+
+#define REG(offset) ((offset) / sizeof(uint64_t))
+
+static uint64_t revoker_read(void *opaque, hwaddr addr, unsigned int size)
+{
+    RevokerDeviceState *s = opaque;
+
+    if (addr + size > REVOKER_REGS_SIZE) {
+        return 0;
+    }
+    return extract64(s->regs[REG(addr)], (addr & 7) * 8, size * 8);
+}
+
+static void revoker_write(void *opaque, hwaddr addr, uint64_t data,
+                          unsigned int size)
+{
+    RevokerDeviceState *s = opaque;
+    RevokerClass *c = REVOKER_DEVICE_GET_CLASS(s);
+
+    if (addr + size > REVOKER_REGS_SIZE) {
+        return;
+    }
+    switch (addr & ~7) {
+    case REVOKER_ID:
+    case REVOKER_STATUS:
+    case REVOKER_SCANNED:
+    case REVOKER_REVOKED:
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "%s: write to read-only register 0x%" HWADDR_PRIx "\n",
+                      __func__, addr);
+        return;
+    }
+    s->regs[REG(addr)] = deposit64(s->regs[REG(addr)], (addr & 7) * 8,
+                                   size * 8, data);
+
+    if (s->regs[REG(REVOKER_CTRL)] & REVOKER_CTRL_START) {
+        s->regs[REG(REVOKER_CTRL)] &= ~REVOKER_CTRL_START;
+        if (c->sweep) {
+            c->sweep(s);
+        }
+    }
+}
+
+static const MemoryRegionOps revoker_ops = {
+    .read = revoker_read,
+    .write = revoker_write,
+    .endianness = DEVICE_LITTLE_ENDIAN,
+    .valid.min_access_size = 4,
+    .valid.max_access_size = 8,
+    .impl.min_access_size = 4,
+    .impl.max_access_size = 8,
+};
+
+#ifdef TARGET_CHERI
+static void revoker_sweep(RevokerDeviceState *s)
+{
+    uint64_t *regs = s->regs;
+    hwaddr addr = regs[REG(REVOKER_SWEEP_START)];
+    hwaddr end = regs[REG(REVOKER_SWEEP_END)];
+    uint64_t bitmap_size = regs[REG(REVOKER_BITMAP_SIZE)];
+    unsigned threads = s->threads;
+    CheriRevokeRequest req = {
+        .bitmap_base = regs[REG(REVOKER_BITMAP_BASE)],
+        .bitmap_bits = bitmap_size * 8,
+    };
+    uint64_t scanned = 0, revoked = 0;
+
+    regs[REG(REVOKER_STATUS)] = REVOKER_STATUS_OK;
+    if (!threads) {
+        long host_procs = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = host_procs > 0 ? host_procs : 1;
+    }
+
+    /* The bitmap is read directly, so it must be a single piece of RAM. */
+    MemoryRegionSection bitmap = {};
+    if (bitmap_size) {
+        bitmap = memory_region_find(get_system_memory(),
+                                    regs[REG(REVOKER_BITMAP_ADDR)],
+                                    bitmap_size);
+    }
+    if (!bitmap.mr || !memory_region_is_ram(bitmap.mr) ||
+        int128_get64(bitmap.size) != bitmap_size) {
+        regs[REG(REVOKER_STATUS)] = REVOKER_STATUS_BAD_BITMAP;
+        goto out;
+    }
+    req.bitmap = (uint8_t *)memory_region_get_ram_ptr(bitmap.mr) +
+                 bitmap.offset_within_region;
+
+    while (addr < end) {
+        MemoryRegionSection section =
+            memory_region_find(get_system_memory(), addr, end - addr);
+        if (!section.mr || section.offset_within_address_space != addr ||
+            !memory_region_is_ram(section.mr) || !section.mr->ram_block) {
+            regs[REG(REVOKER_STATUS)] = REVOKER_STATUS_BAD_RANGE;
+            if (section.mr) {
+                memory_region_unref(section.mr);
+            }
+            break;
+        }
+        RAMBlock *ram = section.mr->ram_block;
+        ram_addr_t offset = memory_region_get_ram_addr(section.mr) -
+                            ram->offset + section.offset_within_region;
+        uint64_t len = int128_get64(section.size);
+
+        cheri_tag_revoke_sweep(ram, offset, len, &req, threads);
+        scanned += req.scanned;
+        revoked += req.revoked;
+        addr += len;
+        memory_region_unref(section.mr);
+    }
+
+out:
+    if (bitmap.mr) {
+        memory_region_unref(bitmap.mr);
+    }
+    regs[REG(REVOKER_SCANNED)] = scanned;
+    regs[REG(REVOKER_REVOKED)] = revoked;
+}
+#endif
+
+static void revoker_reset(DeviceState *dev)
+{
+    RevokerDeviceState *s = REVOKER_DEVICE(dev);
+
+    memset(s->regs, 0, sizeof(s->regs));
+    s->regs[REG(REVOKER_ID)] = REVOKER_ID_VALUE;
+}
+
+static Property revoker_properties[] = {
+    DEFINE_PROP_UINT32("threads", RevokerDeviceState, threads, 0),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void revoker_realize(DeviceState *dev, Error **errp)
+{
+    RevokerDeviceState *s = REVOKER_DEVICE(dev);
+
+    memory_region_init_io(&s->iomem, OBJECT(dev), &revoker_ops, s,
+                          TYPE_REVOKER_DEVICE, REVOKER_REGION_SIZE);
+    sysbus_init_mmio(SYS_BUS_DEVICE(dev), &s->iomem);
+}
+
+static void revoker_class_init(ObjectClass *oc, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(oc);
+    RevokerClass *c = REVOKER_DEVICE_CLASS(oc);
+
+    dc->realize = revoker_realize;
+    dc->reset = revoker_reset;
+    device_class_set_props(dc, revoker_properties);
+
+#ifdef TARGET_CHERI
+    c->sweep = revoker_sweep;
+#else
+    c->sweep = NULL;
+#endif
+}
+
+static const TypeInfo revoker_device_info = {
+    .name = TYPE_REVOKER_DEVICE,
+    .parent = TYPE_SYS_BUS_DEVICE,
+    .instance_size = sizeof(RevokerDeviceState),
+    .class_size = sizeof(RevokerClass),
+    .class_init = revoker_class_init,
+};
+
+static void revoker_device_register_types(void)
+{
+    type_register_static(&revoker_device_info);
+}
+
+type_init(revoker_device_register_types)
@@ -37,6 +37,7 @@
 #include "hw/intc/riscv_imsic.h"
 #include "hw/intc/sifive_plic.h"
 #include "hw/misc/sifive_test.h"
+#include "hw/riscv/revoker.h"
 #include "chardev/char.h"
 #include "sysemu/device_tree.h"
 #include "sysemu/sysemu.h"
@@ -72,6 +73,7 @@ static const MemMapEntry virt_memmap[] = {
     [VIRT_MROM] =        {     0x1000,        0xf000 },
     [VIRT_TEST] =        {   0x100000,        0x1000 },
     [VIRT_RTC] =         {   0x101000,        0x1000 },
+    [VIRT_REVOKER] =     {   0x102000,        0x1000 },
     [VIRT_CLINT] =       {  0x2000000,       0x10000 },
     [VIRT_ACLINT_SSWI] = {  0x2F00000,        0x4000 },
     [VIRT_PCIE_PIO] =    {  0x3000000,       0x10000 },
@@ -931,6 +933,22 @@ static void create_fdt_rtc(RISCVVirtState *s, const MemMapEntry *memmap,
     g_free(name);
 }
 
+#ifdef TARGET_CHERI
+static void create_fdt_revoker(RISCVVirtState *s, const MemMapEntry *memmap)
+{
+    char *name;
+    MachineState *mc = MACHINE(s);
+
+    name = g_strdup_printf("/soc/revoker@%lx",
+                           (long)memmap[VIRT_REVOKER].base);
+    qemu_fdt_add_subnode(mc->fdt, name);
+    qemu_fdt_setprop_string(mc->fdt, name, "compatible", "qemu,cheri-revoker");
+    qemu_fdt_setprop_cells(mc->fdt, name, "reg",
+        0x0, memmap[VIRT_REVOKER].base, 0x0, memmap[VIRT_REVOKER].size);
+    g_free(name);
+}
+#endif
+
 static void create_fdt_flash(RISCVVirtState *s, const MemMapEntry *memmap)
 {
     char *name;
@@ -995,6 +1013,10 @@ static void create_fdt(RISCVVirtState *s, const MemMapEntry *memmap,
 
     create_fdt_rtc(s, memmap, irq_mmio_phandle);
 
+#ifdef TARGET_CHERI
+    create_fdt_revoker(s, memmap);
+#endif
+
     create_fdt_flash(s, memmap);
 
 update_bootargs:
@@ -1409,6 +1431,11 @@ static void virt_machine_init(MachineState *machine)
     sysbus_create_simple("goldfish_rtc", memmap[VIRT_RTC].base,
         qdev_get_gpio_in(DEVICE(mmio_irqchip), RTC_IRQ));
 
+#ifdef TARGET_CHERI
+    /* Revocation sweep accelerator, see hw/riscv/revoker.c */
+    sysbus_create_simple(TYPE_REVOKER_DEVICE, memmap[VIRT_REVOKER].base, NULL);
+#endif
+
     virt_flash_create(s);
 
     for (i = 0; i < ARRAY_SIZE(s->flash); i++) {
@@ -26,6 +26,9 @@
 #include "migration/postcopy-ram.h"
 #include "trace.h"
 #include "exec/ramblock.h"
+#ifdef TARGET_CHERI
+#include "cheri_tagmem.h"
+#endif
 
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -81,6 +84,8 @@ enum VhostUserProtocolFeature {
     VHOST_USER_PROTOCOL_F_RESET_DEVICE = 13,
     /* Feature 14 reserved for VHOST_USER_PROTOCOL_F_INBAND_NOTIFICATIONS. */
     VHOST_USER_PROTOCOL_F_CONFIGURE_MEM_SLOTS = 15,
+    /* Feature 16 reserved for VHOST_USER_PROTOCOL_F_STATUS. */
+    VHOST_USER_PROTOCOL_F_CHERI_TAGS = 17,
     VHOST_USER_PROTOCOL_F_MAX
 };
 
@@ -126,6 +131,8 @@ typedef enum VhostUserRequest {
     VHOST_USER_GET_MAX_MEM_SLOTS = 36,
     VHOST_USER_ADD_MEM_REG = 37,
     VHOST_USER_REM_MEM_REG = 38,
+    /* Message numbers 39 and 40 reserved for VHOST_USER_[GS]ET_STATUS. */
+    VHOST_USER_SET_CHERI_TAGS = 41,
     VHOST_USER_MAX
 } VhostUserRequest;
 
@@ -155,6 +162,14 @@ typedef struct VhostUserMemRegMsg {
     VhostUserMemoryRegion region;
 } VhostUserMemRegMsg;
 
+typedef struct VhostUserCheriTags {
+    uint64_t guest_phys_addr;
+    uint64_t memory_size;
+    uint64_t mmap_size;
+    uint64_t tag_offset;
+    uint64_t granule_size;
+} VhostUserCheriTags;
+
 typedef struct VhostUserLog {
     uint64_t mmap_size;
     uint64_t mmap_offset;
@@ -220,6 +235,7 @@ typedef union {
         VhostUserCryptoSession session;
         VhostUserVringArea area;
         VhostUserInflight inflight;
+        VhostUserCheriTags cheri_tags;
 } VhostUserPayload;
 
 typedef struct VhostUserMsg {
@@ -1067,6 +1083,114 @@ static int vhost_user_set_mem_table_postcopy(struct vhost_dev *dev,
     return 0;
 }
 
+#ifdef TARGET_CHERI
+/*
+ * Backends write guest memory directly, bypassing the tag invalidation done
+ * for stores and DMA in QEMU. Share the tags of every region so that the
+ * backend can clear them itself, and refuse backends that can't.
+ */
+static int vhost_user_set_cheri_tags(struct vhost_dev *dev)
+{
+    bool reply_supported = virtio_has_feature(dev->protocol_features,
+                                              VHOST_USER_PROTOCOL_F_REPLY_ACK);
+    bool cheri_tags = virtio_has_feature(dev->protocol_features,
+                                         VHOST_USER_PROTOCOL_F_CHERI_TAGS);
+    struct vhost_memory_region *reg;
+    ram_addr_t offset;
+    MemoryRegion *mr;
+    uint64_t size;
+    int i, fd, tags_fd, ret;
+
+    for (i = 0; i < dev->mem->nregions; ++i) {
+        reg = dev->mem->regions + i;
+        mr = vhost_user_get_mr_data(reg->userspace_addr, &offset, &fd);
+        if (fd <= 0 || !mr->ram_block->cheri_tags) {
+            continue;
+        }
+        if (!cheri_tags) {
+            error_report("vhost-user backend does not support CHERI tags, "
+                         "it can not write to %s", mr->name);
+            return -EINVAL;
+        }
+        tags_fd = cheri_tag_get_fd(mr->ram_block, &size);
+        if (tags_fd < 0) {
+            error_report("CHERI tags of %s can not be shared with a vhost-user "
+                         "backend, consider using share=on", mr->name);
+            return -EINVAL;
+        }
+
+        VhostUserMsg msg = {
+            .hdr.request = VHOST_USER_SET_CHERI_TAGS,
+            .hdr.flags = VHOST_USER_VERSION,
+            .hdr.size = sizeof(msg.payload.cheri_tags),
+            .payload.cheri_tags = {
+                .guest_phys_addr = reg->guest_phys_addr,
+                .memory_size = reg->memory_size,
+                .mmap_size = size,
+                .tag_offset = offset / CHERI_CAP_SIZE,
+                .granule_size = CHERI_CAP_SIZE,
+            },
+        };
+        if (reply_supported) {
+            msg.hdr.flags |= VHOST_USER_NEED_REPLY_MASK;
+        }
+        ret = vhost_user_write(dev, &msg, &tags_fd, 1);
+        if (ret < 0) {
+            return ret;
+        }
+        if (reply_supported) {
+            ret = process_message_reply(dev, &msg);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+static int vhost_user_find_unshared_tags(RAMBlock *rb, void *opaque)
+{
+    struct vhost_dev *dev = opaque;
+    uint64_t size;
+
+    if (rb->fd < 0 || !rb->cheri_tags) {
+        return 0;
+    }
+    return !virtio_has_feature(dev->protocol_features,
+                               VHOST_USER_PROTOCOL_F_CHERI_TAGS) ||
+           cheri_tag_get_fd(rb, &size) < 0;
+}
+
+/*
+ * Fail the device at negotiation if it could be handed memory with tags that
+ * it can not clear, rather than when the memory table is first sent.
+ */
+static int vhost_user_check_cheri_tags(struct vhost_dev *dev, Error **errp)
+{
+    if (qemu_ram_foreach_block(vhost_user_find_unshared_tags, dev)) {
+        if (!virtio_has_feature(dev->protocol_features,
+                                VHOST_USER_PROTOCOL_F_CHERI_TAGS)) {
+            error_setg(errp, "vhost-user backend does not support CHERI tags");
+        } else {
+            error_setg(errp, "CHERI tags can not be shared with a vhost-user "
+                       "backend, consider using share=on");
+        }
+        return -ENOTSUP;
+    }
+    return 0;
+}
+#else
+static int vhost_user_set_cheri_tags(struct vhost_dev *dev)
+{
+    return 0;
+}
+
+static int vhost_user_check_cheri_tags(struct vhost_dev *dev, Error **errp)
+{
+    return 0;
+}
+#endif
+
 static int vhost_user_set_mem_table(struct vhost_dev *dev,
                                     struct vhost_memory *mem)
 {
@@ -1086,8 +1210,12 @@ static int vhost_user_set_mem_table(struct vhost_dev *dev,
          * Postcopy has enough differences that it's best done in it's own
          * version
          */
-        return vhost_user_set_mem_table_postcopy(dev, mem, reply_supported,
-                                                 config_mem_slots);
+        ret = vhost_user_set_mem_table_postcopy(dev, mem, reply_supported,
+                                                config_mem_slots);
+        if (ret < 0) {
+            return ret;
+        }
+        return vhost_user_set_cheri_tags(dev);
     }
 
     VhostUserMsg msg = {
@@ -1116,11 +1244,14 @@ static int vhost_user_set_mem_table(struct vhost_dev *dev,
         }
 
         if (reply_supported) {
-            return process_message_reply(dev, &msg);
+            ret = process_message_reply(dev, &msg);
+            if (ret < 0) {
+                return ret;
+            }
         }
     }
 
-    return 0;
+    return vhost_user_set_cheri_tags(dev);
 }
 
 static int vhost_user_set_vring_endian(struct vhost_dev *dev,
@@ -1974,6 +2105,9 @@ static int vhost_user_backend_init(struct vhost_dev *dev, void *opaque,
 
         dev->protocol_features =
             protocol_features & VHOST_USER_PROTOCOL_FEATURE_MASK;
+#ifndef TARGET_CHERI
+        dev->protocol_features &= ~(1ULL << VHOST_USER_PROTOCOL_F_CHERI_TAGS);
+#endif
 
         if (!dev->config_ops || !dev->config_ops->vhost_dev_config_notifier) {
             /* Don't acknowledge CONFIG feature if device doesn't support it */
@@ -2042,6 +2176,11 @@ static int vhost_user_backend_init(struct vhost_dev *dev, void *opaque,
         }
     }
 
+    err = vhost_user_check_cheri_tags(dev, errp);
+    if (err < 0) {
+        return err;
+    }
+
     if (dev->migration_blocker == NULL &&
         !virtio_has_feature(dev->protocol_features,
                             VHOST_USER_PROTOCOL_F_LOG_SHMFD)) {
@@ -389,7 +389,8 @@ CPUArchState *cpu_copy(CPUArchState *env);
  */
 /* Zero if TLB entry is valid.  */
 #define TLB_INVALID_MASK    (1 << (TARGET_PAGE_BITS_MIN - 1))
-/* Set if TLB entry references a clean RAM page.  The iotlb entry will
+/* Set if TLB entry references a clean RAM page (or, with CHERI, a RAM page
+   with tags, see tlb_cheri_tags_locked()).  The iotlb entry will
    contain the page physical address.  */
 #define TLB_NOTDIRTY        (1 << (TARGET_PAGE_BITS_MIN - 2))
 /* Set if TLB entry is an IO callback.  */
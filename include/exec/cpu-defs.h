@@ -79,6 +79,9 @@ typedef uint64_t target_ulong;
 /* use a fully associative victim tlb of 8 entries */
 #define CPU_VTLB_SIZE 8
 
+/* and remember up to 8 large pages, see tlb_add_large_page() */
+#define CPU_LTLB_SIZE 8
+
 #if HOST_LONG_BITS == 32 && TARGET_LONG_BITS == 32
 #define CPU_TLB_ENTRY_BITS 4
 #else
@@ -186,6 +189,26 @@ typedef struct CPUIOTLBEntry {
     })
 #define IOTLB_GET_TAGMEM_FLAGS(iotlbentry, rw)                                 \
     ((uintptr_t)iotlbentry->tagmem_##rw & TLBENTRYCAP_MASK);
+/*
+ * A page larger than TARGET_PAGE_SIZE that has been mapped into the tlb.
+ * Its target pages are entered into the tlb one at a time.
+ */
+typedef struct CPUTLBLargeEntry {
+    /* Page aligned virtual address, -1 if the entry is unused. */
+    target_ulong vaddr;
+    target_ulong size;
+    /*
+     * The leaf within the page that was last filled, which is mapped
+     * linearly to paddr with attrs and prot (see tlb_set_page_leaf()),
+     * -1 if the target did not report one.
+     */
+    target_ulong leaf_vaddr;
+    target_ulong leaf_size;
+    hwaddr paddr;
+    MemTxAttrs attrs;
+    int prot;
+} CPUTLBLargeEntry;
+
 /*
  * Data elements that are per MMU mode, minus the bits accessed by
  * the TCG fast path.
@@ -193,12 +216,21 @@ typedef struct CPUIOTLBEntry {
 typedef struct CPUTLBDesc {
     /*
      * Describe a region covering all of the large pages allocated
-     * into the tlb.  When any page within this region is flushed,
-     * we must flush the entire tlb.  The region is matched if
-     * (addr & large_page_mask) == large_page_addr.
+     * into the tlb that are no longer in ltlb.  When any page within
+     * this region is flushed, we must flush the entire tlb.  The region
+     * is matched if (addr & large_page_mask) == large_page_addr.
      */
     target_ulong large_page_addr;
     target_ulong large_page_mask;
+    /*
+     * The large pages allocated into the tlb most recently.  Flushing
+     * one of their pages flushes just the large page, and the other
+     * pages of their leaf are refilled from here without a page table
+     * walk.
+     */
+    CPUTLBLargeEntry ltlb[CPU_LTLB_SIZE];
+    /* The next index to use in ltlb.  */
+    size_t lindex;
     /* host time (in ns) at the beginning of the time window */
     int64_t window_begin_ns;
     /* maximum number of entries observed in the window */
@@ -244,6 +276,8 @@ typedef struct CPUTLBCommon {
     size_t full_flush_count;
     size_t part_flush_count;
     size_t elide_flush_count;
+    size_t large_refill_count;
+    size_t large_flush_count;
 } CPUTLBCommon;
 
 /*
@@ -283,6 +283,21 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *cpu,
 void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
                              hwaddr paddr, MemTxAttrs attrs,
                              int prot, int mmu_idx, target_ulong size);
+/**
+ * tlb_set_page_leaf:
+ * @leaf_size: size of the translation leaf containing @vaddr
+ *
+ * This function is equivalent to calling tlb_set_page_with_attrs(),
+ * except that the target also reports that the @leaf_size aligned region
+ * around @vaddr is mapped linearly to the one around @paddr, with the
+ * same @attrs and @prot for every access that @prot permits.  Other pages
+ * of the leaf may then be added without calling tlb_fill().  @size is
+ * still what tlb_flush_page flushes and may be larger than @leaf_size,
+ * e.g. for a two-stage translation.
+ */
+void tlb_set_page_leaf(CPUState *cpu, target_ulong vaddr,
+                       hwaddr paddr, MemTxAttrs attrs, int prot,
+                       int mmu_idx, target_ulong size, target_ulong leaf_size);
 /* tlb_set_page:
  *
  * This function is equivalent to calling tlb_set_page_with_attrs()
@@ -463,6 +478,14 @@ struct TranslationBlock {
     target_ulong cs_base; /* CS base for this block */
     target_ulong pcc_base; /* CHERI: Base of program counter for this block */
     target_ulong pcc_top; /* CHERI: End of program counter for this block */
+    /*
+     * CHERI: Range of addresses the code assumes to be within PCC bounds.
+     * Unless pcc_bounds_exact is set, the TB is valid for any PCC whose
+     * bounds cover this range and is not keyed on pcc_base/pcc_top.
+     */
+    target_ulong pcc_used_base;
+    target_ulong pcc_used_top;
+    bool pcc_bounds_exact;
     uint32_t cheri_flags; /* Extra flags for CHERI. We need more bits than are
                              available in flags (at least for MIPS) and this
                              will allow us to avoid continuously changing the
@@ -482,6 +505,7 @@ struct TranslationBlock {
 #define CF_PARALLEL      0x00080000 /* Generate code for a parallel context */
 #define CF_NOIRQ         0x00100000 /* Generate an uninterruptible TB */
 #define CF_LOG_INSTR     0x00200000 /* Generate calls to instruction tracing */
+#define CF_LOG_INSTR_FILTERED 0x00400000 /* TB excluded by the trace filter */
 #define CF_CLUSTER_MASK  0xff000000 /* Top 8 bits are cluster ID */
 #define CF_CLUSTER_SHIFT 24
 
@@ -562,6 +586,32 @@ static inline uint32_t tb_cflags(const TranslationBlock *tb)
     return qatomic_read(&tb->cflags);
 }
 
+/* Check whether the TB can run with the given PCC bounds */
+static inline bool tb_pcc_bounds_match(const TranslationBlock *tb,
+                                       target_ulong pcc_base,
+                                       target_ulong pcc_top)
+{
+    if (tb->pcc_bounds_exact) {
+        return tb->pcc_base == pcc_base && tb->pcc_top == pcc_top;
+    }
+    return pcc_base <= tb->pcc_used_base && pcc_top >= tb->pcc_used_top;
+}
+
+/*
+ * Check whether @next can run with every PCC that @tb can run with, i.e.
+ * whether @tb may jump to @next directly without looking it up again.
+ */
+static inline bool tb_pcc_bounds_cover(const TranslationBlock *tb,
+                                       const TranslationBlock *next)
+{
+    if (tb->pcc_bounds_exact) {
+        return tb_pcc_bounds_match(next, tb->pcc_base, tb->pcc_top);
+    }
+    return !next->pcc_bounds_exact &&
+           next->pcc_used_base >= tb->pcc_used_base &&
+           next->pcc_used_top <= tb->pcc_used_top;
+}
+
 /* current cflags for hashing/comparison */
 uint32_t curr_cflags(CPUState *cpu);
 
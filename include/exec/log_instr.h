@@ -199,6 +199,23 @@ void qemu_log_instr_flush_tcg(bool request_stop);
  */
 bool qemu_log_instr_check_enabled(CPUArchState *env);
 
+/*
+ * Translation-time trace filter, see -cheri-trace-filter.
+ * The filter is evaluated once per TB lookup and the result is stored in
+ * the TB cflags, so TBs outside the filter carry no per-instruction logging.
+ */
+extern bool qemu_log_instr_tb_filter_enabled;
+/*
+ * Set if the filter depends on CPU state that a TB does not capture (ASID,
+ * mode). A TB outside the filter may then be reused under state inside it.
+ */
+extern bool qemu_log_instr_tb_filter_stateful;
+
+/*
+ * Check whether the TB starting at pc should be logged.
+ */
+bool qemu_log_instr_tb_filter_match(CPUArchState *env, target_ulong pc);
+
 /*
  * Start instruction tracing. Note that the instruction currently being
  * executed will be replaced by a trace start event.
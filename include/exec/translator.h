@@ -74,6 +74,12 @@ typedef struct DisasContextBase {
 #ifdef TARGET_CHERI
     target_ulong pcc_base;
     target_ulong pcc_top;
+    // Range of addresses the generated code assumes to be within PCC bounds
+    // (empty if pcc_used_base > pcc_used_top). Unless pcc_bounds_exact is set
+    // the TB can be reused for any PCC whose bounds cover this range.
+    target_ulong pcc_used_base;
+    target_ulong pcc_used_top;
+    bool pcc_bounds_exact;
     uint32_t cheri_flags;
     // Keeps track of all compression states a cap could be at TRANSLATATION
     // TIME. Within a basic block, this is possible to track for any runtime
@@ -109,7 +115,7 @@ typedef struct DisasContextBase {
  * @related CHERI_TRANSLATE_PCC_RELOCATION(ctx)
  */
 #define pcc_reloc(ctx)                                                         \
-    (CHERI_TRANSLATE_PCC_RELOCATION(ctx) ? (ctx)->base.pcc_base : 0)
+    (CHERI_TRANSLATE_PCC_RELOCATION(ctx) ? disas_pcc_base(&(ctx)->base) : 0)
 #else
 #define pcc_reloc(ctx) 0
 #endif
@@ -182,6 +188,81 @@ void translator_loop_temp_check(DisasContextBase *db);
  */
 bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest);
 
+/**
+ * translator_lookup_and_goto_ptr
+ * @db: Disassembly context
+ * @pc: target pc of the jump, a global
+ *
+ * Like tcg_gen_lookup_and_goto_ptr(), with an inline cache of the last
+ * TB_IC_WAYS targets that avoids the TB lookup when @pc hits. Only use it
+ * for jumps that change nothing but the pc: the cache is valid as long as
+ * the CPU state at the jump matches the key of the current TB.
+ */
+void translator_lookup_and_goto_ptr(DisasContextBase *db, TCGv pc);
+
+/**
+ * translator_lookup_and_goto_ptr_guarded
+ * @db: Disassembly context
+ * @pc: target pc of the jump, a global
+ * @guard_ofs: offset from cpu_env of a target_ulong guard
+ *
+ * Like translator_lookup_and_goto_ptr(), for jumps that also install a new
+ * PCC. A cached target only hits if the guard still has the value it had
+ * when the target was cached. The guard and the pc must together determine
+ * PCC (e.g. PCC's pesbt for a tagged PCC), anything else must be unchanged.
+ */
+void translator_lookup_and_goto_ptr_guarded(DisasContextBase *db, TCGv pc,
+                                            intptr_t guard_ofs);
+
+/**
+ * translator_push_return
+ * @db: Disassembly context
+ * @ret_pc: return address of the call
+ *
+ * Push @ret_pc to the return address stack at a call, so that the matching
+ * translator_return_and_goto_ptr() can predict the return.
+ */
+void translator_push_return(DisasContextBase *db, target_ulong ret_pc);
+
+/**
+ * translator_return_and_goto_ptr
+ * @db: Disassembly context
+ * @pc: target pc of the return, a global
+ * @guard_ofs: offset from cpu_env of a target_ulong guard, or -1
+ *
+ * Like translator_lookup_and_goto_ptr() (or the _guarded variant if
+ * @guard_ofs is not -1), but for returns: pop the return address stack and
+ * jump straight to the TB cached there if it starts at @pc.
+ */
+void translator_return_and_goto_ptr(DisasContextBase *db, TCGv pc,
+                                    intptr_t guard_ofs);
+
+/* At most this many direct successors are recorded per TB */
+#define TRANSLATOR_MAX_SUCCESSORS 4
+
+/**
+ * translator_get_successors
+ * @pcs: Array of TRANSLATOR_MAX_SUCCESSORS entries to fill in
+ *
+ * Return the number of goto_tb targets of the TB last translated by this
+ * thread, i.e. the destinations translator_use_goto_tb() allowed. They are
+ * all on the same guest page as the start of that TB.
+ */
+int translator_get_successors(target_ulong *pcs);
+
+/**
+ * translator_set_code_page
+ * @vaddr: Guest virtual address of the code page
+ * @host: Host address of the page, or NULL
+ *
+ * Make the translator loads on this thread read from @host instead of going
+ * through the vCPU's softmmu TLB, which only the vCPU thread may use. Loads
+ * outside of the page read as zero and are reported by
+ * translator_code_page_fault(). Pass NULL to go back to the TLB.
+ */
+void translator_set_code_page(target_ulong vaddr, const void *host);
+bool translator_code_page_fault(void);
+
 /*
  * Translator Load Functions
  *
@@ -193,7 +274,7 @@ bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest);
  * the relevant information at translation time.
  */
 
-#define GEN_TRANSLATOR_LD(fullname, type, load_fn, swap_fn)             \
+#define GEN_TRANSLATOR_LD(fullname, type, load_fn, host_fn, swap_fn)    \
     type fullname ## _swap(CPUArchState *env, DisasContextBase *dcbase, \
                            abi_ptr pc, bool do_swap);                   \
     static inline type fullname(CPUArchState *env,                      \
@@ -203,11 +284,11 @@ bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest);
     }
 
 #define FOR_EACH_TRANSLATOR_LD(F)                                       \
-    F(translator_ldub, uint8_t, cpu_ldub_code, /* no swap */)           \
-    F(translator_ldsw, int16_t, cpu_ldsw_code, bswap16)                 \
-    F(translator_lduw, uint16_t, cpu_lduw_code, bswap16)                \
-    F(translator_ldl, uint32_t, cpu_ldl_code, bswap32)                  \
-    F(translator_ldq, uint64_t, cpu_ldq_code, bswap64)
+    F(translator_ldub, uint8_t, cpu_ldub_code, ldub_p, /* no swap */)   \
+    F(translator_ldsw, int16_t, cpu_ldsw_code, ldsw_p, bswap16)         \
+    F(translator_lduw, uint16_t, cpu_lduw_code, lduw_p, bswap16)        \
+    F(translator_ldl, uint32_t, cpu_ldl_code, ldl_p, bswap32)           \
+    F(translator_ldq, uint64_t, cpu_ldq_code, ldq_p, bswap64)
 
 FOR_EACH_TRANSLATOR_LD(GEN_TRANSLATOR_LD)
 
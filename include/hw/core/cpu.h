@@ -236,6 +236,34 @@ struct hvf_vcpu_state;
 #define TB_JMP_CACHE_BITS 12
 #define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
 
+#define TB_IC_BITS 8
+#define TB_IC_SIZE (1 << TB_IC_BITS)
+#define TB_IC_WAYS 2
+
+/*
+ * Inline cache entry for the indirect jump of the TB @site, most recently
+ * used target first. The ways are valid whenever @site is set. For guarded
+ * jumps, @guard holds the value of the guard when the way was filled.
+ */
+typedef struct TBICEntry {
+    const TranslationBlock *site;
+    TranslationBlock *tb[TB_IC_WAYS];
+    uint64_t guard[TB_IC_WAYS];
+} TBICEntry;
+
+#define TB_RAS_SIZE 16
+
+/*
+ * Return address stack entry pushed by a call to return to @pc. @tb is the
+ * TB a return from @site jumped to, valid whenever @site is set.
+ */
+typedef struct TBRASEntry {
+    uint64_t pc;
+    const TranslationBlock *site;
+    TranslationBlock *tb;
+    uint64_t guard;
+} TBRASEntry;
+
 /* work queue */
 
 /* The union type allows passing of 64 bit target pointers on 32 bit
@@ -369,6 +397,20 @@ struct CPUState {
     /* Accessed in parallel; all accesses must be atomic */
     TranslationBlock *tb_jmp_cache[TB_JMP_CACHE_SIZE];
 
+    /*
+     * Indirect jump inline caches, see translator_lookup_and_goto_ptr().
+     * Only this vCPU fills them, other threads may clear an entry's site.
+     */
+    TBICEntry tb_ic[TB_IC_SIZE];
+    size_t tb_ic_hits;
+    size_t tb_ic_misses;
+    size_t tb_ic_fills;
+    /* Return address stack, see translator_push_return(). */
+    TBRASEntry tb_ras[TB_RAS_SIZE];
+    uint32_t tb_ras_top;
+    size_t tb_ras_hits;
+    size_t tb_ras_misses;
+
     struct GDBRegisterState *gdb_regs;
     int gdb_num_regs;
     int gdb_num_g_regs;
@@ -458,6 +500,12 @@ static inline void cpu_tb_jmp_cache_clear(CPUState *cpu)
     for (i = 0; i < TB_JMP_CACHE_SIZE; i++) {
         qatomic_set(&cpu->tb_jmp_cache[i], NULL);
     }
+    for (i = 0; i < TB_IC_SIZE; i++) {
+        qatomic_set(&cpu->tb_ic[i].site, NULL);
+    }
+    for (i = 0; i < TB_RAS_SIZE; i++) {
+        qatomic_set(&cpu->tb_ras[i].site, NULL);
+    }
 }
 
 /**
@@ -0,0 +1,73 @@
+/*
+ * QEMU CHERI revocation sweep device
+ *
+ * Emulator-side accelerator for temporal safety research: sweeps a range of
+ * guest physical memory and clears the tags of all capabilities whose base is
+ * marked in a guest-provided revocation bitmap, as a software revoker would
+ * with one capability load per granule.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2 or later, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_REVOKER_H
+#define HW_REVOKER_H
+
+#include "qom/object.h"
+#include "hw/sysbus.h"
+
+#define TYPE_REVOKER_DEVICE "cheri-revoker"
+#define REVOKER_REGION_SIZE 0x1000
+
+/* "CREVOKE" in the upper bytes, register map version in the low byte */
+#define REVOKER_ID_VALUE 0x454b4f5645524301ULL
+
+/* Register offsets, all registers are 64 bits wide */
+#define REVOKER_ID          0x00 /* RO: REVOKER_ID_VALUE */
+#define REVOKER_SWEEP_START 0x08 /* Physical start of the sweep */
+#define REVOKER_SWEEP_END   0x10 /* Physical end of the sweep (exclusive) */
+#define REVOKER_BITMAP_ADDR 0x18 /* Physical address of the bitmap */
+#define REVOKER_BITMAP_BASE 0x20 /* Capability base covered by bit 0 */
+#define REVOKER_BITMAP_SIZE 0x28 /* Size of the bitmap in bytes */
+#define REVOKER_CTRL        0x30 /* Write REVOKER_CTRL_START to sweep */
+#define REVOKER_STATUS      0x38 /* RO: REVOKER_STATUS_* of the last sweep */
+#define REVOKER_SCANNED     0x40 /* RO: tagged capabilities visited */
+#define REVOKER_REVOKED     0x48 /* RO: tags cleared */
+#define REVOKER_REGS_SIZE   0x50
+
+#define REVOKER_CTRL_START 0x1
+
+#define REVOKER_STATUS_OK         0x0
+#define REVOKER_STATUS_BAD_BITMAP 0x1 /* Bitmap not contiguous guest RAM */
+#define REVOKER_STATUS_BAD_RANGE  0x2 /* Sweep range not (entirely) RAM */
+
+OBJECT_DECLARE_TYPE(RevokerDeviceState, RevokerClass, REVOKER_DEVICE)
+
+typedef struct RevokerDeviceState RevokerDeviceState;
+struct RevokerDeviceState {
+    SysBusDevice parent_obj;
+    MemoryRegion iomem;
+    uint32_t threads; /* Host threads used for a sweep, 0 for all host CPUs */
+    uint64_t regs[REVOKER_REGS_SIZE / sizeof(uint64_t)];
+};
+
+struct RevokerClass {
+    SysBusDeviceClass parent_class;
+
+    /*
+     * Sweep the RAM in [start, end) against the bitmap programmed into the
+     * registers and update the status and statistics registers.
+     */
+    void (*sweep)(RevokerDeviceState *s);
+};
+
+#endif
@@ -61,6 +61,7 @@ enum {
     VIRT_MROM,
     VIRT_TEST,
     VIRT_RTC,
+    VIRT_REVOKER,
     VIRT_CLINT,
     VIRT_ACLINT_SSWI,
     VIRT_PLIC,
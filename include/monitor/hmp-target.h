@@ -51,5 +51,10 @@ void hmp_info_local_apic(Monitor *mon, const QDict *qdict);
 void hmp_info_sev(Monitor *mon, const QDict *qdict);
 void hmp_info_sgx(Monitor *mon, const QDict *qdict);
 void hmp_info_via(Monitor *mon, const QDict *qdict);
+void hmp_info_cheri_tags(Monitor *mon, const QDict *qdict);
+void hmp_info_cheri_stats(Monitor *mon, const QDict *qdict);
+void hmp_info_cheri_provenance(Monitor *mon, const QDict *qdict);
+void hmp_cheri_provenance(Monitor *mon, const QDict *qdict);
+void hmp_cheri_provenance_dump(Monitor *mon, const QDict *qdict);
 
 #endif /* MONITOR_HMP_TARGET_H */
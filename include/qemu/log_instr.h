@@ -53,7 +53,9 @@
 typedef enum {
     QLI_FMT_TEXT = 0,
     QLI_FMT_CVTRACE = 1,
-    QLI_FMT_NOP = 2
+    QLI_FMT_NOP = 2,
+    QLI_FMT_BINARY = 3,
+    QLI_FMT_BINARY_ZSTD = 4
 } qemu_log_instr_fmt_t;
 
 extern qemu_log_instr_fmt_t qemu_log_instr_format;
@@ -134,6 +136,8 @@ typedef struct {
     bool force_drop;
     /* We are starting to log at the next commit */
     bool starting;
+    /* Running TBs excluded by the trace filter, drop the next commit */
+    bool tb_filtered;
     /* Per-CPU flags */
     int flags;
 #define QEMU_LOG_INSTR_FLAG_BUFFERED 1
@@ -144,6 +148,8 @@ typedef struct {
     size_t ring_head;
     /* Ring buffer index of the first entry to dump */
     size_t ring_tail;
+    /* Output ring buffer for the binary trace format */
+    struct qemu_log_binary_ring *binary_ring;
 
     qemu_log_printf_buf_t qemu_log_printf_buf;
 } cpu_log_instr_state_t;
@@ -161,6 +167,14 @@ int qemu_log_instr_global_switch(int log_flags);
  */
 void qemu_log_instr_set_buffer_size(unsigned long buffer_size);
 
+/*
+ * Set the translation-time trace filter from a comma-separated list of
+ * pc=<start>-<end>, pc=<start>+<size>, asid=<n>, mode=user|kernel and
+ * sample=<n> clauses.
+ * This must be done before the CPUs start executing.
+ */
+void qemu_log_instr_set_tb_filter(const char *spec, Error **errp);
+
 #else /* ! CONFIG_TCG_LOG_INSTR */
 #define qemu_log_instr_set_format(fmt) ((void)0)
 #endif /* ! CONFIG_TCG_LOG_INSTR */
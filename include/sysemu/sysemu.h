@@ -48,6 +48,8 @@ extern bool boot_strict;
 extern uint8_t *boot_splash_filedata;
 extern bool enable_mlock;
 extern bool enable_cpu_pm;
+/* -cheri-provenance, defined in target/cheri-common/cheri_tagmem.c */
+extern bool cheri_provenance_enabled;
 extern QEMUClockType rtc_clock;
 
 #define MAX_OPTION_ROMS 16
@@ -11,6 +11,12 @@
 #ifdef CONFIG_TCG
 extern bool tcg_allowed;
 #define tcg_enabled() (tcg_allowed)
+
+/*
+ * Start sampling the guest pc of every vCPU freq times per second,
+ * writing the samples to path in the `perf script` format.
+ */
+void tcg_guest_profile_start(const char *path, uint64_t freq, Error **errp);
 #else
 #define tcg_enabled() 0
 #endif
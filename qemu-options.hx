@@ -151,6 +151,8 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                kvm-shadow-mem=size of KVM shadow MMU in bytes\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                tb-profile=file (load/save TCG translation keys in file)\n"
+    "                spec-threads=n (translate successor blocks in n background threads)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                thread=single|multi (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
 SRST
@@ -185,6 +187,24 @@ SRST
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``tb-profile=file``
+        Records the key (guest address, CPU state flags and a hash of the
+        guest code) of every TCG translation block. Keys are loaded from
+        *file* at startup and written back at exit. With ``spec-threads``,
+        the blocks recorded for a guest page whose code is unchanged are
+        translated in the background as soon as the page is first executed.
+        ``info jit`` reports how many translations of this run match a
+        translation from an earlier run. Only supported in system emulation.
+
+    ``spec-threads=n``
+        Starts *n* threads that translate the direct successors of every
+        newly translated TCG block in the background, so that the vCPU
+        finds them already translated. Only successors on the same guest
+        page are translated, and not while breakpoints, plugins,
+        semihosting or instruction tracing are in use. ``info jit`` shows
+        statistics. The default is 0. Only supported in system emulation
+        of RISC-V.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
@@ -4452,10 +4472,75 @@ SRST
 ERST
 
 DEF("cheri-trace-format", HAS_ARG, QEMU_OPTION_cheri_trace_format, \
-"-cheri-trace-format [text|cvtrace]     Select CHERI trace mode.\n", QEMU_ARCH_ALL)
+"-cheri-trace-format [text|cvtrace|binary|binary-zstd]     Select CHERI trace mode.\n", QEMU_ARCH_ALL)
 SRST
 ``-cheri-trace-format type``
-    Set CHERI trace format to <type> (text or cvtrace)
+    Set CHERI trace format to <type> (text, cvtrace, binary or binary-zstd).
+    The binary formats are produced into per-CPU ring buffers and written
+    out by a separate thread, binary-zstd additionally compresses the output
+    (if QEMU was built with zstd support).
+ERST
+
+DEF("guest-profile", HAS_ARG, QEMU_OPTION_guest_profile, \
+    "-guest-profile [file=]path[,freq=hz]\n"
+    "                sample the guest pc of each vCPU and write a perf script profile\n",
+    QEMU_ARCH_ALL)
+SRST
+``-guest-profile [file=]path[,freq=hz]``
+    Periodically sample the guest program counter, address space and
+    privilege mode of every vCPU and write the samples to path in the
+    ``perf script`` text format. Samples are taken between translation
+    blocks, so the overhead only depends on the frequency (1000 Hz by
+    default). Addresses are symbolized using the ELF images loaded with
+    ``-kernel`` or ``-bios``. Only available with TCG.
+ERST
+
+DEF("cheri-trace-filter", HAS_ARG, QEMU_OPTION_cheri_trace_filter, \
+"-cheri-trace-filter pc=start-end|pc=start+size|asid=n|mode=user|kernel|sample=n[,...]\n"
+"                Only log instructions in matching translation blocks.\n", QEMU_ARCH_ALL)
+SRST
+``-cheri-trace-filter clause[,clause...]``
+    Restrict CHERI instruction tracing to the translation blocks matching
+    all the given clauses. Unlike ``-dfilter``, the filter is applied when
+    code is translated, so blocks outside the filter run without any
+    per-instruction logging overhead.
+
+    ``pc=start-end``, ``pc=start+size``
+        Log blocks starting in the given address range. Can be repeated.
+
+    ``asid=n``
+        Log blocks executed in the given address space. Can be repeated.
+
+    ``mode=user|kernel``
+        Log blocks executed in user or privileged mode.
+
+    ``sample=n``
+        Log one in n basic blocks, selected by a hash of the block address.
+ERST
+
+DEF("cheri-stats-log", HAS_ARG, QEMU_OPTION_cheri_stats_log, \
+    "-cheri-stats-log [file=]path[,interval=ms]\n"
+    "                periodically write the CHERI statistics counters to a file\n",
+    QEMU_ARCH_ALL)
+SRST
+``-cheri-stats-log [file=]path[,interval=ms]``
+    Append the result of ``query-cheri-stats`` to path every interval
+    milliseconds (1000 by default), one JSON object per line with a
+    ``timestamp-ms`` member. The VM is not stopped to collect the counters.
+    Only used on CHERI targets.
+ERST
+
+DEF("cheri-provenance", 0, QEMU_OPTION_cheri_provenance, \
+    "-cheri-provenance     record the PC of every tagged capability store\n",
+    QEMU_ARCH_ALL)
+SRST
+``-cheri-provenance``
+    Record the guest PC and ASID of the instruction that stored each tagged
+    capability to RAM, so that ``info cheri_provenance``,
+    ``query-cheri-provenance`` and ``cheri-provenance-dump`` can report where
+    a capability came from. This slows down capability stores and uses up to
+    as much host memory as the guest RAM that holds capabilities. Only used on
+    CHERI targets.
 ERST
 
 DEF("cheri-c2e-on-unrepresentable", 0, QEMU_OPTION_cheri_c2e_on_unrepresentable, \
@@ -4492,6 +4577,16 @@ SRST
 ``-rvfi-dii-debug``
     Print RVFI-DII debug messages.
 ERST
+DEF("rvfi-dii-shm", HAS_ARG, QEMU_OPTION_rvfi_dii_shm, \
+    "-rvfi-dii-shm <file>     Offer a shared-memory RVFI-DII transport in <file>\n", QEMU_ARCH_RISCV)
+SRST
+``-rvfi-dii-shm file``
+    Allow RVFI-DII clients to switch from the socket to shared-memory ring
+    buffers in <file> (e.g. a file in /dev/shm) using the ``s`` command. This
+    avoids a socket round trip per instruction and lets clients queue whole
+    instruction sequences. Without this option the ``s`` command is declined
+    and the socket is used.
+ERST
 #endif
 
 
@@ -4806,7 +4901,7 @@ SRST
     they are specified. Note that the 'id' property must be set. These
     objects are placed in the '/objects' path.
 
-    ``-object memory-backend-file,id=id,size=size,mem-path=dir,share=on|off,discard-data=on|off,merge=on|off,dump=on|off,prealloc=on|off,host-nodes=host-nodes,policy=default|preferred|bind|interleave,align=align,readonly=on|off``
+    ``-object memory-backend-file,id=id,size=size,mem-path=dir,share=on|off,discard-data=on|off,merge=on|off,dump=on|off,prealloc=on|off,host-nodes=host-nodes,policy=default|preferred|bind|interleave,align=align,readonly=on|off,cheri-tags=on|off,cheri-tags-path=path``
         Creates a memory file backend object, which can be used to back
         the guest RAM with huge pages.
 
@@ -4892,6 +4987,22 @@ SRST
         The ``readonly`` option specifies whether the backing file is opened
         read-only or read-write (default).
 
+        On CHERI targets, ``cheri-tags=on`` allocates capability tag memory
+        for the backend. The ``cheri-tags-path`` option (which implies
+        ``cheri-tags=on``) maps the tags from a file instead: with
+        ``share=on`` tag updates are written back to the file, with
+        ``share=off`` the file is mapped copy-on-write. Together with a
+        ``share=off`` ``mem-path`` this allows starting many guests from the
+        same RAM and tag images that were written by a guest with ``share=on``
+        and migrated to a file with the ``x-ignore-shared`` capability, e.g.
+        ``-incoming "exec:cat state.bin"``. Every guest then shares the host
+        page cache for the unmodified parts of the snapshot.
+
+        With ``share=on`` and ``cheri-tags=on``, the tags are allocated in
+        shared memory as well. vhost-user backends that write to the memory
+        must clear the tags of the data they write and are passed the tags
+        with the memory table, see ``VHOST_USER_PROTOCOL_F_CHERI_TAGS``.
+
     ``-object memory-backend-ram,id=id,merge=on|off,dump=on|off,share=on|off,prealloc=on|off,size=size,host-nodes=host-nodes,policy=default|preferred|bind|interleave``
         Creates a memory backend object, which can be used to back the
         guest RAM. Memory backend objects offer more control than the
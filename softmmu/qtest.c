@@ -34,6 +34,10 @@
 #ifdef CONFIG_PSERIES
 #include "hw/ppc/spapr_rtas.h"
 #endif
+#ifdef TARGET_CHERI
+#include "exec/ramblock.h"
+#include "cheri_tagmem.h"
+#endif
 
 #define MAX_IRQ 256
 
@@ -249,8 +253,55 @@ static void *qtest_server_send_opaque;
  *
  * Forcibly set the given interrupt pin to the given level.
  *
+ * CHERI tags (CHERI targets only):
+ * ""
+ *
+ * .. code-block:: none
+ *
+ *  > cheri_tag_set ADDR
+ *  < OK
+ *
+ * .. code-block:: none
+ *
+ *  > cheri_tag_get ADDR
+ *  < OK TAG
+ *
+ * .. code-block:: none
+ *
+ *  > cheri_tag_invalidate ADDR SIZE [COUNT]
+ *  < OK
+ *
+ * Set or read the tag of the capability-sized granule containing the guest
+ * physical address ADDR, without checking the data stored there.  TAG is 0
+ * or 1.  'cheri_tag_invalidate' clears the tags of [ADDR, ADDR + SIZE) as a
+ * DMA write to the range would, COUNT times (default 1) so that benchmarks
+ * can amortize the protocol overhead.  All commands fail if the range is not
+ * RAM with tag storage.
+ *
  */
 
+#ifdef TARGET_CHERI
+/*
+ * Find the RAMBlock and offset holding the tags for the guest physical range
+ * [@addr, @addr + @size), or return NULL if it is not all in one piece of RAM.
+ */
+static RAMBlock *qtest_cheri_tag_ram(uint64_t addr, uint64_t size,
+                                     ram_addr_t *offset)
+{
+    hwaddr xlat, len = size;
+    MemoryRegion *mr;
+
+    RCU_READ_LOCK_GUARD();
+    mr = address_space_translate(first_cpu->as, addr, &xlat, &len, false,
+                                 MEMTXATTRS_UNSPECIFIED);
+    if (!memory_region_is_ram(mr) || !mr->ram_block || len < size) {
+        return NULL;
+    }
+    *offset = memory_region_get_ram_addr(mr) - mr->ram_block->offset + xlat;
+    return mr->ram_block;
+}
+#endif
+
 static int hex2nib(char ch)
 {
     if (ch >= '0' && ch <= '9') {
@@ -755,6 +806,56 @@ static void qtest_process_command(CharBackend *chr, gchar **words)
 
         qtest_send_prefix(chr);
         qtest_sendf(chr, "OK %"PRIu64"\n", res);
+#endif
+#ifdef TARGET_CHERI
+    } else if (strcmp(words[0], "cheri_tag_set") == 0 ||
+               strcmp(words[0], "cheri_tag_get") == 0) {
+        uint64_t addr;
+        ram_addr_t offset;
+        RAMBlock *ram;
+        int ret;
+
+        g_assert(words[1]);
+        ret = qemu_strtou64(words[1], NULL, 0, &addr);
+        g_assert(ret == 0);
+
+        qtest_send_prefix(chr);
+        ram = qtest_cheri_tag_ram(QEMU_ALIGN_DOWN(addr, CHERI_CAP_SIZE),
+                                  CHERI_CAP_SIZE, &offset);
+        if (!ram || !ram->cheri_tags) {
+            qtest_send(chr, "FAIL no tag storage\n");
+        } else if (strcmp(words[0], "cheri_tag_set") == 0) {
+            cheri_tag_set_debug(ram, offset);
+            qtest_send(chr, "OK\n");
+        } else {
+            qtest_sendf(chr, "OK %d\n", cheri_tag_get_debug(ram, offset));
+        }
+    } else if (strcmp(words[0], "cheri_tag_invalidate") == 0) {
+        uint64_t addr, len, count = 1;
+        ram_addr_t offset;
+        RAMBlock *ram;
+        int ret;
+
+        g_assert(words[1] && words[2]);
+        ret = qemu_strtou64(words[1], NULL, 0, &addr);
+        g_assert(ret == 0);
+        ret = qemu_strtou64(words[2], NULL, 0, &len);
+        g_assert(ret == 0);
+        if (words[3]) {
+            ret = qemu_strtou64(words[3], NULL, 0, &count);
+            g_assert(ret == 0);
+        }
+
+        qtest_send_prefix(chr);
+        ram = qtest_cheri_tag_ram(addr, len, &offset);
+        if (!ram || !ram->cheri_tags) {
+            qtest_send(chr, "FAIL no tag storage\n");
+        } else {
+            while (count--) {
+                cheri_tag_phys_invalidate_external(ram, offset, len);
+            }
+            qtest_send(chr, "OK\n");
+        }
 #endif
     } else if (qtest_enabled() && strcmp(words[0], "clock_step") == 0) {
         int64_t ns;
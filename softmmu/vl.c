@@ -181,6 +181,8 @@ static const char *qtest_chrdev;
 static const char *qtest_log;
 
 bool cheri_c2e_on_unrepresentable = false;
+const char *cheri_stats_log_path;
+uint64_t cheri_stats_log_interval_ms = 1000;
 bool cheri_debugger_on_unrepresentable = false;
 bool cheri_debugger_on_trap = false;
 static uint64_t cl_breakpoint = 0L;
@@ -189,6 +191,7 @@ static uint64_t cl_breakcount = 0L;
 #ifdef CONFIG_RVFI_DII
 int rvfi_client_fd = 0;
 bool rvfi_debug_output = false;
+const char *rvfi_shm_path = NULL;
 static int rvfi_dii_port = 0;
 
 static int rvfi_dii_socket_init(uint16_t port) {
@@ -403,6 +406,43 @@ static QemuOptsList qemu_overcommit_opts = {
     },
 };
 
+static QemuOptsList qemu_guest_profile_opts = {
+    .name = "guest-profile",
+    .implied_opt_name = "file",
+    .merge_lists = true,
+    .head = QTAILQ_HEAD_INITIALIZER(qemu_guest_profile_opts.head),
+    .desc = {
+        {
+            .name = "file",
+            .type = QEMU_OPT_STRING,
+        },
+        {
+            .name = "freq",
+            .type = QEMU_OPT_NUMBER,
+        },
+        { /* end of list */ }
+    },
+};
+
+static QemuOptsList qemu_cheri_stats_log_opts = {
+    .name = "cheri-stats-log",
+    .implied_opt_name = "file",
+    .merge_lists = true,
+    .head = QTAILQ_HEAD_INITIALIZER(qemu_cheri_stats_log_opts.head),
+    .desc = {
+        {
+            .name = "file",
+            .type = QEMU_OPT_STRING,
+        },
+        {
+            .name = "interval",
+            .type = QEMU_OPT_NUMBER,
+            .help = "sampling interval in milliseconds",
+        },
+        { /* end of list */ }
+    },
+};
+
 static QemuOptsList qemu_msg_opts = {
     .name = "msg",
     .head = QTAILQ_HEAD_INITIALIZER(qemu_msg_opts.head),
@@ -2054,6 +2094,25 @@ static bool object_create_late(const char *type)
     return !object_create_early(type);
 }
 
+static void qemu_start_guest_profile(void)
+{
+    QemuOpts *opts = qemu_opts_find(qemu_find_opts("guest-profile"), NULL);
+
+    if (!opts) {
+        return;
+    }
+#ifdef CONFIG_TCG
+    if (tcg_enabled()) {
+        tcg_guest_profile_start(qemu_opt_get(opts, "file") ?: "qemu.perf",
+                                qemu_opt_get_number(opts, "freq", 1000),
+                                &error_fatal);
+        return;
+    }
+#endif
+    error_report("-guest-profile is only supported with TCG");
+    exit(1);
+}
+
 static void qemu_create_late_backends(void)
 {
     if (qtest_chrdev) {
@@ -2824,6 +2883,13 @@ void qmp_x_exit_preconfig(Error **errp)
             error_report("RVFI-DII: maxram_size must be 8 MiB.");
             exit(EXIT_FAILURE);
         }
+        /* Injected instructions live in env, which workers cannot read. */
+        if (tcg_enabled() &&
+            object_property_get_uint(OBJECT(current_accel()), "spec-threads",
+                                     &error_abort)) {
+            error_report("RVFI-DII: spec-threads is not supported.");
+            exit(EXIT_FAILURE);
+        }
         int rvfi_listen_fd = rvfi_dii_socket_init(rvfi_dii_port);
         info_report("Waiting for incoming RVFI socket packets");
         rvfi_client_fd = accept(rvfi_listen_fd, NULL, NULL);
@@ -2901,6 +2967,8 @@ void qemu_init(int argc, char **argv, char **envp)
     qemu_add_opts(&qemu_tpmdev_opts);
     qemu_add_opts(&qemu_overcommit_opts);
     qemu_add_opts(&qemu_msg_opts);
+    qemu_add_opts(&qemu_guest_profile_opts);
+    qemu_add_opts(&qemu_cheri_stats_log_opts);
     qemu_add_opts(&qemu_name_opts);
     qemu_add_opts(&qemu_numa_opts);
     qemu_add_opts(&qemu_icount_opts);
@@ -3605,6 +3673,12 @@ void qemu_init(int argc, char **argv, char **envp)
                     qemu_log_instr_set_format(QLI_FMT_TEXT);
                 } else if (strcmp(optarg, "cvtrace") == 0) {
                     qemu_log_instr_set_format(QLI_FMT_CVTRACE);
+                } else if (strcmp(optarg, "binary") == 0) {
+                    qemu_log_instr_set_format(QLI_FMT_BINARY);
+#ifdef CONFIG_ZSTD
+                } else if (strcmp(optarg, "binary-zstd") == 0) {
+                    qemu_log_instr_set_format(QLI_FMT_BINARY_ZSTD);
+#endif
                 } else {
                     printf("Invalid choice for cheri-trace-format: '%s'\n", optarg);
                     exit(1);
@@ -3613,13 +3687,34 @@ void qemu_init(int argc, char **argv, char **envp)
             case QEMU_OPTION_cheri_trace_buffer_size:
                 qemu_log_instr_set_buffer_size(strtoul(optarg, NULL, 0));
                 break;
+            case QEMU_OPTION_cheri_trace_filter:
+                qemu_log_instr_set_tb_filter(optarg, &error_fatal);
+                break;
 #endif /* CONFIG_TCG_LOG_INSTR */
+            case QEMU_OPTION_cheri_provenance:
+                cheri_provenance_enabled = true;
+                break;
             case QEMU_OPTION_cheri_c2e_on_unrepresentable:
                 cheri_c2e_on_unrepresentable = true;
                 break;
             case QEMU_OPTION_cheri_debugger_on_unrepresentable:
                 cheri_debugger_on_unrepresentable = true;
                 break;
+            case QEMU_OPTION_cheri_stats_log:
+                opts = qemu_opts_parse_noisily(
+                    qemu_find_opts("cheri-stats-log"), optarg, true);
+                if (!opts || !qemu_opt_get(opts, "file")) {
+                    error_report("-cheri-stats-log: a file name is required");
+                    exit(1);
+                }
+                cheri_stats_log_path = g_strdup(qemu_opt_get(opts, "file"));
+                cheri_stats_log_interval_ms =
+                    qemu_opt_get_number(opts, "interval", 1000);
+                if (cheri_stats_log_interval_ms == 0) {
+                    error_report("-cheri-stats-log: invalid interval");
+                    exit(1);
+                }
+                break;
             case QEMU_OPTION_cheri_debugger_on_trap:
                 cheri_debugger_on_trap = true;
                 break;
@@ -3627,6 +3722,9 @@ void qemu_init(int argc, char **argv, char **envp)
             case QEMU_OPTION_rvfi_dii_debug:
                 rvfi_debug_output = true;
                 break;
+            case QEMU_OPTION_rvfi_dii_shm:
+                rvfi_shm_path = optarg;
+                break;
             case QEMU_OPTION_rvfi_dii_port:
                 rvfi_dii_port = strtoull(optarg, NULL, 0);
                 if (rvfi_dii_port == 0 || rvfi_dii_port > USHRT_MAX) {
@@ -3789,6 +3887,13 @@ void qemu_init(int argc, char **argv, char **envp)
                     visit_free(v);
                     break;
                 }
+            case QEMU_OPTION_guest_profile:
+                opts = qemu_opts_parse_noisily(qemu_find_opts("guest-profile"),
+                                               optarg, true);
+                if (!opts) {
+                    exit(1);
+                }
+                break;
             case QEMU_OPTION_msg:
                 opts = qemu_opts_parse_noisily(qemu_find_opts("msg"), optarg,
                                                false);
@@ -3934,6 +4039,7 @@ void qemu_init(int argc, char **argv, char **envp)
     }
     qemu_init_displays();
     accel_setup_post(current_machine);
+    qemu_start_guest_profile();
     os_setup_post();
     resume_mux_open();
 }
@@ -0,0 +1,6 @@
+#include "qemu/osdep.h"
+
+#include "sysemu/sysemu.h"
+
+/* Non-CHERI targets accept -cheri-provenance but never record anything. */
+bool cheri_provenance_enabled;
@@ -59,6 +59,8 @@
 /* Round number up to multiple */
 #define ALIGN_UP(n, m) ALIGN_DOWN((n) + (m) - 1, (m))
 
+#define VU_BITS_PER_LONG (sizeof(unsigned long) * 8)
+
 #ifndef unlikely
 #define unlikely(x)   __builtin_expect(!!(x), 0)
 #endif
@@ -140,6 +142,7 @@ vu_request_to_string(unsigned int req)
         REQ(VHOST_USER_GET_MAX_MEM_SLOTS),
         REQ(VHOST_USER_ADD_MEM_REG),
         REQ(VHOST_USER_REM_MEM_REG),
+        REQ(VHOST_USER_SET_CHERI_TAGS),
         REQ(VHOST_USER_MAX),
     };
 #undef REQ
@@ -199,6 +202,56 @@ vu_gpa_to_va(VuDev *dev, uint64_t *plen, uint64_t guest_addr)
     return NULL;
 }
 
+void
+vu_cheri_tags_clear(VuDev *dev, uint64_t guest_addr, uint64_t len)
+{
+    int i;
+
+    if (!vu_has_protocol_feature(dev, VHOST_USER_PROTOCOL_F_CHERI_TAGS) ||
+        !len) {
+        return;
+    }
+
+    for (i = 0; i < dev->nregions; i++) {
+        VuDevRegion *r = &dev->regions[i];
+        unsigned long *tags = (unsigned long *)(uintptr_t)r->tags_mmap_addr;
+        uint64_t start, end, tag, last;
+
+        if (!tags || guest_addr + len <= r->gpa ||
+            guest_addr >= r->gpa + r->size) {
+            continue;
+        }
+        start = (guest_addr > r->gpa ? guest_addr : r->gpa) - r->gpa;
+        end = MIN(guest_addr + len, r->gpa + r->size) - r->gpa;
+        tag = r->tag_offset + start / r->tag_granule;
+        last = r->tag_offset + (end - 1) / r->tag_granule;
+
+        /* QEMU may concurrently set other tags in the same words */
+        while (tag <= last) {
+            unsigned int shift = tag % VU_BITS_PER_LONG;
+            uint64_t n = MIN(last - tag + 1,
+                             (uint64_t)(VU_BITS_PER_LONG - shift));
+            unsigned long mask = (n == VU_BITS_PER_LONG ? ~0UL :
+                                  ((1UL << n) - 1)) << shift;
+
+            qatomic_and(&tags[tag / VU_BITS_PER_LONG], ~mask);
+            tag += n;
+        }
+    }
+}
+
+static void
+vu_region_unmap_tags(VuDevRegion *r)
+{
+    void *m = (void *)(uintptr_t)r->tags_mmap_addr;
+
+    if (m) {
+        munmap(m, r->tags_mmap_size);
+    }
+    r->tags_mmap_addr = 0;
+    r->tags_mmap_size = 0;
+}
+
 /* Translate qemu virtual address to our virtual address.  */
 static void *
 qva_to_va(VuDev *dev, uint64_t qemu_addr)
@@ -856,6 +909,7 @@ vu_rem_mem_reg(VuDev *dev, VhostUserMsg *vmsg) {
             if (m) {
                 munmap(m, r->size + r->mmap_offset);
             }
+            vu_region_unmap_tags(r);
 
             /*
              * Shift all affected entries by 1 to close the hole at index i and
@@ -885,6 +939,61 @@ vu_rem_mem_reg(VuDev *dev, VhostUserMsg *vmsg) {
     return true;
 }
 
+static bool
+vu_set_cheri_tags(VuDev *dev, VhostUserMsg *vmsg)
+{
+    VhostUserCheriTags t = vmsg->payload.cheri_tags, *msg_tags = &t;
+    VuDevRegion *r = NULL;
+    void *mmap_addr;
+    int i;
+
+    if (vmsg->fd_num != 1 || vmsg->size < sizeof(*msg_tags)) {
+        vmsg_close_fds(vmsg);
+        vu_panic(dev, "Invalid VHOST_USER_SET_CHERI_TAGS message");
+        return false;
+    }
+
+    DPRINT("CHERI tags:\n");
+    DPRINT("    guest_phys_addr: 0x%016"PRIx64"\n",
+           msg_tags->guest_phys_addr);
+    DPRINT("    memory_size:     0x%016"PRIx64"\n", msg_tags->memory_size);
+    DPRINT("    mmap_size:       0x%016"PRIx64"\n", msg_tags->mmap_size);
+    DPRINT("    tag_offset:      0x%016"PRIx64"\n", msg_tags->tag_offset);
+    DPRINT("    granule_size:    %"PRId64"\n", msg_tags->granule_size);
+
+    for (i = 0; i < dev->nregions; i++) {
+        if (dev->regions[i].gpa == msg_tags->guest_phys_addr &&
+            dev->regions[i].size == msg_tags->memory_size) {
+            r = &dev->regions[i];
+            break;
+        }
+    }
+    if (!r || !msg_tags->granule_size ||
+        (msg_tags->tag_offset + msg_tags->memory_size /
+         msg_tags->granule_size + 7) / 8 > msg_tags->mmap_size) {
+        close(vmsg->fds[0]);
+        vu_panic(dev, "Invalid CHERI tags for region 0x%016"PRIx64,
+                 msg_tags->guest_phys_addr);
+        return false;
+    }
+
+    mmap_addr = mmap(0, msg_tags->mmap_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, vmsg->fds[0], 0);
+    close(vmsg->fds[0]);
+    if (mmap_addr == MAP_FAILED) {
+        vu_panic(dev, "CHERI tags mmap error: %s", strerror(errno));
+        return false;
+    }
+
+    vu_region_unmap_tags(r);
+    r->tags_mmap_addr = (uint64_t)(uintptr_t)mmap_addr;
+    r->tags_mmap_size = msg_tags->mmap_size;
+    r->tag_offset = msg_tags->tag_offset;
+    r->tag_granule = msg_tags->granule_size;
+
+    return false;
+}
+
 static bool
 vu_set_mem_table_exec_postcopy(VuDev *dev, VhostUserMsg *vmsg)
 {
@@ -975,6 +1084,7 @@ vu_set_mem_table_exec(VuDev *dev, VhostUserMsg *vmsg)
         if (m) {
             munmap(m, r->size + r->mmap_offset);
         }
+        vu_region_unmap_tags(r);
     }
     dev->nregions = memory->nregions;
 
@@ -1456,7 +1566,8 @@ vu_get_protocol_features_exec(VuDev *dev, VhostUserMsg *vmsg)
                         1ULL << VHOST_USER_PROTOCOL_F_HOST_NOTIFIER |
                         1ULL << VHOST_USER_PROTOCOL_F_SLAVE_SEND_FD |
                         1ULL << VHOST_USER_PROTOCOL_F_REPLY_ACK |
-                        1ULL << VHOST_USER_PROTOCOL_F_CONFIGURE_MEM_SLOTS;
+                        1ULL << VHOST_USER_PROTOCOL_F_CONFIGURE_MEM_SLOTS |
+                        1ULL << VHOST_USER_PROTOCOL_F_CHERI_TAGS;
 
     if (have_userfault()) {
         features |= 1ULL << VHOST_USER_PROTOCOL_F_PAGEFAULT;
@@ -1934,6 +2045,8 @@ vu_process_message(VuDev *dev, VhostUserMsg *vmsg)
         return vu_add_mem_reg(dev, vmsg);
     case VHOST_USER_REM_MEM_REG:
         return vu_rem_mem_reg(dev, vmsg);
+    case VHOST_USER_SET_CHERI_TAGS:
+        return vu_set_cheri_tags(dev, vmsg);
     default:
         vmsg_close_fds(vmsg);
         vu_panic(dev, "Unhandled request: %d", vmsg->request);
@@ -1988,6 +2101,7 @@ vu_deinit(VuDev *dev)
         if (m != MAP_FAILED) {
             munmap(m, r->size + r->mmap_offset);
         }
+        vu_region_unmap_tags(r);
     }
     dev->nregions = 0;
 
@@ -2452,28 +2566,42 @@ void vu_queue_notify_sync(VuDev *dev, VuVirtq *vq)
     _vu_queue_notify(dev, vq, true);
 }
 
+/*
+ * Clear the CHERI tags of a part of the used ring before writing to it, so
+ * that the guest never sees a tagged capability with data from the backend.
+ */
 static inline void
-vring_used_flags_set_bit(VuVirtq *vq, int mask)
+vring_used_tags_clear(VuDev *dev, VuVirtq *vq, size_t offset, size_t len)
+{
+    vu_cheri_tags_clear(dev, vq->vring.log_guest_addr + offset, len);
+}
+
+static inline void
+vring_used_flags_set_bit(VuDev *dev, VuVirtq *vq, int mask)
 {
     uint16_t *flags;
 
+    vring_used_tags_clear(dev, vq, offsetof(struct vring_used, flags),
+                          sizeof(*flags));
     flags = (uint16_t *)((char*)vq->vring.used +
                          offsetof(struct vring_used, flags));
     *flags = htole16(le16toh(*flags) | mask);
 }
 
 static inline void
-vring_used_flags_unset_bit(VuVirtq *vq, int mask)
+vring_used_flags_unset_bit(VuDev *dev, VuVirtq *vq, int mask)
 {
     uint16_t *flags;
 
+    vring_used_tags_clear(dev, vq, offsetof(struct vring_used, flags),
+                          sizeof(*flags));
     flags = (uint16_t *)((char*)vq->vring.used +
                          offsetof(struct vring_used, flags));
     *flags = htole16(le16toh(*flags) & ~mask);
 }
 
 static inline void
-vring_set_avail_event(VuVirtq *vq, uint16_t val)
+vring_set_avail_event(VuDev *dev, VuVirtq *vq, uint16_t val)
 {
     uint16_t *avail;
 
@@ -2481,6 +2609,9 @@ vring_set_avail_event(VuVirtq *vq, uint16_t val)
         return;
     }
 
+    vring_used_tags_clear(dev, vq,
+                          offsetof(struct vring_used, ring[vq->vring.num]),
+                          sizeof(*avail));
     avail = (uint16_t *)&vq->vring.used->ring[vq->vring.num];
     *avail = htole16(val);
 }
@@ -2490,11 +2621,11 @@ vu_queue_set_notification(VuDev *dev, VuVirtq *vq, int enable)
 {
     vq->notification = enable;
     if (vu_has_feature(dev, VIRTIO_RING_F_EVENT_IDX)) {
-        vring_set_avail_event(vq, vring_avail_idx(vq));
+        vring_set_avail_event(dev, vq, vring_avail_idx(vq));
     } else if (enable) {
-        vring_used_flags_unset_bit(vq, VRING_USED_F_NO_NOTIFY);
+        vring_used_flags_unset_bit(dev, vq, VRING_USED_F_NO_NOTIFY);
     } else {
-        vring_used_flags_set_bit(vq, VRING_USED_F_NO_NOTIFY);
+        vring_used_flags_set_bit(dev, vq, VRING_USED_F_NO_NOTIFY);
     }
     if (enable) {
         /* Expose avail event/used flags before caller checks the avail idx. */
@@ -2517,6 +2648,11 @@ virtqueue_map_desc(VuDev *dev,
         return false;
     }
 
+    /* The backend writes the buffer directly, so clear its tags first. */
+    if (is_write) {
+        vu_cheri_tags_clear(dev, pa, sz);
+    }
+
     while (sz) {
         uint64_t len = sz;
 
@@ -2746,7 +2882,7 @@ vu_queue_pop(VuDev *dev, VuVirtq *vq, size_t sz)
     }
 
     if (vu_has_feature(dev, VIRTIO_RING_F_EVENT_IDX)) {
-        vring_set_avail_event(vq, vq->last_avail_idx);
+        vring_set_avail_event(dev, vq, vq->last_avail_idx);
     }
 
     elem = vu_queue_map_desc(dev, vq, head, sz);
@@ -2795,6 +2931,8 @@ void vring_used_write(VuDev *dev, VuVirtq *vq,
 {
     struct vring_used *used = vq->vring.used;
 
+    vring_used_tags_clear(dev, vq, offsetof(struct vring_used, ring[i]),
+                          sizeof(used->ring[i]));
     used->ring[i] = *uelem;
     vu_log_write(dev, vq->vring.log_guest_addr +
                  offsetof(struct vring_used, ring[i]),
@@ -2852,6 +2990,13 @@ vu_log_queue_fill(VuDev *dev, VuVirtq *vq,
 
         if (le16toh(desc[i].flags) & VRING_DESC_F_WRITE) {
             min = MIN(le32toh(desc[i].len), len);
+            /*
+             * The tags were cleared when the buffer was popped, but the guest
+             * may have stored a capability into it since then. Clear them
+             * again now that the data is written, before the used ring entry
+             * is published.
+             */
+            vu_cheri_tags_clear(dev, le64toh(desc[i].addr), min);
             vu_log_write(dev, le64toh(desc[i].addr), min);
             len -= min;
         }
@@ -2885,6 +3030,8 @@ vu_queue_fill(VuDev *dev, VuVirtq *vq,
 static inline
 void vring_used_idx_set(VuDev *dev, VuVirtq *vq, uint16_t val)
 {
+    vring_used_tags_clear(dev, vq, offsetof(struct vring_used, idx),
+                          sizeof(vq->vring.used->idx));
     vq->vring.used->idx = htole16(val);
     vu_log_write(dev,
                  vq->vring.log_guest_addr + offsetof(struct vring_used, idx),
@@ -64,6 +64,8 @@ enum VhostUserProtocolFeature {
     VHOST_USER_PROTOCOL_F_INFLIGHT_SHMFD = 12,
     VHOST_USER_PROTOCOL_F_INBAND_NOTIFICATIONS = 14,
     VHOST_USER_PROTOCOL_F_CONFIGURE_MEM_SLOTS = 15,
+    /* Feature 16 is VHOST_USER_PROTOCOL_F_STATUS. */
+    VHOST_USER_PROTOCOL_F_CHERI_TAGS = 17,
 
     VHOST_USER_PROTOCOL_F_MAX
 };
@@ -109,6 +111,7 @@ typedef enum VhostUserRequest {
     VHOST_USER_GET_MAX_MEM_SLOTS = 36,
     VHOST_USER_ADD_MEM_REG = 37,
     VHOST_USER_REM_MEM_REG = 38,
+    VHOST_USER_SET_CHERI_TAGS = 41,
     VHOST_USER_MAX
 } VhostUserRequest;
 
@@ -142,6 +145,14 @@ typedef struct VhostUserMemRegMsg {
     VhostUserMemoryRegion region;
 } VhostUserMemRegMsg;
 
+typedef struct VhostUserCheriTags {
+    uint64_t guest_phys_addr;
+    uint64_t memory_size;
+    uint64_t mmap_size;
+    uint64_t tag_offset;
+    uint64_t granule_size;
+} VhostUserCheriTags;
+
 typedef struct VhostUserLog {
     uint64_t mmap_size;
     uint64_t mmap_offset;
@@ -195,6 +206,7 @@ typedef struct VhostUserMsg {
         struct vhost_vring_addr addr;
         VhostUserMemory memory;
         VhostUserMemRegMsg memreg;
+        VhostUserCheriTags cheri_tags;
         VhostUserLog log;
         VhostUserConfig config;
         VhostUserVringArea area;
@@ -217,6 +229,13 @@ typedef struct VuDevRegion {
     uint64_t mmap_offset;
     /* Start address of mmaped space. */
     uint64_t mmap_addr;
+    /* Start address and size of the mmaped CHERI tags (or 0). */
+    uint64_t tags_mmap_addr;
+    uint64_t tags_mmap_size;
+    /* Index of the region's first tag in the mapping. */
+    uint64_t tag_offset;
+    /* Bytes of memory covered by one tag. */
+    uint64_t tag_granule;
 } VuDevRegion;
 
 typedef struct VuDev VuDev;
@@ -483,6 +502,20 @@ void vu_deinit(VuDev *dev);
  */
 bool vu_dispatch(VuDev *dev);
 
+/**
+ * vu_cheri_tags_clear:
+ * @dev: a VuDev context
+ * @guest_addr: guest address
+ * @len: length of the write
+ *
+ * Clear the CHERI capability tags of guest memory before the backend writes
+ * to it.  This is done for the device-writable buffers of the elements
+ * returned by vu_queue_pop() (again after the write, in vu_queue_fill()) and
+ * for all writes to the used ring, backends only need to call it when they
+ * write to guest memory in some other way.
+ */
+void vu_cheri_tags_clear(VuDev *dev, uint64_t guest_addr, uint64_t len);
+
 /**
  * vu_gpa_to_va:
  * @dev: a VuDev context
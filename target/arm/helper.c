@@ -13134,14 +13134,18 @@ static ARMCacheAttrs combine_cacheattrs(ARMCacheAttrs s1, ARMCacheAttrs s2)
  * @attrs: set to the memory transaction attributes to use
  * @prot: set to the permissions for the page containing phys_ptr
  * @page_size: set to the size of the page containing phys_ptr
+ * @leaf_size: (get_phys_addr_leaf only) set to the size of the region
+ *             containing phys_ptr that is mapped linearly with the same
+ *             attrs and prot, which may be smaller than page_size for a
+ *             two-stage translation.  do_get_phys_addr only sets it then.
  * @fi: set to fault info if the translation fails
  * @cacheattrs: (if non-NULL) set to the cacheability/shareability attributes
  */
-bool get_phys_addr(CPUARMState *env, target_ulong address,
-                   MMUAccessType access_type, ARMMMUIdx mmu_idx,
-                   hwaddr *phys_ptr, MemTxAttrs *attrs, int *prot,
-                   target_ulong *page_size,
-                   ARMMMUFaultInfo *fi, ARMCacheAttrs *cacheattrs)
+static bool do_get_phys_addr(CPUARMState *env, target_ulong address,
+                             MMUAccessType access_type, ARMMMUIdx mmu_idx,
+                             hwaddr *phys_ptr, MemTxAttrs *attrs, int *prot,
+                             target_ulong *page_size, target_ulong *leaf_size,
+                             ARMMMUFaultInfo *fi, ARMCacheAttrs *cacheattrs)
 {
     ARMMMUIdx s1_mmu_idx = stage_1_mmu_idx(mmu_idx);
 
@@ -13152,6 +13156,7 @@ bool get_phys_addr(CPUARMState *env, target_ulong address,
         if (arm_feature(env, ARM_FEATURE_EL2)) {
             hwaddr ipa;
             int s2_prot;
+            target_ulong s2_page_size;
             int ret;
             bool ipa_secure;
             ARMCacheAttrs cacheattrs2 = {};
@@ -13184,7 +13189,7 @@ bool get_phys_addr(CPUARMState *env, target_ulong address,
             /* S1 is done. Now do S2 translation.  */
             ret = get_phys_addr_lpae(env, ipa, access_type, s2_mmu_idx, is_el0,
                                      phys_ptr, attrs, &s2_prot,
-                                     page_size, fi, &cacheattrs2);
+                                     &s2_page_size, fi, &cacheattrs2);
             fi->s2addr = ipa;
             /* Combine the S1 and S2 perms.  */
             // LC_CLEAR and LC_TRAP are sadly inverted as they DISALLOW behavior
@@ -13196,6 +13201,14 @@ bool get_phys_addr(CPUARMState *env, target_ulong address,
                 return ret;
             }
 
+            /*
+             * Invalidating any page of the S1 page must flush this one, so
+             * report the larger of the S1 and S2 page sizes.  The mapping
+             * is only linear within the smaller one.
+             */
+            *leaf_size = MIN(*page_size, s2_page_size);
+            *page_size = MAX(*page_size, s2_page_size);
+
             /* Combine the S1 and S2 cache attributes. */
             if (arm_hcr_el2_eff(env) & HCR_DC) {
                 /*
@@ -13361,6 +13374,36 @@ bool get_phys_addr(CPUARMState *env, target_ulong address,
     }
 }
 
+bool get_phys_addr_leaf(CPUARMState *env, target_ulong address,
+                        MMUAccessType access_type, ARMMMUIdx mmu_idx,
+                        hwaddr *phys_ptr, MemTxAttrs *attrs, int *prot,
+                        target_ulong *page_size, target_ulong *leaf_size,
+                        ARMMMUFaultInfo *fi, ARMCacheAttrs *cacheattrs)
+{
+    *leaf_size = 0;
+    if (do_get_phys_addr(env, address, access_type, mmu_idx, phys_ptr, attrs,
+                         prot, page_size, leaf_size, fi, cacheattrs)) {
+        return true;
+    }
+    if (*leaf_size == 0) {
+        *leaf_size = *page_size;
+    }
+    return false;
+}
+
+bool get_phys_addr(CPUARMState *env, target_ulong address,
+                   MMUAccessType access_type, ARMMMUIdx mmu_idx,
+                   hwaddr *phys_ptr, MemTxAttrs *attrs, int *prot,
+                   target_ulong *page_size,
+                   ARMMMUFaultInfo *fi, ARMCacheAttrs *cacheattrs)
+{
+    target_ulong leaf_size;
+
+    return get_phys_addr_leaf(env, address, access_type, mmu_idx, phys_ptr,
+                              attrs, prot, page_size, &leaf_size, fi,
+                              cacheattrs);
+}
+
 hwaddr arm_cpu_get_phys_page_attrs_debug(CPUState *cs, vaddr addr,
                                          MemTxAttrs *attrs)
 {
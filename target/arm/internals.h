@@ -1297,6 +1297,13 @@ bool get_phys_addr(CPUARMState *env, target_ulong address,
                    ARMMMUFaultInfo *fi, ARMCacheAttrs *cacheattrs)
     __attribute__((nonnull));
 
+bool get_phys_addr_leaf(CPUARMState *env, target_ulong address,
+                        MMUAccessType access_type, ARMMMUIdx mmu_idx,
+                        hwaddr *phys_ptr, MemTxAttrs *attrs, int *prot,
+                        target_ulong *page_size, target_ulong *leaf_size,
+                        ARMMMUFaultInfo *fi, ARMCacheAttrs *cacheattrs)
+    __attribute__((nonnull));
+
 void arm_log_exception(CPUState *cs);
 
 #endif /* !CONFIG_USER_ONLY */
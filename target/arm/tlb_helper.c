@@ -183,7 +183,7 @@ bool arm_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
     ARMCPU *cpu = ARM_CPU(cs);
     ARMMMUFaultInfo fi = {};
     hwaddr phys_addr;
-    target_ulong page_size;
+    target_ulong page_size, leaf_size;
     int prot, ret;
     MemTxAttrs attrs = {};
     ARMCacheAttrs cacheattrs = {};
@@ -194,10 +194,10 @@ bool arm_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
      * return false.  Otherwise populate fsr with ARM DFSR/IFSR fault
      * register format, and signal the fault.
      */
-    ret = get_phys_addr(&cpu->env, address, access_type,
-                        core_to_arm_mmu_idx(&cpu->env, mmu_idx),
-                        &phys_addr, &attrs, &prot, &page_size,
-                        &fi, &cacheattrs);
+    ret = get_phys_addr_leaf(&cpu->env, address, access_type,
+                             core_to_arm_mmu_idx(&cpu->env, mmu_idx),
+                             &phys_addr, &attrs, &prot, &page_size,
+                             &leaf_size, &fi, &cacheattrs);
     if (likely(!ret)) {
         /*
          * Map a single [sub]page. Regions smaller than our declared
@@ -216,8 +216,8 @@ bool arm_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
 #ifdef TARGET_CHERI
         attrs.tag_setting = access_type == MMU_DATA_CAP_STORE;
 #endif
-        tlb_set_page_with_attrs(cs, address, phys_addr, attrs,
-                                prot, mmu_idx, page_size);
+        tlb_set_page_leaf(cs, address, phys_addr, attrs,
+                          prot, mmu_idx, page_size, leaf_size);
         return true;
     } else if (probe) {
         return false;
@@ -354,14 +354,14 @@ static void gen_a64_set_pc(DisasContext *s, TCGv_i64 src)
 
         if (!have_cheri_tb_flags(s, TB_FLAG_CHERI_PCC_BASE_ZERO)) {
             tcg_gen_setcondi_i64(TCG_COND_GEU, skip_rep_check, tbi_dst,
-                                 s->base.pcc_base);
+                                 disas_pcc_base(&s->base));
             need_and = true;
         }
 
         if (!have_cheri_tb_flags(s, TB_FLAG_CHERI_PCC_TOP_MAX)) {
             TCGv_i64 tmp = need_and ? tcg_temp_new_i64() : NULL;
             tcg_gen_setcondi_i64(TCG_COND_LEU, need_and ? tmp : skip_rep_check,
-                                 tbi_dst, s->base.pcc_top);
+                                 tbi_dst, disas_pcc_top(&s->base));
             if (need_and) {
                 tcg_gen_and_i64(skip_rep_check, skip_rep_check, tmp);
                 tcg_temp_free_i64(tmp);
@@ -2747,7 +2747,7 @@ static void disas_uncond_b_reg(DisasContext *s, uint32_t insn)
 #ifdef TARGET_CHERI
         if (cctlr_set(s, CCTLR_PCCBO)) {
             TCGv_i64 dst_tmp = new_tmp_a64(s);
-            tcg_gen_movi_i64(dst_tmp, s->base.pcc_base);
+            tcg_gen_movi_i64(dst_tmp, disas_pcc_base(&s->base));
             tcg_gen_add_i64(dst_tmp, dst_tmp, dst);
             dst = dst_tmp;
         }
@@ -41,6 +41,9 @@
 
 extern bool cheri_c2e_on_unrepresentable;
 extern bool cheri_debugger_on_unrepresentable;
+// Set by -cheri-stats-log
+extern const char *cheri_stats_log_path;
+extern uint64_t cheri_stats_log_interval_ms;
 
 static inline void
 _became_unrepresentable(CPUArchState *env, uint16_t reg, uintptr_t retpc)
@@ -208,6 +211,10 @@ DECLARE_CHERI_STAT(cgetpccincoffset)
 DECLARE_CHERI_STAT(cgetpccsetaddr)
 DECLARE_CHERI_STAT(misc);
 
+// All of the above, for query-cheri-stats
+extern struct oob_stats_info *const cheri_oob_stats[];
+extern const size_t cheri_oob_stats_count;
+
 #else /* !defined(DO_CHERI_STATISTICS) */
 
 // Don't collect any statistics by default (it slows down QEMU)
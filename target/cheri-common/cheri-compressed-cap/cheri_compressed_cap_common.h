@@ -515,10 +515,8 @@ static inline void _cc_N(unsafe_decompress_raw)(_cc_addr_t pesbt, _cc_addr_t cur
     cdp->cr_exp = bounds.E;
 }
 
-static inline void _cc_N(decompress_raw_ext)(_cc_addr_t pesbt, _cc_addr_t cursor, bool tag, uint8_t lvbits,
-                                             _cc_cap_t* cdp) {
-    _cc_N(unsafe_decompress_raw)(pesbt, cursor, tag, lvbits, cdp);
-    if (tag) {
+static inline void _cc_N(check_decompressed)(_cc_maybe_unused const _cc_cap_t* cdp) {
+    if (cdp->cr_tag) {
         _cc_debug_assert(cdp->cr_base <= _CC_N(MAX_ADDR));
 #ifndef CC_IS_MORELLO
         // Morello is perfectly happy using settag to create capabilities with length greater than 2^64.
@@ -530,6 +528,12 @@ static inline void _cc_N(decompress_raw_ext)(_cc_addr_t pesbt, _cc_addr_t cursor
     }
 }
 
+static inline void _cc_N(decompress_raw_ext)(_cc_addr_t pesbt, _cc_addr_t cursor, bool tag, uint8_t lvbits,
+                                             _cc_cap_t* cdp) {
+    _cc_N(unsafe_decompress_raw)(pesbt, cursor, tag, lvbits, cdp);
+    _cc_N(check_decompressed)(cdp);
+}
+
 static inline void _cc_N(decompress_raw)(_cc_addr_t pesbt, _cc_addr_t cursor, bool tag, _cc_cap_t* cdp) {
     _cc_N(decompress_raw_ext)(pesbt, cursor, tag, _CC_N(MAX_LEVEL_BITS), cdp);
 }
@@ -541,6 +545,84 @@ static inline void _cc_N(decompress_mem)(uint64_t pesbt, uint64_t cursor, bool t
     _cc_N(decompress_raw_ext)(pesbt ^ _CC_N(MEM_XOR_MASK), cursor, tag, _CC_N(MAX_LEVEL_BITS), cdp);
 }
 
+/// Returns the bits of @p cursor that compute_base_top() depends on: two capabilities with the same
+/// bounds bits and the same key have the same base and top.
+static inline _cc_addr_t _cc_N(bounds_cursor_key)(_cc_bounds_bits bounds, _cc_addr_t cursor) {
+#if _CC_N(USES_V9_CORRECTION_FACTORS) != 0
+    unsigned shift = _CC_MIN(_CC_MAX_EXPONENT, bounds.E) + _CC_MANTISSA_WIDTH - 3;
+#else
+    unsigned shift = bounds.E;
+#endif
+    return shift >= _CC_ADDR_WIDTH ? 0 : _cc_N(cap_bounds_address)(cursor) >> shift;
+}
+
+/// Decode only the bounds of @p n capabilities, e.g. when scanning memory for tagged capabilities.
+/// This skips filling in the rest of _cc_cap_t, which is not needed for such scans.
+static inline void _cc_N(decode_bounds_batch)(const _cc_addr_t* pesbt, const _cc_addr_t* cursor, size_t n,
+                                              _cc_addr_t* base_out, _cc_length_t* top_out, bool* valid_out) {
+    for (size_t i = 0; i < n; i++) {
+        valid_out[i] =
+            _cc_N(compute_base_top)(_cc_N(extract_bounds_bits)(pesbt[i]), cursor[i], &base_out[i], &top_out[i]);
+    }
+}
+
+/// Decompress @p n capabilities, equivalent to calling decompress_raw_ext() for each of them.
+static inline void _cc_N(decompress_raw_batch)(const _cc_addr_t* pesbt, const _cc_addr_t* cursor, const bool* tags,
+                                               size_t n, uint8_t lvbits, _cc_cap_t* cdp) {
+    for (size_t i = 0; i < n; i++)
+        _cc_N(decompress_raw_ext)(pesbt[i], cursor[i], tags[i], lvbits, &cdp[i]);
+}
+
+/// A small direct-mapped cache of decoded bounds, for callers that repeatedly decompress the same
+/// capabilities (e.g. the program counter, default data and stack capabilities of a CPU). Entries
+/// are a pure function of pesbt and the cursor key, so the cache never needs to be invalidated.
+/// A zero-initialized cache is empty.
+#ifndef _CC_BOUNDS_CACHE_BITS
+#define _CC_BOUNDS_CACHE_BITS 4
+#endif
+struct _cc_N(bounds_cache_entry) {
+    _cc_addr_t pesbt;
+    _cc_addr_t key;
+    _cc_length_t top;
+    _cc_addr_t base;
+    uint8_t exp;
+    uint8_t bounds_valid;
+    uint8_t filled;
+};
+struct _cc_N(bounds_cache) {
+    struct _cc_N(bounds_cache_entry) entries[1 << _CC_BOUNDS_CACHE_BITS];
+};
+
+/// Like decompress_raw_ext(), but look up the bounds in @p cache first.
+static inline void _cc_N(decompress_raw_cached)(struct _cc_N(bounds_cache) * cache, _cc_addr_t pesbt,
+                                                _cc_addr_t cursor, bool tag, _cc_maybe_unused uint8_t lvbits,
+                                                _cc_cap_t* cdp) {
+    _cc_bounds_bits bounds = _cc_N(extract_bounds_bits)(pesbt);
+    _cc_addr_t key = _cc_N(bounds_cursor_key)(bounds, cursor);
+    uint64_t hash = ((uint64_t)pesbt ^ (uint64_t)key) * UINT64_C(0x9E3779B97F4A7C15);
+    struct _cc_N(bounds_cache_entry)* entry = &cache->entries[hash >> (64 - _CC_BOUNDS_CACHE_BITS)];
+
+    memset(cdp, 0, sizeof(*cdp));
+    cdp->cr_tag = tag;
+    cdp->_cr_cursor = cursor;
+    cdp->cr_pesbt = pesbt;
+#if _CC_N(MANDATORY_LEVEL_BITS) != _CC_N(MAX_LEVEL_BITS)
+    cdp->cr_lvbits = lvbits;
+#endif
+    if (!entry->filled || entry->pesbt != pesbt || entry->key != key) {
+        entry->bounds_valid = _cc_N(compute_base_top)(bounds, cursor, &entry->base, &entry->top);
+        entry->exp = bounds.E;
+        entry->pesbt = pesbt;
+        entry->key = key;
+        entry->filled = true;
+    }
+    cdp->cr_base = entry->base;
+    cdp->_cr_top = entry->top;
+    cdp->cr_bounds_valid = entry->bounds_valid;
+    cdp->cr_exp = entry->exp;
+    _cc_N(check_decompressed)(cdp);
+}
+
 /// Check that the expanded bounds match the compressed cr_pesbt value.
 static inline bool _cc_N(pesbt_is_correct)(const _cc_cap_t* csp) {
     _cc_cap_t tmp;
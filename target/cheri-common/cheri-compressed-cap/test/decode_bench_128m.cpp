@@ -0,0 +1 @@
+#include "decode_bench_common.cpp"
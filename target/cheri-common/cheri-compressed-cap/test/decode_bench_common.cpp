@@ -0,0 +1,94 @@
+// Compare the throughput of decompress_raw(), decompress_raw_batch(), decode_bounds_batch() and
+// decompress_raw_cached() on the sail-generated inputs used by random_inputs_test_*.
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../cheri_compressed_cap.h"
+#define CC_FORMAT_LOWER TEST_CC_FORMAT_LOWER
+#define CC_FORMAT_UPPER TEST_CC_FORMAT_UPPER
+
+#if _CC_N(CAP_BITS) == 64
+#include "decode_inputs_64.cpp"
+#elif _CC_N(CAP_BITS) == 128
+#include "decode_inputs_128.cpp"
+#else
+#error "Unknown capability size"
+#endif
+
+#define array_lengthof(arr) (sizeof(arr) / sizeof(arr[0]))
+
+static const size_t iterations = 200;
+// Avoid the compiler optimizing away the decoded values
+static volatile uint64_t sink;
+
+template <typename Fn> static void run(const char* name, size_t count, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%-22s %8.2f Mcaps/s\n", name, count * iterations / elapsed.count() / 1e6);
+}
+
+int main() {
+    const size_t n = array_lengthof(inputs);
+    std::vector<_cc_addr_t> pesbt(n), cursor(n);
+    std::vector<bool> tag_vector(n, false);
+    bool* tags = new bool[n]();
+    std::vector<_cc_cap_t> caps(n);
+    std::vector<_cc_addr_t> base(n);
+    std::vector<_cc_length_t> top(n);
+    bool* valid = new bool[n];
+
+    for (size_t i = 0; i < n; i++) {
+        pesbt[i] = (_cc_addr_t)inputs[i].pesbt;
+        cursor[i] = (_cc_addr_t)inputs[i].cursor;
+    }
+    printf("Decoding %zu capabilities %zu times (%s)\n", n, iterations, _CC_STRINGIFY(CC_FORMAT_LOWER));
+
+    run("decompress_raw", n, [&]() {
+        for (size_t i = 0; i < n; i++)
+            _cc_N(decompress_raw)(pesbt[i], cursor[i], false, &caps[i]);
+        sink = caps[n - 1].cr_base;
+    });
+    run("decompress_raw_batch", n, [&]() {
+        _cc_N(decompress_raw_batch)(pesbt.data(), cursor.data(), tags, n, _CC_N(MAX_LEVEL_BITS), caps.data());
+        sink = caps[n - 1].cr_base;
+    });
+    run("decode_bounds_batch", n, [&]() {
+        _cc_N(decode_bounds_batch)(pesbt.data(), cursor.data(), n, base.data(), top.data(), valid);
+        sink = base[n - 1];
+    });
+
+    // The cache is meant for a few hot registers, so decode the same capabilities with
+    // changing cursors (e.g. a stack pointer moving within its bounds).
+    struct _cc_N(bounds_cache) cache;
+    memset(&cache, 0, sizeof(cache));
+    const _cc_cap_t hot[3] = {
+        _cc_N(make_max_perms_cap)(0, 0x1000, _CC_N(MAX_TOP)),
+        _cc_N(make_max_perms_cap)(0x10000, 0x10000, 0x20000),
+        _cc_N(make_max_perms_cap)(0x7ff000, 0x7ff000, 0x800000),
+    };
+    run("decompress_raw (hot)", n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            const _cc_cap_t& c = hot[i % 3];
+            _cc_N(decompress_raw)(c.cr_pesbt, c.cr_base + (i & 0xff0), true, &caps[i]);
+        }
+        sink = caps[n - 1].cr_base;
+    });
+    run("decompress_raw_cached", n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            const _cc_cap_t& c = hot[i % 3];
+            _cc_N(decompress_raw_cached)(&cache, c.cr_pesbt, c.cr_base + (i & 0xff0), true, _CC_N(MAX_LEVEL_BITS),
+                                         &caps[i]);
+        }
+        sink = caps[n - 1].cr_base;
+    });
+
+    delete[] tags;
+    delete[] valid;
+    return 0;
+}
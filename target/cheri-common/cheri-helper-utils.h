@@ -266,6 +266,36 @@ void store_cap_to_memory(CPUArchState *env, uint32_t cs, uint32_t cb,
 void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs, uint32_t cb,
                                    target_ulong vaddr, uintptr_t retpc,
                                    int mmu_idx);
+/*
+ * Atomic capability operations for MTTCG. The caller must have checked the
+ * permissions of the authorizing capability cb.
+ *
+ * cmpxchg_cap_in_memory() stores cs if memory still holds the raw value
+ * returned by load_cap_from_memory_with_raw() and returns whether it did. It
+ * only takes store faults.
+ * xchg_cap_in_memory() stores cs and returns the previous value like
+ * load_cap_from_memory_raw().
+ */
+bool cmpxchg_cap_in_memory(CPUArchState *env, uint32_t cs, uint32_t cb,
+                           target_ulong vaddr, uintptr_t retpc,
+                           target_ulong expected_pesbt,
+                           target_ulong expected_cursor, bool expected_tag);
+bool xchg_cap_in_memory(CPUArchState *env, uint32_t cs, uint32_t cb,
+                        const cap_register_t *source, target_ulong vaddr,
+                        uintptr_t retpc, target_ulong *pesbt,
+                        target_ulong *cursor);
+
+/*
+ * Whether a capability read-modify-write must use the atomic operations
+ * above. Both may restart the instruction in an exclusive context (no host
+ * compare-and-swap, or not RAM); no other vCPU runs there, so the serial
+ * load + store_cap_to_memory() sequence is atomic and also handles I/O.
+ */
+static inline bool cap_rmw_needs_atomic(CPUArchState *env)
+{
+    return qemu_tcg_mttcg_enabled() &&
+           !cpu_in_exclusive_context(env_cpu(env));
+}
 
 void load_cap_from_memory(CPUArchState *env, uint32_t cd, uint32_t cb,
                           const cap_register_t *source, target_ulong vaddr,
@@ -395,6 +425,16 @@ static inline QEMU_ALWAYS_INLINE target_ulong cap_check_common_reg(
 bool load_raw_cap_from_memory(CPUArchState *env, target_ulong *pesbt,
                               target_ulong *cursor, target_ulong vaddr,
                               uintptr_t retpc);
+/*
+ * Load with fixups applied to pesbt/tag and also return the raw memory pesbt
+ * and tag of the same access (the cursor is never changed by the fixups).
+ * Useful for load-reserved, which must reserve exactly what it returned.
+ */
+bool load_cap_from_memory_with_raw(CPUArchState *env, target_ulong *pesbt,
+                                   target_ulong *cursor, uint32_t cb,
+                                   const cap_register_t *source,
+                                   target_ulong vaddr, uintptr_t retpc,
+                                   target_ulong *raw_pesbt, bool *raw_tag);
 
 // Helper for RISCV AMOSWAP
 bool load_cap_from_memory_raw(CPUArchState *env, target_ulong *pesbt,
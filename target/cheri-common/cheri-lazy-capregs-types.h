@@ -103,6 +103,14 @@ typedef struct GPCapRegs {
      * needed. These special extra registers are always in state decompressed.
      */
     aligned_cap_register_t decompressed[NUM_LAZY_CAP_REGS];
+    /*
+     * Bounds of recently decompressed capabilities, so that values that are
+     * repeatedly reloaded from memory or copied between registers (e.g.
+     * DDC, PCC or the stack capability) do not need to be decoded again.
+     * Entries only depend on their pesbt/cursor key, so this never needs to be
+     * reset or migrated.
+     */
+    struct CAP_cc(bounds_cache) decode_cache;
 } GPCapRegs;
 
 static inline QEMU_ALWAYS_INLINE cap_register_t *
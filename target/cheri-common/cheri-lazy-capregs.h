@@ -128,9 +128,10 @@ _update_from_compressed(GPCapRegs *gpcrs, unsigned regnum, bool tag)
     lvbits = env_archcpu(env)->cfg.lvbits;
 #endif
     // Note: The _cr_cusor field is always valid. All others are lazy.
-    CAP_cc(decompress_raw_ext)(get_cap_in_gpregs(gpcrs, regnum)->cr_pesbt,
-                               get_cap_in_gpregs(gpcrs, regnum)->_cr_cursor,
-                               tag, lvbits, get_cap_in_gpregs(gpcrs, regnum));
+    CAP_cc(decompress_raw_cached)(&gpcrs->decode_cache,
+                                  get_cap_in_gpregs(gpcrs, regnum)->cr_pesbt,
+                                  get_cap_in_gpregs(gpcrs, regnum)->_cr_cursor,
+                                  tag, lvbits, get_cap_in_gpregs(gpcrs, regnum));
     set_capreg_state(gpcrs, regnum, CREG_FULLY_DECOMPRESSED);
     return get_cap_in_gpregs(gpcrs, regnum);
 }
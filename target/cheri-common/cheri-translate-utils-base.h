@@ -41,12 +41,50 @@ void cheri_tcg_prepare_for_unconditional_exception(DisasContextBase *db);
 void cheri_tcg_save_pc(DisasContextBase *db);
 
 #ifdef TARGET_CHERI
+// Record that the generated code assumes [addr, addr + len) to be within the
+// PCC bounds. Anything else ties the TB to the exact bounds.
+static inline void disas_pcc_assume_in_bounds(DisasContextBase *db,
+                                              target_ulong addr,
+                                              target_ulong len)
+{
+    if (addr < db->pcc_base || addr + len < addr ||
+        addr + len > db->pcc_top) {
+        db->pcc_bounds_exact = true;
+        return;
+    }
+    db->pcc_used_base = MIN(db->pcc_used_base, addr);
+    db->pcc_used_top = MAX(db->pcc_used_top, addr + len);
+}
+
+// Return the PCC bounds this TB is translated for. Embedding these values in
+// the generated code means the TB can only be used with the same bounds, so
+// prefer loading them from env at run time.
+static inline target_ulong disas_pcc_base(DisasContextBase *db)
+{
+    if (db->cheri_flags & TB_FLAG_CHERI_PCC_BASE_ZERO) {
+        return 0; // Part of the TB flags, no need for an exact match
+    }
+    db->pcc_bounds_exact = true;
+    return db->pcc_base;
+}
+
+static inline target_ulong disas_pcc_top(DisasContextBase *db)
+{
+    db->pcc_bounds_exact = true;
+    return db->pcc_top;
+}
+
 static inline bool in_pcc_bounds(DisasContextBase *db, target_ulong addr)
 {
     if ((db->cheri_flags & TB_FLAG_CHERI_PCC_FULL_AS) == TB_FLAG_CHERI_PCC_FULL_AS) {
         return true; // PCC spans the full address space
     }
-    return addr >= db->pcc_base && addr < db->pcc_top;
+    if (addr >= db->pcc_base && addr < db->pcc_top) {
+        disas_pcc_assume_in_bounds(db, addr, 1);
+        return true;
+    }
+    db->pcc_bounds_exact = true;
+    return false;
 }
 
 // Raise a bounds violation exception on PCC
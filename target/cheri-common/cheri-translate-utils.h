@@ -59,31 +59,6 @@ static inline void gen_cap_debug(DisasContext *ctx, int rx)
     tcg_temp_free_i32(tmp);
 }
 
-#define _gen_cap_check(type)                                                   \
-    static inline void generate_cap_##type##_check(                            \
-        TCGv_cap_checked_ptr resultaddr, uint32_t capreg, TCGv offset,         \
-        MemOp op)                                                              \
-    {                                                                          \
-        TCGv_i32 tcs = tcg_const_i32(capreg);                                  \
-        TCGv_i32 tsize = tcg_const_i32(memop_size(op));                        \
-        gen_helper_cap_##type##_check(resultaddr, cpu_env, tcs, offset,        \
-                                      tsize);                                  \
-        tcg_temp_free_i32(tsize);                                              \
-        tcg_temp_free_i32(tcs);                                                \
-    }                                                                          \
-    static inline void generate_cap_##type##_check_imm(                        \
-        TCGv_cap_checked_ptr resultaddr, uint32_t capreg, target_long offset,  \
-        MemOp op)                                                              \
-    {                                                                          \
-        TCGv toffset = tcg_const_tl(offset);                                   \
-        generate_cap_##type##_check(resultaddr, capreg, toffset, op);          \
-        tcg_temp_free(toffset);                                                \
-    }
-
-_gen_cap_check(load)
-_gen_cap_check(store)
-_gen_cap_check(rmw)
-
 #if CHERI_CAP_BITS == 128
 // FIXME: assumes small endian order between two 64-bit halves in a 128-bit
 // integer.
@@ -97,12 +72,16 @@ _gen_cap_check(rmw)
 #ifdef TARGET_MIPS
 
 #define DDC_ENV_OFFSET offsetof(CPUArchState, active_tc.CHWR.DDC)
+#define PCC_ENV_OFFSET offsetof(CPUArchState, active_tc.PCC)
 #define target_get_gpr(ctx, t, reg) gen_load_gpr((TCGv)t, reg)
 #define MERGED_FILE 0
+// All users of generate_cap_*_check() can cope with the branch it generates
+#define INLINE_CAP_MEMOP_CHECKS 1
 
 #elif defined(TARGET_AARCH64)
 
 #define DDC_ENV_OFFSET offsetof(CPUArchState, DDC_current)
+#define PCC_ENV_OFFSET offsetof(CPUArchState, pc.cap)
 // Other targets can only enable these once every call to a helper properly
 // updates disas_capreg_state
 #define ENABLE_STATIC_CAP_OPTS 1
@@ -128,12 +107,15 @@ _gen_cap_check(rmw)
 #elif defined(TARGET_RISCV)
 
 #define DDC_ENV_OFFSET offsetof(CPUArchState, ddc)
+#define PCC_ENV_OFFSET offsetof(CPUArchState, pcc)
 #define target_get_gpr_global(ctx, reg) get_gpr(ctx, reg, EXT_NONE)
 #define target_get_gpr(ctx, t, reg) gen_get_gpr(ctx, (TCGv)t, reg)
     static inline void _gen_set_gpr(DisasContext *ctx, int reg_num_dst, TCGv t,
                                     bool clear_pesbt);
 #define target_set_gpr(ctx, reg, t) _gen_set_gpr(ctx, reg, (TCGv)t, false)
 #define MERGED_FILE 1
+// All users of generate_cap_*_check() can cope with the branch it generates
+#define INLINE_CAP_MEMOP_CHECKS 1
 
 #else
 #error "Don't know how to fetch a GPR value"
@@ -177,6 +159,25 @@ static inline void generate_get_ddc_top_lo(DisasContext *ctx, TCGv top)
 }
 #endif
 
+// PCC bounds can only change at the end of a TB, so loading them from env is
+// always up-to-date and keeps the TB independent of the exact bounds.
+static inline void generate_get_pcc_base(DisasContext *ctx, TCGv base)
+{
+    tcg_gen_ld_tl(base, cpu_env,
+                  PCC_ENV_OFFSET + offsetof(cap_register_t, cr_base));
+}
+
+static inline void generate_get_pcc_top_lo(DisasContext *ctx, TCGv top)
+{
+#if CHERI_CAP_BITS == 128
+    tcg_gen_ld_tl(top, cpu_env,
+                  PCC_ENV_OFFSET + offsetof(cap_register_t, _cr_top) +
+                      CAP_TOP_LOBYTES_OFFSET);
+#else
+    tcg_gen_movi_tl(top, disas_pcc_top(&ctx->base));
+#endif
+}
+
 // Checks an address against PCC or DDC.
 // Permissions are checked at translate time, bounds checks can be skipped if
 // CHERI flags indicate bounds would make checks trivial.
@@ -237,7 +238,7 @@ static inline void _generate_special_checked_ptr(
             base = tmp2;
         } else if (!use_ddc &&
                    !have_cheri_tb_flags(ctx, TB_FLAG_CHERI_PCC_BASE_ZERO)) {
-            tcg_gen_movi_tl(tmp2, ctx->base.pcc_base);
+            generate_get_pcc_base(ctx, tmp2);
             base = tmp2;
         }
 
@@ -255,7 +256,7 @@ static inline void _generate_special_checked_ptr(
             top = tmp2;
         } else if (!use_ddc &&
                    !have_cheri_tb_flags(ctx, TB_FLAG_CHERI_PCC_TOP_MAX)) {
-            tcg_gen_movi_tl(tmp2, (target_ulong)ctx->base.pcc_top);
+            generate_get_pcc_top_lo(ctx, tmp2);
             top = tmp2;
         }
 
@@ -497,8 +498,11 @@ static inline void gen_check_pcc_bounds_next_inst(DisasContext *ctx,
     // permitted to avoid any differences with non-CHERI enabled CPUs.
     tcg_debug_assert(ctx->base.pc_next >= ctx->base.pc_first);
     if (unlikely(ctx->base.pc_next + num_bytes > ctx->base.pcc_top)) {
+        ctx->base.pcc_bounds_exact = true;
         cheri_tcg_prepare_for_unconditional_exception(&ctx->base);
         gen_raise_pcc_violation(&ctx->base, ctx->base.pc_next, num_bytes);
+    } else {
+        disas_pcc_assume_in_bounds(&ctx->base, ctx->base.pc_next, num_bytes);
     }
 #endif
 }
@@ -542,16 +546,18 @@ static inline void gen_check_branch_target_dynamic(DisasContext *ctx, TCGv addr)
 
     TCGLabel *skip_btarget_check = gen_new_label();
     TCGLabel *bounds_violation = gen_new_label();
+    TCGv bound = tcg_temp_new();
     // We can skip the check of pcc.base if it is zero (common case in
     // hybrid/non-CHERI  mode).
     if (!have_cheri_tb_flags(ctx, TB_FLAG_CHERI_PCC_BASE_ZERO)) {
-        tcg_gen_brcondi_tl(TCG_COND_LTU, addr, ctx->base.pcc_base,
-                           bounds_violation);
+        generate_get_pcc_base(ctx, bound);
+        tcg_gen_brcond_tl(TCG_COND_LTU, addr, bound, bounds_violation);
     }
     if (!have_cheri_tb_flags(ctx, TB_FLAG_CHERI_PCC_TOP_MAX)) {
-        tcg_gen_brcondi_tl(TCG_COND_GEU, addr, ctx->base.pcc_top,
-                           bounds_violation);
+        generate_get_pcc_top_lo(ctx, bound);
+        tcg_gen_brcond_tl(TCG_COND_GEU, addr, bound, bounds_violation);
     }
+    tcg_temp_free(bound);
     tcg_gen_br(skip_btarget_check); // No violation -> return
     // One of the branches taken -> raise a bounds violation exception
     gen_set_label(bounds_violation); // skip helper call
@@ -750,6 +756,17 @@ static inline void disas_capreg_state_remove(DisasContext *ctx, int reg,
 #endif
 }
 
+// dest gets whatever state src is known to be in
+static inline void disas_capreg_state_copy(DisasContext *ctx, int dest, int src)
+{
+#ifdef ENABLE_STATIC_CAP_OPTS
+    if (lazy_capreg_number_is_special(dest))
+        return;
+    ctx->base.cap_compression_states[dest] =
+        ctx->base.cap_compression_states[src];
+#endif
+}
+
 // Decompress only if not fully decompressed
 static inline void gen_conditional_cap_decompress(DisasContext *ctx, int regnum)
 {
@@ -822,6 +839,22 @@ static inline void gen_cap_get_cursor(DisasContext *ctx, int regnum,
     cheri_tcg_printf_verbose("cd", "Get reg %d cursor: %lx\n", regnum, cursor);
 }
 
+static inline void gen_cap_set_cursor_unsafe(DisasContext *ctx, int regnum,
+                                             TCGv new_cursor)
+{
+    if (regnum == NULL_CAPREG_INDEX)
+        return;
+    if (MERGED_FILE && !lazy_capreg_number_is_special(regnum)) {
+#if MERGED_FILE
+        target_set_gpr(ctx, regnum, new_cursor);
+#endif
+    } else {
+        tcg_gen_st_tl(new_cursor, cpu_env,
+                      gp_register_offset(regnum) +
+                          offsetof(cap_register_t, _cr_cursor));
+    }
+}
+
 static inline void gen_reg_modified_cap_base(DisasContext *ctx,
                                              const char *str_name,
                                              size_t env_offset, uint32_t regnum,
@@ -1028,14 +1061,62 @@ static inline void gen_move_cap_sp_gp(DisasContext *ctx, uint32_t dest_off,
     gen_move_cap(dest_off, gp_register_offset(source_num));
 }
 
-// TODO Its probably only worth doing the whole move if decompressed. If
-// compressed just copy pesbt. Move a GP register to a GP register. Currently
-// decompresses before move.
+// Move a GP register to a GP register. If the source is statically known to be
+// an integer or still compressed only the cursor, pesbt and state are copied
+// and the destination stays lazy, otherwise the source is decompressed and
+// copied as a whole. Special registers (e.g. the scratch register) have no
+// lazy state, so moves involving them always take the latter path.
 static inline void gen_move_cap_gp_gp(DisasContext *ctx, int dest_num,
                                       int source_num)
 {
     if (dest_num == NULL_CAPREG_INDEX)
         return;
+    bool lazy = !lazy_capreg_number_is_special(dest_num) &&
+                !lazy_capreg_number_is_special(source_num);
+    if (lazy && disas_capreg_state_must_be(ctx, source_num, CREG_INTEGER)) {
+        if (dest_num != source_num) {
+            TCGv cursor = tcg_temp_new();
+            gen_cap_get_cursor(ctx, source_num, cursor);
+            gen_cap_set_cursor_unsafe(ctx, dest_num, cursor);
+            tcg_temp_free(cursor);
+            gen_lazy_cap_set_int_cond(ctx, dest_num, false);
+        }
+        return;
+    }
+    if (lazy && disas_capreg_state_must_be2(ctx, source_num, CREG_UNTAGGED_CAP,
+                                            CREG_TAGGED_CAP)) {
+        if (dest_num != source_num) {
+            cheri_tcg_printf_verbose("cc", "Compressed move to %d from %d\n",
+                                     dest_num, source_num);
+            TCGv temp = tcg_temp_new();
+            tcg_gen_ld_tl(temp, cpu_env,
+                          gp_register_offset(source_num) +
+                              offsetof(cap_register_t, cr_pesbt));
+            tcg_gen_st_tl(temp, cpu_env,
+                          gp_register_offset(dest_num) +
+                              offsetof(cap_register_t, cr_pesbt));
+            gen_cap_get_cursor(ctx, source_num, temp);
+            gen_cap_set_cursor_unsafe(ctx, dest_num, temp);
+            if (disas_capreg_state_must_be(ctx, source_num, CREG_TAGGED_CAP)) {
+                gen_lazy_cap_set_state(ctx, dest_num, CREG_TAGGED_CAP);
+            } else if (disas_capreg_state_must_be(ctx, source_num,
+                                                  CREG_UNTAGGED_CAP)) {
+                gen_lazy_cap_set_state(ctx, dest_num, CREG_UNTAGGED_CAP);
+            } else {
+                TCGv_i32 state = tcg_temp_new_i32();
+                gen_lazy_cap_get_state_i32(ctx, source_num, state);
+                tcg_gen_st8_i32(state, cpu_env,
+                                offsetof(CPUArchState,
+                                         CHERI_GPCAPREGS_MEMBER
+                                             .decompressed[dest_num]
+                                             .cap.cr_extra));
+                tcg_temp_free_i32(state);
+                disas_capreg_state_copy(ctx, dest_num, source_num);
+            }
+            tcg_temp_free(temp);
+        }
+        return;
+    }
     gen_ensure_cap_decompressed(ctx, source_num);
     if (dest_num == source_num)
         return;
@@ -1455,22 +1536,6 @@ static inline void gen_cap_addr_below_top(DisasContext *ctx, int regnum,
 }
 #endif /* CHERI_CAP_BITS == 128 */
 
-static inline void gen_cap_set_cursor_unsafe(DisasContext *ctx, int regnum,
-                                             TCGv new_cursor)
-{
-    if (regnum == NULL_CAPREG_INDEX)
-        return;
-    if (MERGED_FILE && !lazy_capreg_number_is_special(regnum)) {
-#if MERGED_FILE
-        target_set_gpr(ctx, regnum, new_cursor);
-#endif
-    } else {
-        tcg_gen_st_tl(new_cursor, cpu_env,
-                      gp_register_offset(regnum) +
-                          offsetof(cap_register_t, _cr_cursor));
-    }
-}
-
 // Gets the address part of the capability cursor (on morello this is different
 // from the cursor)
 static inline void gen_cap_get_cursor_addr(DisasContext *ctx, TCGv cursor_addr,
@@ -2191,55 +2256,201 @@ static inline void gen_cap_set_pesbt(DisasContext *ctx, int regnum, TCGv pesbt)
 
 #endif /* TARGET_CHERI_RISCV_STD */
 
+#if (defined(INLINE_CAP_MEMOP_CHECKS) || defined(DO_TCG_BOUNDS_CHECKS)) &&   \
+    defined(CHERI_PERMS_ARE_PESBT_BITS)
+// Sets result to 1 if the cached state of capreg allows an access of num_bytes
+// at addr: it must be fully decompressed (so that tag/base/top are valid),
+// tagged, unsealed, have the required permissions and addr must be in bounds.
+// Anything else (including all exception cases) results in 0 and should be
+// handled by the out-of-line helpers. Does not generate any branches.
+static inline void gen_cap_memop_fast_path_ok(DisasContext *ctx, int regnum,
+                                              TCGv addr, uint32_t num_bytes,
+                                              uint32_t required_perms,
+                                              TCGv result)
+{
+    size_t offset = gp_register_offset(regnum);
+    TCGv tmp = tcg_temp_new();
+    TCGv tmp2 = tcg_temp_new();
+
+    // Fully decompressed (no need to check if known at translation time) and
+    // tagged
+    if (disas_capreg_state_must_be(ctx, regnum, CREG_FULLY_DECOMPRESSED)) {
+        tcg_gen_ld8u_tl(result, cpu_env,
+                        offset + offsetof(cap_register_t, cr_tag));
+    } else {
+        tcg_gen_ld8u_tl(result, cpu_env,
+                        offset + offsetof(cap_register_t, cr_extra));
+        tcg_gen_setcondi_tl(TCG_COND_EQ, result, result,
+                            CREG_FULLY_DECOMPRESSED);
+        tcg_gen_ld8u_tl(tmp, cpu_env,
+                        offset + offsetof(cap_register_t, cr_tag));
+        tcg_gen_and_tl(result, result, tmp);
+    }
+
+    // Unsealed and has the required permissions
+    target_ulong perms_bits = cap_encode_perms(required_perms);
+    target_ulong otype_mask = (target_ulong)CAP_CC(FIELD_OTYPE_MASK64);
+    target_ulong unsealed_bits =
+        ((target_ulong)CAP_OTYPE_UNSEALED << CAP_CC(FIELD_OTYPE_START)) &
+        otype_mask;
+    gen_cap_load_pesbt(ctx, regnum, tmp);
+    tcg_gen_andi_tl(tmp, tmp, perms_bits | otype_mask);
+    tcg_gen_setcondi_tl(TCG_COND_EQ, tmp, tmp, perms_bits | unsealed_bits);
+    tcg_gen_and_tl(result, result, tmp);
+
+    // base <= addr
+    tcg_gen_ld_tl(tmp, cpu_env, offset + offsetof(cap_register_t, cr_base));
+    tcg_gen_setcond_tl(TCG_COND_GEU, tmp, addr, tmp);
+    tcg_gen_and_tl(result, result, tmp);
+
+    // addr + num_bytes <= top
+#if CHERI_CAP_BITS == 128
+    // Accesses that wrap around the end of the address space (even if they
+    // end exactly at a top of 1 << 64) are left to the helper.
+    tcg_gen_addi_tl(tmp, addr, num_bytes);
+    tcg_gen_setcond_tl(TCG_COND_GEU, tmp2, tmp, addr);
+    tcg_gen_and_tl(result, result, tmp2);
+    tcg_gen_ld_tl(tmp2, cpu_env,
+                  offset + offsetof(cap_register_t, _cr_top) +
+                      CAP_TOP_LOBYTES_OFFSET);
+    tcg_gen_setcond_tl(TCG_COND_LEU, tmp, tmp, tmp2);
+    tcg_gen_ld_tl(tmp2, cpu_env,
+                  offset + offsetof(cap_register_t, _cr_top) +
+                      CAP_TOP_HIBYTES_OFFSET);
+    tcg_gen_or_tl(tmp, tmp, tmp2);
+    tcg_gen_and_tl(result, result, tmp);
+#else
+    TCGv_i64 end = tcg_temp_new_i64();
+    TCGv_i64 top = tcg_temp_new_i64();
+    tcg_gen_extu_tl_i64(end, addr);
+    tcg_gen_addi_i64(end, end, num_bytes);
+    tcg_gen_ld_i64(top, cpu_env, offset + offsetof(cap_register_t, _cr_top));
+    tcg_gen_setcond_i64(TCG_COND_LEU, end, end, top);
+    tcg_gen_trunc_i64_tl(tmp, end);
+    tcg_gen_and_tl(result, result, tmp);
+    tcg_temp_free_i64(end);
+    tcg_temp_free_i64(top);
+#endif
+#ifdef TARGET_AARCH64
+    // On Morello all invalid exponent caps are always out of bounds.
+    gen_cap_load_bounds_valid(ctx, regnum, tmp);
+    tcg_gen_and_tl(result, result, tmp);
+#endif
+
+    tcg_temp_free(tmp);
+    tcg_temp_free(tmp2);
+    cheri_tcg_printf_verbose("cd", "Reg %d memop fast path: %d\n", regnum,
+                             result);
+}
+#endif
+
 // Checks a cap is in bounds for a given size, has specified perms, is tagged,
-// and not sealed. Or throws an exception. Because of the branch, this will kill
-// every temp. Addr is specially conserved as it will probably be used again.
+// and not sealed. Or throws an exception. With TCG bounds checks this
+// generates a branch, killing every temp. Addr is specially conserved as it
+// will probably be used again.
 static inline void gen_cap_memop_checks(DisasContext *ctx, int regnum,
                                         TCGv addr, target_ulong size, int perms)
 {
-#ifdef DO_TCG_BOUNDS_CHECKS
-    // We use addr as a tmp, and tmp as address because we can ensure tmp is
-    // local
-    TCGv local_addr = tcg_temp_local_new();
-    TCGv result = tcg_temp_new_i64();
-    tcg_gen_mov_tl(local_addr, addr);
-    TCGv tmp2 = addr;
-
-    // Bounds
-    gen_cap_in_bounds(ctx, regnum, local_addr, result, size);
-    // Perms
-    gen_cap_has_perms(ctx, regnum, perms, tmp2);
-    tcg_gen_and_tl(result, result, tmp2);
-    // Unsealed
-    gen_cap_get_unsealed(ctx, regnum, tmp2);
-    tcg_gen_and_tl(result, result, tmp2);
-    // Tagged
-    gen_cap_get_tag(ctx, regnum, tmp2);
-    tcg_gen_and_tl(result, result, tmp2);
+    TCGv_i32 tcg_regnum = tcg_constant_i32(regnum);
+    TCGv_i32 tcg_size = tcg_constant_i32(size);
+    TCGv_i32 tcg_perms = tcg_constant_i32(perms);
+
+#if defined(DO_TCG_BOUNDS_CHECKS) && defined(CHERI_PERMS_ARE_PESBT_BITS)
+    // The fast path only handles registers whose decompressed form is already
+    // cached, so there is no need to decompress the register first: the helper
+    // will do so (and the next access will then take the fast path).
+    if (regnum != NULL_CAPREG_INDEX && regnum < NUM_LAZY_CAP_REGS &&
+        disas_capreg_state_could_be(ctx, regnum, CREG_FULLY_DECOMPRESSED)) {
+        TCGv local_addr = tcg_temp_local_new();
+        TCGv result = tcg_temp_new();
+        TCGLabel *skip = gen_new_label();
 
-    /* If failure: */
-    TCGLabel *skip = gen_new_label();
-    tcg_gen_movi_tl(tmp2, 0);
-    tcg_gen_brcond_tl(TCG_COND_NE, result, tmp2, skip);
-    tcg_gen_mov_tl(addr, local_addr);
+        tcg_gen_mov_tl(local_addr, addr);
+        gen_cap_memop_fast_path_ok(ctx, regnum, local_addr, size, perms,
+                                   result);
+        tcg_gen_brcondi_tl(TCG_COND_NE, result, 0, skip);
+        // We just repeat the checks again in the helper to get the
+        // appropriate exception.
+        gen_helper_cap_check_addr((TCGv_cap_checked_ptr)result, cpu_env,
+                                  tcg_regnum, local_addr, tcg_size, tcg_perms);
+        gen_set_label(skip);
+        tcg_gen_mov_tl(addr, local_addr);
+        tcg_temp_free(result);
+        tcg_temp_free(local_addr);
+    } else
 #endif
-    // We just repeat the checks again in the helper to get the appropriate
-    // exception.
-    TCGv_i32 tcg_regnum = tcg_const_i32(regnum);
-    TCGv_i32 tcg_size = tcg_const_i32(size);
-    TCGv_i32 tcg_perms = tcg_const_i32(perms);
-    gen_helper_cap_check_addr((TCGv_cap_checked_ptr)addr, cpu_env, tcg_regnum,
-                              addr, tcg_size, tcg_perms);
-    tcg_temp_free_i32(tcg_regnum);
-    tcg_temp_free_i32(tcg_size);
-    tcg_temp_free_i32(tcg_perms);
-#ifdef DO_TCG_BOUNDS_CHECKS
-    /* Else */
-    gen_set_label(skip);
-    tcg_gen_mov_tl(addr, local_addr);
-    tcg_temp_free(local_addr);
-    tcg_temp_free(result);
+    {
+        gen_helper_cap_check_addr((TCGv_cap_checked_ptr)addr, cpu_env,
+                                  tcg_regnum, addr, tcg_size, tcg_perms);
+    }
+    // Either path leaves the register decompressed unless it traps.
+    if (regnum != NULL_CAPREG_INDEX) {
+        disas_capreg_state_set(ctx, regnum, CREG_FULLY_DECOMPRESSED);
+    }
+}
+
+typedef void (*gen_cap_check_helper_fn)(TCGv_cap_checked_ptr, TCGv_env,
+                                        TCGv_i32, TCGv, TCGv_i32);
+
+// Computes the address for a load/store of size memop_size(op) at
+// capreg.cursor + offset and checks it against capreg.
+// If supported by the target, the common case is checked inline and only
+// unusual states (compressed registers, faults) call the helper. In that case
+// a branch is generated so any non-local temps are clobbered.
+static inline void _generate_cap_checked_ptr(
+    TCGv_cap_checked_ptr resultaddr, DisasContext *ctx, uint32_t capreg,
+    TCGv offset, MemOp op, uint32_t required_perms,
+    gen_cap_check_helper_fn gen_check_helper)
+{
+    TCGv_i32 tcs = tcg_constant_i32(capreg);
+    TCGv_i32 tsize = tcg_constant_i32(memop_size(op));
+
+#if defined(INLINE_CAP_MEMOP_CHECKS) && defined(CHERI_PERMS_ARE_PESBT_BITS)
+    // Register zero is NULL (or DDC on MIPS), let the helper deal with it.
+    if (capreg != NULL_CAPREG_INDEX && capreg < NUM_LAZY_CAP_REGS) {
+        TCGv local_addr = tcg_temp_local_new();
+        TCGv tmp = tcg_temp_new();
+        TCGLabel *done = gen_new_label();
+
+        gen_cap_get_cursor(ctx, capreg, local_addr);
+        tcg_gen_add_tl(local_addr, local_addr, offset);
+        gen_cap_memop_fast_path_ok(ctx, capreg, local_addr, memop_size(op),
+                                   required_perms, tmp);
+        tcg_gen_brcondi_tl(TCG_COND_NE, tmp, 0, done);
+        // Slow path: the offset temp is dead here, so recompute it.
+        gen_cap_get_cursor(ctx, capreg, tmp);
+        tcg_gen_sub_tl(tmp, local_addr, tmp);
+        gen_check_helper((TCGv_cap_checked_ptr)local_addr, cpu_env, tcs, tmp,
+                         tsize);
+        gen_set_label(done);
+        tcg_gen_mov_tl((TCGv)resultaddr, local_addr);
+        tcg_temp_free(tmp);
+        tcg_temp_free(local_addr);
+        return;
+    }
 #endif
+    gen_check_helper(resultaddr, cpu_env, tcs, offset, tsize);
 }
 
+#define _gen_cap_check(type, perms)                                            \
+    static inline void generate_cap_##type##_check(                            \
+        TCGv_cap_checked_ptr resultaddr, DisasContext *ctx, uint32_t capreg,   \
+        TCGv offset, MemOp op)                                                 \
+    {                                                                          \
+        _generate_cap_checked_ptr(resultaddr, ctx, capreg, offset, op, perms,  \
+                                  &gen_helper_cap_##type##_check);             \
+    }                                                                          \
+    static inline void generate_cap_##type##_check_imm(                        \
+        TCGv_cap_checked_ptr resultaddr, DisasContext *ctx, uint32_t capreg,   \
+        target_long offset, MemOp op)                                          \
+    {                                                                          \
+        TCGv toffset = tcg_const_tl(offset);                                   \
+        generate_cap_##type##_check(resultaddr, ctx, capreg, toffset, op);     \
+        tcg_temp_free(toffset);                                                \
+    }
+
+_gen_cap_check(load, CAP_PERM_LOAD)
+_gen_cap_check(store, CAP_PERM_STORE)
+_gen_cap_check(rmw, CAP_PERM_LOAD | CAP_PERM_STORE)
+
 #endif // TARGET_CHERI
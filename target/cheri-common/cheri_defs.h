@@ -217,6 +217,11 @@ typedef enum CheriTbFlags {
     TB_FLAG_CHERI_PCC_FULL_AS =
         TB_FLAG_CHERI_PCC_BASE_ZERO | TB_FLAG_CHERI_PCC_TOP_MAX,
     TB_FLAG_CHERI_PCC_READABLE = (1 << 9),
+    /* All flags that only depend on PCC (and on state in the normal flags) */
+    TB_FLAG_CHERI_PCC_FLAGS = TB_FLAG_CHERI_PCC_EXECUTABLE |
+                              TB_FLAG_CHERI_CAPMODE |
+                              TB_FLAG_CHERI_PCC_FULL_AS |
+                              TB_FLAG_CHERI_PCC_READABLE,
 
     /* Useful for CHERI-specific flags on various platforms if the normal flags
        overflowed */
@@ -0,0 +1,198 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Live reporting of the CHERI statcounters and out-of-bounds histograms
+ * through QMP/HMP and as a periodic JSON lines time series.
+ *
+ * The counters are only ever written by their vCPU thread, so reading them
+ * from the monitor does not need to stop the VM; a running vCPU may just
+ * report a value that is a few increments out of date.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/error-report.h"
+#include "qemu/notify.h"
+#include "qemu/timer.h"
+#include "qapi/error.h"
+#include "qapi/qapi-commands-machine-target.h"
+#include "qapi/qapi-visit-machine-target.h"
+#include "qapi/qobject-output-visitor.h"
+#include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qjson.h"
+#include "hw/core/cpu.h"
+#include "monitor/monitor.h"
+#include "monitor/hmp-target.h"
+#include "sysemu/sysemu.h"
+#include "cpu.h"
+#include "cheri-bounds-stats.h"
+
+static struct {
+    FILE *out;
+    QEMUTimer *timer;
+    Notifier init_done;
+} cheri_stats_log;
+
+CheriStats *qmp_query_cheri_stats(Error **errp)
+{
+    CheriStats *stats = g_new0(CheriStats, 1);
+    CheriCpuStatsList **cpu_tail = &stats->cpus;
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        CPUArchState *env = cpu->env_ptr;
+        CheriCpuStats *value = g_new0(CheriCpuStats, 1);
+
+        value->cpu_index = cpu->cpu_index;
+        value->cap_read = env->statcounters_cap_read;
+        value->cap_read_tagged = env->statcounters_cap_read_tagged;
+        value->cap_write = env->statcounters_cap_write;
+        value->cap_write_tagged = env->statcounters_cap_write_tagged;
+        value->imprecise_setbounds = env->statcounters_imprecise_setbounds;
+        value->unrepresentable_caps = env->statcounters_unrepresentable_caps;
+        QAPI_LIST_APPEND(cpu_tail, value);
+    }
+
+#ifdef DO_CHERI_STATISTICS
+    uint64List **bucket_tail = &stats->bounds_buckets;
+    CheriBoundsStatsList **bounds_tail = &stats->bounds;
+
+    stats->has_bounds_buckets = true;
+    for (int i = 0; i < ARRAY_SIZE(bounds_buckets); i++) {
+        QAPI_LIST_APPEND(bucket_tail, bounds_buckets[i].howmuch);
+    }
+
+    stats->has_bounds = true;
+    for (size_t i = 0; i < cheri_oob_stats_count; i++) {
+        const struct oob_stats_info *info = cheri_oob_stats[i];
+        CheriBoundsStats *value = g_new0(CheriBoundsStats, 1);
+        uint64List **after_tail = &value->after_bounds;
+        uint64List **before_tail = &value->before_bounds;
+
+        value->operation = g_strdup(info->operation);
+        value->uses = info->num_uses;
+        value->unrepresentable = info->unrepresentable;
+        for (int j = 0; j < ARRAY_SIZE(info->after_bounds); j++) {
+            QAPI_LIST_APPEND(after_tail, info->after_bounds[j]);
+            QAPI_LIST_APPEND(before_tail, info->before_bounds[j]);
+        }
+        QAPI_LIST_APPEND(bounds_tail, value);
+    }
+#endif
+    return stats;
+}
+
+void hmp_info_cheri_stats(Monitor *mon, const QDict *qdict)
+{
+    CheriStats *stats = qmp_query_cheri_stats(NULL);
+    CheriCpuStatsList *cpu;
+    CheriBoundsStatsList *bounds;
+
+    monitor_printf(mon, "%-4s %14s %14s %14s %14s %14s %14s\n", "CPU",
+                   "cap read", "read tagged", "cap write", "write tagged",
+                   "imprecise", "unrepr");
+    for (cpu = stats->cpus; cpu; cpu = cpu->next) {
+        monitor_printf(mon,
+                       "%-4" PRId64 " %14" PRIu64 " %14" PRIu64 " %14" PRIu64
+                       " %14" PRIu64 " %14" PRIu64 " %14" PRIu64 "\n",
+                       cpu->value->cpu_index, cpu->value->cap_read,
+                       cpu->value->cap_read_tagged, cpu->value->cap_write,
+                       cpu->value->cap_write_tagged,
+                       cpu->value->imprecise_setbounds,
+                       cpu->value->unrepresentable_caps);
+    }
+
+    for (bounds = stats->bounds; bounds; bounds = bounds->next) {
+        uint64_t after = 0, before = 0;
+        uint64List *l;
+
+        /* One past the end (the first bucket) is valid in C */
+        for (l = bounds->value->after_bounds->next; l; l = l->next) {
+            after += l->value;
+        }
+        for (l = bounds->value->before_bounds; l; l = l->next) {
+            before += l->value;
+        }
+        monitor_printf(mon,
+                       "%-18s uses %" PRIu64 " after bounds %" PRIu64
+                       " before bounds %" PRIu64 " unrepresentable %" PRIu64
+                       "\n",
+                       bounds->value->operation, bounds->value->uses, after,
+                       before, bounds->value->unrepresentable);
+    }
+    qapi_free_CheriStats(stats);
+}
+
+static void cheri_stats_log_tick(void *opaque)
+{
+    CheriStats *stats = qmp_query_cheri_stats(NULL);
+    QDict *entry = qdict_new();
+    QObject *obj;
+    Visitor *v;
+    GString *json;
+
+    v = qobject_output_visitor_new(&obj);
+    visit_type_CheriStats(v, NULL, &stats, &error_abort);
+    visit_complete(v, &obj);
+    visit_free(v);
+    qapi_free_CheriStats(stats);
+
+    qdict_put_int(entry, "timestamp-ms",
+                  qemu_clock_get_ms(QEMU_CLOCK_REALTIME));
+    qdict_put_obj(entry, "stats", obj);
+    json = qobject_to_json(QOBJECT(entry));
+    fprintf(cheri_stats_log.out, "%s\n", json->str);
+    fflush(cheri_stats_log.out);
+    g_string_free(json, true);
+    qobject_unref(entry);
+
+    timer_mod(cheri_stats_log.timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME) +
+                                         cheri_stats_log_interval_ms);
+}
+
+static void cheri_stats_log_start(Notifier *notifier, void *data)
+{
+    if (!cheri_stats_log_path) {
+        return;
+    }
+    cheri_stats_log.out = fopen(cheri_stats_log_path, "w");
+    if (!cheri_stats_log.out) {
+        error_report("Could not open CHERI stats log '%s': %s",
+                     cheri_stats_log_path, strerror(errno));
+        exit(1);
+    }
+    cheri_stats_log.timer =
+        timer_new_ms(QEMU_CLOCK_REALTIME, cheri_stats_log_tick, NULL);
+    timer_mod(cheri_stats_log.timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME) +
+                                         cheri_stats_log_interval_ms);
+}
+
+static void cheri_stats_register(void)
+{
+    cheri_stats_log.init_done.notify = cheri_stats_log_start;
+    qemu_add_machine_init_done_notifier(&cheri_stats_log.init_done);
+}
+
+type_init(cheri_stats_register);
@@ -35,10 +35,26 @@
 #include "exec/exec-all.h"
 #include "exec/log.h"
 #include "exec/ramblock.h"
+#include "exec/ramlist.h"
+#include "hw/core/tcg-cpu-ops.h"
+#include "migration/qemu-file.h"
+#include "migration/migration.h"
+#include "migration/register.h"
+#include "qapi/error.h"
+#include "qapi/qapi-commands-machine-target.h"
+#include "qapi/qmp/qdict.h"
+#include "qemu/memfd.h"
+#include "qemu/mmap-alloc.h"
+#include "qemu/seqlock.h"
+#include "qemu/thread.h"
+#include "monitor/hmp.h"
+#include "monitor/hmp-target.h"
+#include "monitor/monitor.h"
 #include "cheri_defs.h"
 #include "cheri-helper-utils.h"
-// XXX: use hbitmap? Or a different data structure?
 #include "qemu/bitmap.h"
+#include "qemu/units.h"
+#include "tcg/tcg.h"
 #include "glib/ghash.h"
 
 #if defined(TARGET_MIPS)
@@ -59,9 +75,16 @@
  * capability-sized word in physical memory.  This allows capabilities
  * to be safely loaded and stored in meory without loss of integrity.
  *
- * For emulation purposes the tag is stored in a two-level array containing
- * fixed size bitmaps. To reduce the amount of memory needed the tag flag array
- * is allocated sparsely, 4K tags at at time, and on demand.
+ * For emulation purposes the tags for each RAMBlock are stored in a single
+ * contiguous bitmap that is reserved with mmap() and therefore only backed by
+ * host memory once it is written to (and can use transparent huge pages).
+ * The bitmap is logically split into blocks of 4K tags and a second-level
+ * "populated" bitmap records which of these blocks may contain a set tag.
+ * A block is populated the first time a tag is stored to it (this replaces
+ * the previous lazy g_malloc0() of each block) and the TLB only caches the
+ * real tag memory pointer for populated blocks (see cheri_tagmem_for_addr()).
+ * Range invalidations can therefore skip unpopulated blocks in one step and
+ * clear populated ones a word at a time.
  * This 4K number is arbitary and depending on the workload other sizes may be
  * better.
  *
@@ -69,15 +92,20 @@
  * easy to set or unset a tag without the need of locking or atomics.
  * This requires eight times the memory.
  *
- * As tag accesses are not atomic with regard to data writes/reads spurious
- * invalid capabilities could be created in a threaded context.
- * Therefore, we don't use atomic bitwise RMW operations and the one byte per
- * tag variant actually performs slightly worse due to increased memory usage.
+ * Tag accesses on their own are not atomic with regard to data writes/reads,
+ * so with MTTCG every capability-sized granule is additionally covered by one
+ * of a fixed number of seqlocks (see cheri_tag_write_lock()). Capability
+ * stores update the tag and data with the granule write-locked and
+ * capability loads retry until they have read data and tag without a
+ * concurrent writer. In parallel TBs data stores also write their data and
+ * clear the tag with the granule write-locked (see cheri_tag_stores_locked()),
+ * so a racing capability load either sees the old capability or a cleared
+ * tag. Only stores to pages with a populated tag block need to do that, so
+ * blocks are populated in an exclusive context (see cheri_tagmem_for_addr())
+ * and every TLB then refilled.
  *
- * FIXME: find a solution to make tags safe (or just always disable multi-tcg)
- *
- * XXX Should consider adding a reference count per tag block so that
- * blocks can be deallocated when no longer used maybe.
+ * XXX: Blocks are never unpopulated again since the TLB may hold pointers
+ * into them. Doing so would require a global TLB flush.
  *
  * FIXME: rewrite using somethign more like the upcoming MTE changes (https://github.com/rth7680/qemu/commits/tgt-arm-mte-user)
  *
@@ -113,49 +141,70 @@ _Static_assert(CAP_TAG_GET_MANY_SHFT <= 3, "");
 #define CAP_TAG_GET_MANY_MASK ((1 << (1UL << CAP_TAG_GET_MANY_SHFT)) - 1UL)
 #define CAP_TAG_MANY_DATA_SIZE (CHERI_CAP_SIZE << CAP_TAG_GET_MANY_SHFT)
 
-static inline size_t num_tagblocks(RAMBlock* ram)
-{
-    uint64_t memory_size = memory_region_size(ram->mr);
-    size_t result = DIV_ROUND_UP(memory_size, CHERI_CAP_SIZE * CAP_TAGBLK_SIZE);
-    if (memory_size != result * CHERI_CAP_SIZE * CAP_TAGBLK_SIZE) {
-        warn_report_once(
-            "WARNING: memory region %s size %" PRIu64
-            " is not a multiple of tag block size %d\r",
-            memory_region_name(ram->mr),
-            memory_size,
-            CHERI_CAP_SIZE * CAP_TAGBLK_SIZE);
-    }
-    return result;
-}
-
 typedef struct CheriTagBlock {
     DECLARE_BITMAP(tag_bitmap, CAP_TAGBLK_SIZE);
 } CheriTagBlock;
 
+typedef struct CheriTagMem {
+    /* One bit per capability-sized granule, demand-zero host memory. */
+    CheriTagBlock *blocks;
+    size_t blocks_size; /* Size of the host mapping in bytes */
+    size_t nblocks;
+    /* One bit per tag block, set once the block may contain a set tag. */
+    unsigned long *populated;
+    /*
+     * Set if the tags are mapped from a file (see cheri_tag_init_file()) or
+     * from a memfd for shared RAM.
+     */
+    int fd;
+    bool file_backed;
+    bool shared;
+    /* Contents of each block as last sent during migration (or NULL). */
+    CheriTagBlock *migration_sent;
+    /*
+     * With -cheri-provenance: one entry per capability-sized granule in
+     * demand-zero memory, reserved the first time a tagged capability is
+     * stored to this RAMBlock (or NULL).
+     */
+    struct CheriProvenance *provenance;
+} CheriTagMem;
 
-static CheriTagBlock *cheri_tag_new_tagblk(RAMBlock *ram, uint64_t tagidx)
+/*
+ * Where the capability last stored to a granule came from. The entry is only
+ * meaningful while the tag is set, it is not cleared with the tag. It is
+ * ignored unless @epoch matches cheri_provenance_epoch.
+ */
+typedef struct CheriProvenance {
+    uint64_t pc;
+    uint32_t asid;
+    uint32_t epoch;
+} CheriProvenance;
+
+static void cheri_tags_register_migration(void);
+static void cheri_provenance_forget(RAMBlock *ram, ram_addr_t offset,
+                                    size_t n);
+
+static inline size_t num_tagblocks(RAMBlock *ram)
 {
-    CheriTagBlock *tagblk, *old;
+    return ram->cheri_tags->nblocks;
+}
 
-    tagblk = g_malloc0(sizeof(CheriTagBlock));
-    if (tagblk == NULL) {
-        error_report("Can't allocate tag block.");
-        exit(1);
-    }
+static inline QEMU_ALWAYS_INLINE bool tagblock_is_populated(CheriTagMem *tags,
+                                                            size_t blk)
+{
+    return test_bit(blk, tags->populated);
+}
 
-    CheriTagBlock **tagmem = (CheriTagBlock **)ram->cheri_tags;
+static CheriTagBlock *cheri_tag_new_tagblk(RAMBlock *ram, uint64_t tagidx)
+{
+    CheriTagMem *tags = ram->cheri_tags;
     size_t tagblock_index = (tagidx >> CAP_TAGBLK_SHFT);
-    /* Possible race here so use atomic compare and swap. */
+
     cheri_debug_assert(tagblock_index < num_tagblocks(ram) &&
                        "Tag index out of bounds");
-    old = qatomic_cmpxchg(&tagmem[tagblock_index], NULL, tagblk);
-    if (old != NULL) {
-        /* Lost the race, free. */
-        g_free(tagblk);
-        return old;
-    } else {
-        return tagblk;
-    }
+    /* Possible race here so use an atomic update. */
+    set_bit_atomic(tagblock_index, tags->populated);
+    return &tags->blocks[tagblock_index];
 }
 
 static inline QEMU_ALWAYS_INLINE CheriTagBlock *cheri_tag_block(size_t tag_index,
@@ -167,8 +216,10 @@ static inline QEMU_ALWAYS_INLINE CheriTagBlock *cheri_tag_block(size_t tag_index
         error_report("Call to access tag out of bounds");
         return NULL;
     }
-    CheriTagBlock **tagmem = (CheriTagBlock **)ram->cheri_tags;
-    return tagmem[tagbock_index];
+    CheriTagMem *tags = ram->cheri_tags;
+    return tagblock_is_populated(tags, tagbock_index)
+               ? &tags->blocks[tagbock_index]
+               : NULL;
 }
 
 static inline QEMU_ALWAYS_INLINE bool tagblock_get_tag_tagmem(void *tagmem,
@@ -241,26 +292,143 @@ static inline QEMU_ALWAYS_INLINE void tagblock_clear_tag(CheriTagBlock *block,
     tagblock_clear_tag_tagmem(block->tag_bitmap, block_index);
 }
 
-void cheri_tag_init(MemoryRegion *mr, uint64_t memory_size)
+static CheriTagMem *cheri_tagmem_new(MemoryRegion *mr, uint64_t memory_size)
 {
     assert(memory_region_is_ram(mr));
     assert(memory_region_size(mr) == memory_size &&
            "Incorrect tag mem size passed?");
     assert(mr->ram_block->cheri_tags == NULL && "Already initialized?");
 
-    size_t cheri_ntagblks = num_tagblocks(mr->ram_block);
-    mr->ram_block->cheri_tags =
-        g_malloc0(cheri_ntagblks * sizeof(CheriTagBlock *));
-    if (mr->ram_block->cheri_tags == NULL) {
+    size_t cheri_ntagblks =
+        DIV_ROUND_UP(memory_size, CHERI_CAP_SIZE * CAP_TAGBLK_SIZE);
+    if (memory_size != cheri_ntagblks * CHERI_CAP_SIZE * CAP_TAGBLK_SIZE) {
+        warn_report_once(
+            "WARNING: memory region %s size %" PRIu64
+            " is not a multiple of tag block size %d\r",
+            memory_region_name(mr), memory_size,
+            CHERI_CAP_SIZE * CAP_TAGBLK_SIZE);
+    }
+
+    CheriTagMem *tags = g_new0(CheriTagMem, 1);
+    tags->nblocks = cheri_ntagblks;
+    tags->blocks_size =
+        ROUND_UP(cheri_ntagblks * sizeof(CheriTagBlock), qemu_real_host_page_size);
+    tags->populated = bitmap_new(cheri_ntagblks);
+    tags->fd = -1;
+    return tags;
+}
+
+static void cheri_tagmem_attach(MemoryRegion *mr, CheriTagMem *tags)
+{
+    qemu_madvise(tags->blocks, tags->blocks_size, QEMU_MADV_HUGEPAGE);
+    mr->ram_block->cheri_tags = tags;
+    cheri_tags_register_migration();
+}
+
+void cheri_tag_init(MemoryRegion *mr, uint64_t memory_size)
+{
+    CheriTagMem *tags = cheri_tagmem_new(mr, memory_size);
+
+    /*
+     * RAM that is shared with another process (e.g. a vhost-user backend)
+     * gets its tags in a memfd so that they can be shared as well, see
+     * cheri_tag_get_fd().
+     */
+    if (qemu_ram_is_shared(mr->ram_block) && qemu_memfd_check(0)) {
+        tags->blocks = qemu_memfd_alloc("cheri-tags", tags->blocks_size, 0,
+                                        &tags->fd, NULL);
+        if (tags->blocks != NULL) {
+            tags->shared = true;
+            cheri_tagmem_attach(mr, tags);
+            return;
+        }
+        warn_report("Could not allocate shared CHERI tags for %s",
+                    memory_region_name(mr));
+    }
+    /*
+     * Reserve the whole tag array up front: untouched parts are never backed
+     * by host memory, so this costs no more than the per-block allocations.
+     */
+    uint64_t align = 0;
+    tags->blocks = qemu_anon_ram_alloc(tags->blocks_size, &align,
+                                       /*shared=*/false, /*noreserve=*/true);
+    if (tags->blocks == NULL) {
         error_report("%s: Can't allocated tag memory", __func__);
         exit(-1);
     }
-    if (qemu_tcg_mttcg_enabled()) {
-        warn_report("The CHERI tagged memory implementation is not thread-safe "
-                    "and therefore not compatible with MTTCG. Capability tags "
-                    "may mysteriously appear/disappear. Run with \"--accel "
-                    "tcg,thread=single\" to fix.");
+    cheri_tagmem_attach(mr, tags);
+}
+
+bool cheri_tag_init_file(MemoryRegion *mr, uint64_t memory_size,
+                         const char *path, bool shared, Error **errp)
+{
+    CheriTagMem *tags = cheri_tagmem_new(mr, memory_size);
+    struct stat st;
+
+    /*
+     * A private mapping of an existing file is only ever read, which allows
+     * sharing one pristine tag image between many read-only users.
+     */
+    tags->fd = shared ? qemu_create(path, O_RDWR, 0644, errp)
+                      : qemu_open(path, O_RDONLY, errp);
+    if (tags->fd < 0) {
+        goto fail;
+    }
+    if (fstat(tags->fd, &st) < 0) {
+        error_setg_errno(errp, errno, "can't stat CHERI tag file '%s'", path);
+        goto fail;
+    }
+    if (st.st_size < tags->blocks_size) {
+        if (!shared) {
+            error_setg(errp, "CHERI tag file '%s' is too small for %s "
+                       "(need %zu bytes)", path, memory_region_name(mr),
+                       tags->blocks_size);
+            goto fail;
+        }
+        if (ftruncate(tags->fd, tags->blocks_size) < 0) {
+            error_setg_errno(errp, errno, "can't resize CHERI tag file '%s'",
+                             path);
+            goto fail;
+        }
+    }
+    tags->blocks = qemu_ram_mmap(tags->fd, tags->blocks_size,
+                                 qemu_real_host_page_size,
+                                 shared ? QEMU_MAP_SHARED : 0, 0);
+    if (tags->blocks == MAP_FAILED) {
+        tags->blocks = NULL;
+        error_setg_errno(errp, errno, "can't map CHERI tag file '%s'", path);
+        goto fail;
+    }
+    tags->file_backed = true;
+    tags->shared = shared;
+
+    /* Rebuild the populated summary from the tags stored in the file. */
+    for (size_t blk = 0; blk < tags->nblocks; blk++) {
+        if (!bitmap_empty(tags->blocks[blk].tag_bitmap, CAP_TAGBLK_SIZE)) {
+            set_bit(blk, tags->populated);
+        }
+    }
+    cheri_tagmem_attach(mr, tags);
+    return true;
+
+fail:
+    if (tags->fd >= 0) {
+        close(tags->fd);
+    }
+    g_free(tags->populated);
+    g_free(tags);
+    return false;
+}
+
+int cheri_tag_get_fd(RAMBlock *ram, uint64_t *size)
+{
+    CheriTagMem *tags = ram->cheri_tags;
+
+    if (!tags || !tags->shared) {
+        return -1;
     }
+    *size = tags->blocks_size;
+    return tags->fd;
 }
 
 void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
@@ -290,8 +458,17 @@ void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
     CheriTagBlock *tagblk = cheri_tag_block(tag, ram);
 
     if (tag_write && !tagblk) {
-        cheri_tag_new_tagblk(ram, tag);
         CPUState *cpu = env_cpu(env);
+        /*
+         * Other vCPUs may be storing to this page without locking the tags.
+         * Leave the fake SC_TRAP below for cheri_tag_check_populated() to set
+         * the tag in an exclusive context instead, where the flush below
+         * reaches every TLB before any vCPU runs again.
+         */
+        if (cheri_tag_stores_locked(cpu)) {
+            goto unpopulated;
+        }
+        cheri_tag_new_tagblk(ram, tag);
         /*
          * A vaddr-based shootdown is insufficient as multiple mappings may
          * exist. Short of an inverted table, a complete shootdown is required.
@@ -311,6 +488,7 @@ void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
         return tagblk->tag_bitmap + BIT_WORD(tagblk_index);
     }
 
+unpopulated:
     if (!(*prot & PAGE_SC_CLEAR)) {
         // Add in a (fake) SC_TRAP to prompt a TLB refill if a tag is stored
         // to this location. See the comment around TLBENTRYCAP_INVALID_WRITE_*.
@@ -347,6 +525,26 @@ static inline void *get_tagmem_from_iotlb_entry(CPUArchState *env,
     }
 }
 
+/*
+ * Called after probe_cap_write(): if the tag block for @p vaddr could not be
+ * populated because data stores may run concurrently (see
+ * cheri_tagmem_for_addr()), restart the instruction in an exclusive context.
+ */
+static void cheri_tag_check_populated(CPUArchState *env, target_ulong vaddr,
+                                      int mmu_idx, uintptr_t pc)
+{
+    uintptr_t tagmem_flags;
+    void *tagmem = get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx,
+                                               /*write=*/true, &tagmem_flags);
+
+    if (tagmem == ALL_ZERO_TAGBLK &&
+        (tagmem_flags & TLBENTRYCAP_INVALID_WRITE_MASK) ==
+            TLBENTRYCAP_INVALID_WRITE_VALUE &&
+        cheri_tag_stores_locked(env_cpu(env))) {
+        cpu_loop_exit_atomic(env_cpu(env), pc);
+    }
+}
+
 typedef struct TagOffset {
     target_ulong value;
 } TagOffset;
@@ -368,6 +566,215 @@ tag_offset_to_addr(TagOffset offset)
     return offset.value * CHERI_CAP_SIZE;
 }
 
+/*
+ * Granule locks for MTTCG. The stripe is selected by the host address of the
+ * granule, which is the same for all vCPUs and mappings of a RAM location.
+ * Zero-initialised QemuSeqLock/QemuSpin are valid, so no init is needed.
+ */
+#define CHERI_TAG_LOCK_STRIPES 1024
+
+static struct {
+    QemuSeqLock seq;
+    QemuSpin lock;
+} QEMU_ALIGNED(64) cheri_tag_locks[CHERI_TAG_LOCK_STRIPES];
+
+static inline QEMU_ALWAYS_INLINE size_t cheri_tag_lock_index(const void *host)
+{
+    return ((uintptr_t)host / CHERI_CAP_SIZE) % CHERI_TAG_LOCK_STRIPES;
+}
+
+unsigned cheri_tag_read_begin(const void *host)
+{
+    if (!qemu_tcg_mttcg_enabled()) {
+        return 0;
+    }
+    return seqlock_read_begin(&cheri_tag_locks[cheri_tag_lock_index(host)].seq);
+}
+
+bool cheri_tag_read_retry(const void *host, unsigned start)
+{
+    if (!qemu_tcg_mttcg_enabled()) {
+        return false;
+    }
+    return seqlock_read_retry(
+        &cheri_tag_locks[cheri_tag_lock_index(host)].seq, start);
+}
+
+void cheri_tag_write_lock(const void *host)
+{
+    if (qemu_tcg_mttcg_enabled()) {
+        size_t i = cheri_tag_lock_index(host);
+        seqlock_write_lock(&cheri_tag_locks[i].seq, &cheri_tag_locks[i].lock);
+    }
+}
+
+void cheri_tag_write_unlock(const void *host)
+{
+    if (qemu_tcg_mttcg_enabled()) {
+        size_t i = cheri_tag_lock_index(host);
+        seqlock_write_unlock(&cheri_tag_locks[i].seq, &cheri_tag_locks[i].lock);
+    }
+}
+
+static inline void cheri_tag_stripe_lock(size_t i)
+{
+    seqlock_write_lock(&cheri_tag_locks[i].seq, &cheri_tag_locks[i].lock);
+}
+
+static inline void cheri_tag_stripe_unlock(size_t i)
+{
+    seqlock_write_unlock(&cheri_tag_locks[i].seq, &cheri_tag_locks[i].lock);
+}
+
+/*
+ * Call @p fn for the stripes of all granules in [host, host + len) in
+ * ascending order, which is the order in which they must be locked.
+ */
+static void cheri_tag_for_each_stripe(const void *host, size_t len,
+                                      void (*fn)(size_t))
+{
+    size_t first = cheri_tag_lock_index(host);
+    size_t n = MIN(DIV_ROUND_UP(len, CHERI_CAP_SIZE), CHERI_TAG_LOCK_STRIPES);
+    size_t wrapped = first + n > CHERI_TAG_LOCK_STRIPES
+                         ? first + n - CHERI_TAG_LOCK_STRIPES : 0;
+
+    for (size_t i = 0; i < wrapped; i++) {
+        fn(i);
+    }
+    for (size_t i = first; i < first + n - wrapped; i++) {
+        fn(i);
+    }
+}
+
+void cheri_tag_write_lock_range(const void *host, size_t len)
+{
+    if (qemu_tcg_mttcg_enabled()) {
+        cheri_tag_for_each_stripe(host, len, cheri_tag_stripe_lock);
+    }
+}
+
+void cheri_tag_write_unlock_range(const void *host, size_t len)
+{
+    if (qemu_tcg_mttcg_enabled()) {
+        cheri_tag_for_each_stripe(host, len, cheri_tag_stripe_unlock);
+    }
+}
+
+/*
+ * The granules of the data store in progress on this thread, locked by
+ * cheri_tag_store_begin(). A store is at most two granules.
+ */
+static __thread struct {
+    unsigned n;
+    struct {
+        target_ulong vaddr;
+        void *host;
+        void *tagmem;
+        size_t stripe;
+    } granule[2];
+} cheri_tag_store;
+
+void cheri_tag_store_begin(CPUArchState *env, target_ulong vaddr, MemOpIdx oi,
+                           uintptr_t pc)
+{
+    int mmu_idx = get_mmuidx(oi);
+    int32_t size = memop_size(get_memop(oi));
+    unsigned a_bits = get_alignment_bits(get_memop(oi));
+    target_ulong first = QEMU_ALIGN_DOWN(vaddr, CHERI_CAP_SIZE);
+    target_ulong last = QEMU_ALIGN_DOWN(vaddr + size - 1, CHERI_CAP_SIZE);
+    unsigned n = 0;
+
+    cheri_debug_assert(cheri_tag_store.n == 0);
+    /*
+     * Take all faults before locking anything, in the order of
+     * atomic_mmu_lookup(): alignment first, then the TLB.
+     */
+    if (vaddr & ((1 << a_bits) - 1)) {
+        CPUState *cpu = env_cpu(env);
+
+        CPU_GET_CLASS(cpu)->tcg_ops->do_unaligned_access(
+            cpu, vaddr, MMU_DATA_STORE, mmu_idx, pc);
+    }
+    if (vaddr & (size - 1)) {
+        /* The atomic itself would stop the world, so do it now. */
+        cpu_loop_exit_atomic(env_cpu(env), pc);
+    }
+    for (target_ulong addr = first; addr <= last; addr += CHERI_CAP_SIZE) {
+        target_ulong start = MAX(addr, vaddr);
+        target_ulong end = MIN(addr + CHERI_CAP_SIZE, vaddr + size);
+        void *host = probe_write(env, start, end - start, mmu_idx, pc);
+        uintptr_t tagmem_flags;
+
+        if (!host) {
+            /* I/O, there are no tags to protect. */
+            continue;
+        }
+        cheri_tag_store.granule[n].vaddr = start;
+        cheri_tag_store.granule[n].host = host;
+        cheri_tag_store.granule[n].tagmem = get_tagmem_from_iotlb_entry(
+            env, start, mmu_idx, true, &tagmem_flags);
+        cheri_tag_store.granule[n].stripe = cheri_tag_lock_index(host);
+        n++;
+    }
+    cheri_debug_assert(n <= ARRAY_SIZE(cheri_tag_store.granule));
+
+    if (n == 2) {
+        size_t a = cheri_tag_store.granule[0].stripe;
+        size_t b = cheri_tag_store.granule[1].stripe;
+        cheri_tag_stripe_lock(MIN(a, b));
+        if (a != b) {
+            cheri_tag_stripe_lock(MAX(a, b));
+        }
+    } else if (n == 1) {
+        cheri_tag_stripe_lock(cheri_tag_store.granule[0].stripe);
+    }
+    cheri_tag_store.n = n;
+}
+
+static void cheri_tag_store_unlock(void)
+{
+    unsigned n = cheri_tag_store.n;
+    size_t a = cheri_tag_store.granule[0].stripe;
+    size_t b = cheri_tag_store.granule[1].stripe;
+
+    cheri_tag_store.n = 0;
+    if (n == 2 && a != b) {
+        cheri_tag_stripe_unlock(b);
+    }
+    if (n) {
+        cheri_tag_stripe_unlock(a);
+    }
+}
+
+void cheri_tag_store_end(CPUArchState *env, bool stored)
+{
+    for (unsigned i = 0; stored && i < cheri_tag_store.n; i++) {
+        void *tagmem = cheri_tag_store.granule[i].tagmem;
+        target_ulong vaddr = cheri_tag_store.granule[i].vaddr;
+        target_ulong tag_offset = page_vaddr_to_tag_offset(vaddr);
+
+        /*
+         * Blocks are only populated in an exclusive context, so the block
+         * is still unpopulated and the tag clear.
+         */
+        if (tagmem == ALL_ZERO_TAGBLK) {
+            continue;
+        }
+        qemu_maybe_log_instr_extra(
+            env, "    Cap Tag Write [" TARGET_FMT_lx "/" RAM_ADDR_FMT
+            "] %d -> 0\n", vaddr,
+            qemu_ram_addr_from_host(cheri_tag_store.granule[i].host),
+            tagblock_get_tag_tagmem(tagmem, tag_offset));
+        tagblock_clear_tag_tagmem(tagmem, tag_offset);
+    }
+    cheri_tag_store_unlock();
+}
+
+void cheri_tag_store_abort(void)
+{
+    cheri_tag_store_unlock();
+}
+
 static void *cheri_tag_invalidate_one(CPUArchState *env, target_ulong vaddr,
                                       int32_t size, uintptr_t pc, int mmu_idx);
 
@@ -476,12 +883,41 @@ static void *cheri_tag_invalidate_one(CPUArchState *env, target_ulong vaddr,
             vaddr, qemu_ram_addr_from_host(host_addr), old_value);
     }
 
+    cheri_tag_write_lock(host_addr);
     tagblock_clear_tag_tagmem(tagmem, tag_offset);
+    cheri_tag_write_unlock(host_addr);
     return host_addr;
 }
 
 
 
+/* Slow path for cheri_tag_phys_invalidate() that logs every tag write. */
+static void cheri_tag_phys_invalidate_logged(CPUArchState *env, RAMBlock *ram,
+                                             ram_addr_t startaddr,
+                                             ram_addr_t endaddr,
+                                             const target_ulong *vaddr)
+{
+    for (ram_addr_t addr = startaddr; addr < endaddr; addr += CHERI_CAP_SIZE) {
+        uint64_t tag = addr / CHERI_CAP_SIZE;
+        CheriTagBlock *tagblk = cheri_tag_block(tag, ram);
+        if (tagblk != NULL) {
+            const size_t tagblk_index = CAP_TAGBLK_IDX(tag);
+            if (vaddr) {
+                target_ulong write_vaddr =
+                    QEMU_ALIGN_DOWN(*vaddr, CHERI_CAP_SIZE) + (addr - startaddr);
+                qemu_log_instr_extra(env, "    Cap Tag Write [" TARGET_FMT_lx
+                    "/" RAM_ADDR_FMT "] %d -> 0\n", write_vaddr, addr,
+                    tagblock_get_tag(tagblk, tagblk_index));
+            } else {
+                qemu_log_instr_extra(env, "    Cap Tag ramaddr Write ["
+                    RAM_ADDR_FMT "] %d -> 0\n", addr,
+                    tagblock_get_tag(tagblk, tagblk_index));
+            }
+            tagblock_clear_tag(tagblk, tagblk_index);
+        }
+    }
+}
+
 void cheri_tag_phys_invalidate_external(RAMBlock *ram,
                                ram_addr_t ram_offset, ram_addr_t len)
 {
@@ -503,25 +939,34 @@ void cheri_tag_phys_invalidate(CPUArchState *env, RAMBlock *ram,
     ram_addr_t endaddr = (uint64_t)(ram_offset + len);
     ram_addr_t startaddr = QEMU_ALIGN_DOWN(ram_offset, CHERI_CAP_SIZE);
 
-    for(ram_addr_t addr = startaddr; addr < endaddr; addr += CHERI_CAP_SIZE) {
-        uint64_t tag = addr / CHERI_CAP_SIZE;
-        CheriTagBlock *tagblk = cheri_tag_block(tag, ram);
-        if (tagblk != NULL) {
-            const size_t tagblk_index = CAP_TAGBLK_IDX(tag);
-            if (unlikely(env && vaddr && qemu_log_instr_enabled(env))) {
-                target_ulong write_vaddr =
-                    QEMU_ALIGN_DOWN(*vaddr, CHERI_CAP_SIZE) + (addr - startaddr);
-                qemu_log_instr_extra(env, "    Cap Tag Write [" TARGET_FMT_lx
-                    "/" RAM_ADDR_FMT "] %d -> 0\n", write_vaddr, addr,
-                    tagblock_get_tag(tagblk, tagblk_index));
-            } else if (unlikely(env && qemu_log_instr_enabled(env))) {
-                qemu_log_instr_extra(env, "    Cap Tag ramaddr Write ["
-                    RAM_ADDR_FMT "] %d -> 0\n", addr,
-                    tagblock_get_tag(tagblk, tagblk_index));
-            }
-            // changed |= tagblock_get_tag(tagblk, tagblk_index);
-            tagblock_clear_tag(tagblk, tagblk_index);
-        }
+    if (unlikely(env && qemu_log_instr_enabled(env))) {
+        cheri_tag_phys_invalidate_logged(env, ram, startaddr, endaddr, vaddr);
+        return;
+    }
+
+    CheriTagMem *tags = ram->cheri_tags;
+    size_t first_tag = startaddr / CHERI_CAP_SIZE;
+    size_t end_tag = DIV_ROUND_UP(endaddr, CHERI_CAP_SIZE);
+    if (unlikely(end_tag > tags->nblocks * CAP_TAGBLK_SIZE)) {
+        error_report("Call to access tag out of bounds");
+        end_tag = tags->nblocks * CAP_TAGBLK_SIZE;
+    }
+    if (first_tag >= end_tag) {
+        return;
+    }
+    /* Only visit the populated blocks that overlap the range. */
+    size_t end_blk = ((end_tag - 1) >> CAP_TAGBLK_SHFT) + 1;
+    for (size_t blk = find_next_bit(tags->populated, end_blk,
+                                    first_tag >> CAP_TAGBLK_SHFT);
+         blk < end_blk; blk = find_next_bit(tags->populated, end_blk, blk + 1)) {
+        size_t blk_start = MAX(first_tag, blk << CAP_TAGBLK_SHFT);
+        size_t blk_end = MIN(end_tag, (blk + 1) << CAP_TAGBLK_SHFT);
+        /*
+         * Partial words must be cleared atomically since other vCPUs may
+         * concurrently set tags outside the range.
+         */
+        bitmap_clear_atomic(tags->blocks[blk].tag_bitmap,
+                            CAP_TAGBLK_IDX(blk_start), blk_end - blk_start);
     }
 }
 
@@ -564,6 +1009,7 @@ void *cheri_tag_set(CPUArchState *env, target_ulong vaddr, int reg,
     if (unlikely(!host_addr)) {
         return NULL;
     }
+    cheri_tag_check_populated(env, vaddr, mmu_idx, pc);
 
     uintptr_t tagmem_flags;
     void *tagmem = get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx,
@@ -598,47 +1044,208 @@ void *cheri_tag_set(CPUArchState *env, target_ulong vaddr, int reg,
     return host_addr;
 }
 
-bool cheri_tag_get(CPUArchState *env, target_ulong vaddr, int reg,
-                   hwaddr *ret_paddr, int *prot, uintptr_t pc, int mmu_idx,
-                   void *host_addr)
+void cheri_tag_update_locked(CPUArchState *env, target_ulong vaddr,
+                             int mmu_idx, bool tag)
 {
-
-    if (host_addr == NULL) {
-        host_addr = probe_read(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
-    }
-    handle_paddr_return(read);
-
     uintptr_t tagmem_flags;
     void *tagmem = get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx,
-                                               /*write=*/false, &tagmem_flags);
+                                               /*write=*/true, &tagmem_flags);
+    target_ulong tag_offset = page_vaddr_to_tag_offset(vaddr);
 
-    if (prot) {
-        *prot = 0;
-        if (tagmem_flags & TLBENTRYCAP_FLAG_CLEAR) {
-            *prot |= PAGE_LC_CLEAR;
-        }
-        if (tagmem_flags & TLBENTRYCAP_FLAG_TRAP) {
-            *prot |= PAGE_LC_TRAP;
-        }
-        if (tagmem_flags & TLBENTRYCAP_FLAG_TRAP_ANY) {
-            *prot |= PAGE_LC_TRAP_ANY;
-        }
+    /* Clear + ALL_ZERO_TAGBLK means no tags can be stored here. */
+    if (tagmem == ALL_ZERO_TAGBLK) {
+        cheri_debug_assert(!tag || (tagmem_flags & TLBENTRYCAP_FLAG_CLEAR));
+        return;
     }
+    cheri_debug_assert(!(tagmem_flags & TLBENTRYCAP_FLAG_CLEAR) &&
+                       "Unimplemented");
 
-    /*
-     * Squash happens in the caller, so read the tagblk even if
-     * TLBENTRYCAP_FLAG_CLEAR
-     */
-    bool result =
-        (tagmem == ALL_ZERO_TAGBLK)
-            ? 0
-            : tagblock_get_tag_tagmem(tagmem, page_vaddr_to_tag_offset(vaddr));
-
-    // XXX: Not atomic w.r.t. writes to tag memory
     qemu_maybe_log_instr_extra(
-        env, "    Cap Tag Read [" TARGET_FMT_lx "/" RAM_ADDR_FMT "] -> %d\n",
-        vaddr, qemu_ram_addr_from_host(host_addr), result);
-    return result;
+        env, "    Cap Tag Write [" TARGET_FMT_lx "] %d -> %d\n", vaddr,
+        tagblock_get_tag_tagmem(tagmem, tag_offset), tag);
+    if (tag) {
+        tagblock_set_tag_tagmem(tagmem, tag_offset);
+    } else {
+        tagblock_clear_tag_tagmem(tagmem, tag_offset);
+    }
+}
+
+void *cheri_tag_set_locked(CPUArchState *env, target_ulong vaddr, int reg,
+                           bool tag, uintptr_t pc, int mmu_idx)
+{
+    void *host_addr;
+
+    /* Take all TLB and capability store faults before locking. */
+    if (tag) {
+        store_capcause_reg(env, reg);
+        host_addr = probe_cap_write(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
+        clear_capcause_reg(env);
+    } else {
+        host_addr = probe_write(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
+    }
+    if (unlikely(!host_addr)) {
+        return NULL;
+    }
+    if (tag) {
+        cheri_tag_check_populated(env, vaddr, mmu_idx, pc);
+    }
+    cheri_tag_write_lock(host_addr);
+    cheri_tag_update_locked(env, vaddr, mmu_idx, tag);
+    return host_addr;
+}
+
+void *cheri_tag_rmw_lock(CPUArchState *env, target_ulong vaddr, int reg,
+                         uintptr_t pc, int mmu_idx, bool load)
+{
+    store_capcause_reg(env, reg);
+    void *host_addr =
+        probe_cap_write(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
+    clear_capcause_reg(env);
+    if (unlikely(!host_addr)) {
+        return NULL;
+    }
+    cheri_tag_check_populated(env, vaddr, mmu_idx, pc);
+    if (load) {
+        /* The old value is returned as well, so also take any load fault. */
+        probe_read(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
+    }
+    cheri_tag_write_lock(host_addr);
+    return host_addr;
+}
+
+bool cheri_tag_get_locked(CPUArchState *env, target_ulong vaddr, int mmu_idx)
+{
+    uintptr_t tagmem_flags;
+    void *tagmem = get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx,
+                                               /*write=*/true, &tagmem_flags);
+
+    if (tagmem == ALL_ZERO_TAGBLK) {
+        return false;
+    }
+    return tagblock_get_tag_tagmem(tagmem, page_vaddr_to_tag_offset(vaddr));
+}
+
+bool cheri_tag_get(CPUArchState *env, target_ulong vaddr, int reg,
+                   hwaddr *ret_paddr, int *prot, uintptr_t pc, int mmu_idx,
+                   void *host_addr)
+{
+
+    if (host_addr == NULL) {
+        host_addr = probe_read(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
+    }
+    handle_paddr_return(read);
+
+    uintptr_t tagmem_flags;
+    void *tagmem = get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx,
+                                               /*write=*/false, &tagmem_flags);
+
+    if (prot) {
+        *prot = 0;
+        if (tagmem_flags & TLBENTRYCAP_FLAG_CLEAR) {
+            *prot |= PAGE_LC_CLEAR;
+        }
+        if (tagmem_flags & TLBENTRYCAP_FLAG_TRAP) {
+            *prot |= PAGE_LC_TRAP;
+        }
+        if (tagmem_flags & TLBENTRYCAP_FLAG_TRAP_ANY) {
+            *prot |= PAGE_LC_TRAP_ANY;
+        }
+    }
+
+    /*
+     * Squash happens in the caller, so read the tagblk even if
+     * TLBENTRYCAP_FLAG_CLEAR
+     */
+    bool result =
+        (tagmem == ALL_ZERO_TAGBLK)
+            ? 0
+            : tagblock_get_tag_tagmem(tagmem, page_vaddr_to_tag_offset(vaddr));
+
+    // XXX: Not atomic w.r.t. writes to tag memory
+    qemu_maybe_log_instr_extra(
+        env, "    Cap Tag Read [" TARGET_FMT_lx "/" RAM_ADDR_FMT "] -> %d\n",
+        vaddr, qemu_ram_addr_from_host(host_addr), result);
+    return result;
+}
+
+/*
+ * Look up @p vaddr directly in the softmmu TLB for @p mmu_idx. This only
+ * succeeds for a TLB hit on plain RAM (no TLB_* flags such as TLB_MMIO,
+ * TLB_NOTDIRTY or TLB_WATCHPOINT) without any TLBENTRYCAP flags. In that case
+ * the host address is returned and @p tagmem is set to the tag memory for the
+ * page (possibly ALL_ZERO_TAGBLK). Otherwise NULL is returned and the caller
+ * must use the probe_*() based slow path (which also handles TLB misses and
+ * faults).
+ */
+static inline QEMU_ALWAYS_INLINE void *
+cheri_tlb_lookup_fast(CPUArchState *env, target_ulong vaddr, int mmu_idx,
+                      bool is_write, void **tagmem)
+{
+    CPUTLBEntry *entry = tlb_entry(env, mmu_idx, vaddr);
+    target_ulong tlb_addr =
+        is_write ? tlb_addr_write(entry) : entry->addr_read;
+
+    if (unlikely(!tlb_hit(tlb_addr, vaddr) || (tlb_addr & TLB_FLAGS_MASK))) {
+        return NULL;
+    }
+    CPUIOTLBEntry *iotlbentry =
+        &env_tlb(env)->d[mmu_idx].iotlb[tlb_index(env, mmu_idx, vaddr)];
+    uintptr_t tagmem_bits =
+        is_write ? iotlbentry->tagmem_write : iotlbentry->tagmem_read;
+    if (unlikely(tagmem_bits & TLBENTRYCAP_MASK)) {
+        return NULL;
+    }
+    *tagmem = (void *)tagmem_bits;
+    return (void *)((uintptr_t)vaddr + entry->addend);
+}
+
+void *cheri_tag_get_fast(CPUArchState *env, target_ulong vaddr, int mmu_idx,
+                         bool *tag)
+{
+    void *tagmem;
+    /* Let the slow path deal with logging the tag access. */
+    if (unlikely(qemu_log_instr_enabled(env))) {
+        return NULL;
+    }
+    void *host_addr = cheri_tlb_lookup_fast(env, vaddr, mmu_idx,
+                                            /*is_write=*/false, &tagmem);
+    if (likely(host_addr)) {
+        *tag = (tagmem == ALL_ZERO_TAGBLK)
+                   ? false
+                   : tagblock_get_tag_tagmem(tagmem,
+                                             page_vaddr_to_tag_offset(vaddr));
+    }
+    return host_addr;
+}
+
+void *cheri_tag_set_fast(CPUArchState *env, target_ulong vaddr, int mmu_idx,
+                         bool tag)
+{
+    void *tagmem;
+    /* Let the slow path deal with logging the tag access. */
+    if (unlikely(qemu_log_instr_enabled(env))) {
+        return NULL;
+    }
+    void *host_addr = cheri_tlb_lookup_fast(env, vaddr, mmu_idx,
+                                            /*is_write=*/true, &tagmem);
+    if (unlikely(!host_addr)) {
+        return NULL;
+    }
+    if (tagmem == ALL_ZERO_TAGBLK) {
+        /*
+         * No tag block allocated yet: nothing to do for a tag clear, but
+         * setting a tag must allocate one in the slow path.
+         * Note: the TLB fill normally adds TLBENTRYCAP_FLAG_TRAP in this case,
+         * so we should not get here for tagged stores.
+         */
+        return tag ? NULL : host_addr;
+    }
+    if (tag) {
+        tagblock_set_tag_tagmem(tagmem, page_vaddr_to_tag_offset(vaddr));
+    } else {
+        tagblock_clear_tag_tagmem(tagmem, page_vaddr_to_tag_offset(vaddr));
+    }
+    return host_addr;
 }
 
 int cheri_tag_get_many(CPUArchState *env, target_ulong vaddr, int reg,
@@ -678,13 +1285,19 @@ void cheri_tag_set_many(CPUArchState *env, uint32_t tags, target_ulong vaddr,
      * We call probe_(cap)_write rather than probe_access since the branches
      * checking access_type can be eliminated.
      */
+    void *host_addr;
     if (tags) {
         // Note: this probe will handle any store cap faults
-        probe_cap_write(env, vaddr, CAP_TAG_MANY_DATA_SIZE, mmu_idx, pc);
+        host_addr =
+            probe_cap_write(env, vaddr, CAP_TAG_MANY_DATA_SIZE, mmu_idx, pc);
     } else {
-        probe_write(env, vaddr, CAP_TAG_MANY_DATA_SIZE, mmu_idx, pc);
+        host_addr =
+            probe_write(env, vaddr, CAP_TAG_MANY_DATA_SIZE, mmu_idx, pc);
     }
     clear_capcause_reg(env);
+    if (tags) {
+        cheri_tag_check_populated(env, vaddr, mmu_idx, pc);
+    }
 
     handle_paddr_return(write);
 
@@ -713,6 +1326,16 @@ void cheri_tag_set_many(CPUArchState *env, uint32_t tags, target_ulong vaddr,
     cheri_debug_assert(tagmem);
 
     tagblock_set_tag_many_tagmem(tagmem, page_vaddr_to_tag_offset(vaddr), tags);
+
+    /* The data under the new tags was not stored by a recorded store. */
+    if (unlikely(cheri_provenance_enabled) && tags && host_addr) {
+        ram_addr_t offset;
+        RAMBlock *ram = qemu_ram_block_from_host(host_addr, false, &offset);
+        if (ram && ram->cheri_tags) {
+            cheri_provenance_forget(ram, offset,
+                                    1 << CAP_TAG_GET_MANY_SHFT);
+        }
+    }
 }
 
 bool cheri_tag_get_debug(RAMBlock *ram, ram_addr_t ram_offset)
@@ -728,8 +1351,746 @@ bool cheri_tag_get_debug(RAMBlock *ram, ram_addr_t ram_offset)
                        ram_offset);
 
     uint64_t tag = ram_offset / CHERI_CAP_SIZE;
+    /* Unpopulated tag blocks read as all tags clear. */
     CheriTagBlock *tagblk = cheri_tag_block(tag, ram);
-    cheri_debug_assert(tagblk);
     const size_t tagblk_index = CAP_TAGBLK_IDX(tag);
     return tagblock_get_tag(tagblk, tagblk_index);
 }
+
+bool cheri_tag_set_debug(RAMBlock *ram, ram_addr_t ram_offset)
+{
+    if (!ram->cheri_tags) {
+        return false;
+    }
+    cheri_debug_assert(QEMU_ALIGN_DOWN(ram_offset, CHERI_CAP_SIZE) ==
+                       ram_offset);
+
+    uint64_t tag = ram_offset / CHERI_CAP_SIZE;
+    CheriTagBlock *tagblk = cheri_tag_block(tag, ram);
+    if (!tagblk) {
+        CPUState *cpu;
+
+        tagblk = cheri_tag_new_tagblk(ram, tag);
+        /* TLBs may still map this block to ALL_ZERO_TAGBLK. */
+        CPU_FOREACH(cpu) {
+            tlb_flush(cpu);
+        }
+    }
+    tagblock_set_tag_tagmem(tagblk->tag_bitmap, CAP_TAGBLK_IDX(tag));
+    cheri_provenance_forget(ram, ram_offset, 1);
+    return true;
+}
+
+/*
+ * Revocation sweeps: visit every tagged capability in a range of a RAMBlock
+ * and clear the tag of those whose base is marked in a revocation bitmap.
+ * Only populated tag blocks and non-zero tag words are visited, and the bounds
+ * of all tagged capabilities in a tag word are decoded in one batch.
+ */
+typedef struct CheriRevokeWorker {
+    QemuThread thread;
+    RAMBlock *ram;
+    const CheriRevokeRequest *req;
+    size_t first_tag;
+    size_t end_tag;
+    uint64_t scanned;
+    uint64_t revoked;
+} CheriRevokeWorker;
+
+static inline bool cheri_revoke_test(const CheriRevokeRequest *req,
+                                     uint64_t base)
+{
+    uint64_t bit = (base - req->bitmap_base) / CHERI_CAP_SIZE;
+    if (base < req->bitmap_base || bit >= req->bitmap_bits) {
+        return false;
+    }
+    return (req->bitmap[bit / 8] >> (bit % 8)) & 1;
+}
+
+#if TARGET_LONG_BITS == 32
+#define ld_cap_word_p ldl_p
+#else
+#define ld_cap_word_p ldq_p
+#endif
+
+static void cheri_revoke_word(CheriRevokeWorker *w, unsigned long *tagword,
+                              size_t first_tag, unsigned long mask)
+{
+    unsigned long bits = qatomic_read(tagword) & mask;
+    target_ulong pesbt[BITS_PER_LONG], cursor[BITS_PER_LONG];
+    target_ulong base[BITS_PER_LONG];
+    cap_length_t top[BITS_PER_LONG];
+    bool valid[BITS_PER_LONG];
+    uint8_t *host[BITS_PER_LONG];
+    size_t n = 0;
+
+    for (; bits; bits &= bits - 1) {
+        size_t tag = first_tag + ctzl(bits);
+        host[n] = (uint8_t *)w->ram->host + tag * CHERI_CAP_SIZE;
+        pesbt[n] = ld_cap_word_p(host[n] + CHERI_MEM_OFFSET_METADATA) ^
+                   CAP_MEM_XOR_MASK;
+        cursor[n] = ld_cap_word_p(host[n] + CHERI_MEM_OFFSET_CURSOR);
+        n++;
+    }
+    CAP_cc(decode_bounds_batch)(pesbt, cursor, n, base, top, valid);
+    w->scanned += n;
+
+    for (size_t i = 0; i < n; i++) {
+        if (!valid[i] || !cheri_revoke_test(w->req, base[i])) {
+            continue;
+        }
+        /*
+         * A vCPU may have replaced the capability since it was read above.
+         * Capability stores hold the granule lock, so re-check the data under
+         * it and only clear the tag if it still belongs to the capability we
+         * decoded.
+         */
+        size_t tag = (host[i] - (uint8_t *)w->ram->host) / CHERI_CAP_SIZE;
+        cheri_tag_write_lock(host[i]);
+        if ((ld_cap_word_p(host[i] + CHERI_MEM_OFFSET_METADATA) ^
+             CAP_MEM_XOR_MASK) == pesbt[i] &&
+            ld_cap_word_p(host[i] + CHERI_MEM_OFFSET_CURSOR) == cursor[i] &&
+            tagblock_get_tag_tagmem(tagword, tag - first_tag)) {
+            tagblock_clear_tag_tagmem(tagword, tag - first_tag);
+            w->revoked++;
+        }
+        cheri_tag_write_unlock(host[i]);
+    }
+}
+
+#undef ld_cap_word_p
+
+static void *cheri_revoke_worker(void *opaque)
+{
+    CheriRevokeWorker *w = opaque;
+    CheriTagMem *tags = w->ram->cheri_tags;
+    size_t end_blk = DIV_ROUND_UP(w->end_tag, CAP_TAGBLK_SIZE);
+
+    if (w->first_tag >= w->end_tag) {
+        return NULL;
+    }
+    for (size_t blk = find_next_bit(tags->populated, end_blk,
+                                    w->first_tag >> CAP_TAGBLK_SHFT);
+         blk < end_blk; blk = find_next_bit(tags->populated, end_blk, blk + 1)) {
+        size_t blk_tag = blk << CAP_TAGBLK_SHFT;
+        size_t start = MAX(w->first_tag, blk_tag) - blk_tag;
+        size_t end = MIN(w->end_tag, blk_tag + CAP_TAGBLK_SIZE) - blk_tag;
+        unsigned long *bitmap = tags->blocks[blk].tag_bitmap;
+
+        for (size_t word = BIT_WORD(start); word <= BIT_WORD(end - 1); word++) {
+            unsigned long mask = ~0UL;
+            if (word == BIT_WORD(start)) {
+                mask &= BITMAP_FIRST_WORD_MASK(start);
+            }
+            if (word == BIT_WORD(end - 1)) {
+                mask &= BITMAP_LAST_WORD_MASK(end);
+            }
+            if (qatomic_read(&bitmap[word]) & mask) {
+                cheri_revoke_word(w, &bitmap[word],
+                                  blk_tag + word * BITS_PER_LONG, mask);
+            }
+        }
+    }
+    return NULL;
+}
+
+void cheri_tag_revoke_sweep(RAMBlock *ram, ram_addr_t offset, ram_addr_t len,
+                            CheriRevokeRequest *req, unsigned nthreads)
+{
+    CheriTagMem *tags = ram->cheri_tags;
+
+    req->scanned = req->revoked = 0;
+    if (!tags || !len) {
+        return;
+    }
+    size_t first_tag = offset / CHERI_CAP_SIZE;
+    size_t end_tag = MIN(DIV_ROUND_UP(offset + len, CHERI_CAP_SIZE),
+                         tags->nblocks * CAP_TAGBLK_SIZE);
+    if (first_tag >= end_tag) {
+        return;
+    }
+    /*
+     * Split the range into one chunk of whole tag blocks per thread. Spawning
+     * threads is not worth it for sweeps that only touch a few blocks.
+     */
+    size_t nblocks = DIV_ROUND_UP(end_tag - first_tag, CAP_TAGBLK_SIZE);
+    nthreads = MAX(1, MIN(nthreads, nblocks / 16));
+    size_t chunk = DIV_ROUND_UP(nblocks, nthreads) * CAP_TAGBLK_SIZE;
+    g_autofree CheriRevokeWorker *workers = g_new0(CheriRevokeWorker,
+                                                   nthreads);
+
+    for (unsigned i = 0; i < nthreads; i++) {
+        CheriRevokeWorker *w = &workers[i];
+        w->ram = ram;
+        w->req = req;
+        w->first_tag = MIN(end_tag, first_tag + i * chunk);
+        w->end_tag = MIN(end_tag, w->first_tag + chunk);
+        if (i > 0) {
+            qemu_thread_create(&w->thread, "cheri-revoke", cheri_revoke_worker,
+                               w, QEMU_THREAD_JOINABLE);
+        }
+    }
+    cheri_revoke_worker(&workers[0]);
+    for (unsigned i = 0; i < nthreads; i++) {
+        if (i > 0) {
+            qemu_thread_join(&workers[i].thread);
+        }
+        req->scanned += workers[i].scanned;
+        req->revoked += workers[i].revoked;
+    }
+}
+
+/*
+ * Host memory actually backing the tags of @p tags in bytes: the resident
+ * pages of the demand-zero (or file) mapping plus the populated summary.
+ */
+static size_t cheri_tagmem_host_size(CheriTagMem *tags)
+{
+    size_t pagesize = qemu_real_host_page_size;
+    size_t npages = tags->blocks_size / pagesize;
+    size_t summary = BITS_TO_LONGS(tags->nblocks) * sizeof(unsigned long);
+    g_autofree unsigned char *vec = g_malloc(npages);
+    size_t resident = 0;
+
+    if (mincore(tags->blocks, tags->blocks_size, (void *)vec) < 0) {
+        /* Fall back to an upper bound: every populated block is resident. */
+        for (size_t blk = find_first_bit(tags->populated, tags->nblocks);
+             blk < tags->nblocks;
+             blk = find_next_bit(tags->populated, tags->nblocks, blk + 1)) {
+            resident += sizeof(CheriTagBlock);
+        }
+        return resident + summary;
+    }
+    for (size_t i = 0; i < npages; i++) {
+        if (vec[i] & 1) {
+            resident += pagesize;
+        }
+    }
+    return resident + summary;
+}
+
+void hmp_info_cheri_tags(Monitor *mon, const QDict *qdict)
+{
+    RAMBlock *block;
+
+    monitor_printf(mon, "%-24s %12s %12s %12s %14s\n", "RAMBlock", "blocks",
+                   "populated", "tags set", "tag mem (KiB)");
+    RCU_READ_LOCK_GUARD();
+    RAMBLOCK_FOREACH(block) {
+        CheriTagMem *tags = block->cheri_tags;
+        if (!tags) {
+            continue;
+        }
+        size_t populated = 0;
+        uint64_t tags_set = 0;
+        for (size_t blk = find_first_bit(tags->populated, tags->nblocks);
+             blk < tags->nblocks;
+             blk = find_next_bit(tags->populated, tags->nblocks, blk + 1)) {
+            populated++;
+            tags_set += bitmap_count_one(tags->blocks[blk].tag_bitmap,
+                                         CAP_TAGBLK_SIZE);
+        }
+        monitor_printf(mon, "%-24s %12zu %12zu %12" PRIu64 " %14zu\n",
+                       block->idstr, tags->nblocks, populated, tags_set,
+                       cheri_tagmem_host_size(tags) / KiB);
+    }
+}
+
+/*
+ * Capability provenance tracking (-cheri-provenance): records the PC and ASID
+ * of the instruction that stored each tagged capability in a side table
+ * parallel to the tag bitmap. Like the tag bitmap the table is a demand-zero
+ * reservation, so only the parts covering memory that actually holds
+ * capabilities use host memory, and nothing is allocated while disabled.
+ */
+
+bool cheri_provenance_enabled = false;
+
+/*
+ * Entries recorded before the last time tracking was re-enabled or tags were
+ * loaded from a migration stream may describe a capability that has since
+ * been replaced without being recorded. Bumping the epoch invalidates all of
+ * them at once. Zero-filled entries never match since the epoch is never 0.
+ */
+static uint32_t cheri_provenance_epoch = 1;
+
+static void cheri_provenance_invalidate_all(void)
+{
+    uint32_t epoch = qatomic_read(&cheri_provenance_epoch) + 1;
+    qatomic_set(&cheri_provenance_epoch, epoch ? epoch : 1);
+}
+
+/* Forgets the provenance of the @n granules starting at @offset. */
+static void cheri_provenance_forget(RAMBlock *ram, ram_addr_t offset, size_t n)
+{
+    CheriProvenance *table = qatomic_load_acquire(&ram->cheri_tags->provenance);
+
+    if (table) {
+        for (size_t i = 0; i < n; i++) {
+            table[offset / CHERI_CAP_SIZE + i].epoch = 0;
+        }
+    }
+}
+
+static CheriProvenance *cheri_provenance_table(CheriTagMem *tags)
+{
+    CheriProvenance *table = qatomic_load_acquire(&tags->provenance);
+    if (likely(table)) {
+        return table;
+    }
+    size_t size = ROUND_UP(tags->nblocks * CAP_TAGBLK_SIZE *
+                               sizeof(CheriProvenance),
+                           qemu_real_host_page_size);
+    uint64_t align = 0;
+    table = qemu_anon_ram_alloc(size, &align, /*shared=*/false,
+                                /*noreserve=*/true);
+    if (table == NULL) {
+        error_report("%s: Can't allocate capability provenance table",
+                     __func__);
+        exit(1);
+    }
+    /* Another vCPU may have raced us, use whichever table was installed. */
+    CheriProvenance *old = qatomic_cmpxchg(&tags->provenance, NULL, table);
+    if (old) {
+        qemu_anon_ram_free(table, size);
+        return old;
+    }
+    return table;
+}
+
+void cheri_provenance_record(void *host, target_ulong pc, unsigned asid)
+{
+    ram_addr_t offset;
+    RAMBlock *ram = qemu_ram_block_from_host(host, false, &offset);
+
+    if (!ram || !ram->cheri_tags) {
+        return;
+    }
+    CheriProvenance *entry =
+        &cheri_provenance_table(ram->cheri_tags)[offset / CHERI_CAP_SIZE];
+    entry->pc = pc;
+    entry->asid = asid;
+    entry->epoch = qatomic_read(&cheri_provenance_epoch);
+}
+
+static bool cheri_provenance_lookup(RAMBlock *ram, ram_addr_t offset,
+                                    bool *tagged, CheriProvenance *result)
+{
+    CheriTagMem *tags = ram->cheri_tags;
+    uint64_t tag = offset / CHERI_CAP_SIZE;
+    CheriTagBlock *tagblk = tags ? cheri_tag_block(tag, ram) : NULL;
+    CheriProvenance *table = tags ? qatomic_load_acquire(&tags->provenance)
+                                  : NULL;
+
+    *tagged = tagblk && tagblock_get_tag(tagblk, CAP_TAGBLK_IDX(tag));
+    if (!*tagged || !table ||
+        table[tag].epoch != qatomic_read(&cheri_provenance_epoch)) {
+        return false;
+    }
+    *result = table[tag];
+    return true;
+}
+
+CheriProvenanceInfo *qmp_query_cheri_provenance(uint64_t addr, Error **errp)
+{
+    MemoryRegionSection section =
+        memory_region_find(get_system_memory(), addr, 1);
+    CheriProvenanceInfo *info;
+    CheriProvenance prov;
+    bool tagged;
+
+    if (!section.mr || !memory_region_is_ram(section.mr) ||
+        !section.mr->ram_block) {
+        error_setg(errp, "Address 0x%" PRIx64 " is not in RAM", addr);
+        if (section.mr) {
+            memory_region_unref(section.mr);
+        }
+        return NULL;
+    }
+    RAMBlock *ram = section.mr->ram_block;
+    ram_addr_t offset = memory_region_get_ram_addr(section.mr) - ram->offset +
+                        section.offset_within_region;
+    info = g_new0(CheriProvenanceInfo, 1);
+    if (cheri_provenance_lookup(ram, QEMU_ALIGN_DOWN(offset, CHERI_CAP_SIZE),
+                                &tagged, &prov)) {
+        info->has_pc = info->has_asid = true;
+        info->pc = prov.pc;
+        info->asid = prov.asid;
+    }
+    info->tagged = tagged;
+    memory_region_unref(section.mr);
+    return info;
+}
+
+void qmp_cheri_provenance_dump(const char *filename, Error **errp)
+{
+    FILE *f = fopen(filename, "w");
+    RAMBlock *block;
+
+    if (!f) {
+        error_setg_errno(errp, errno, "Could not open '%s'", filename);
+        return;
+    }
+    fprintf(f, "# ramblock offset pc asid\n");
+    uint32_t epoch = qatomic_read(&cheri_provenance_epoch);
+    RCU_READ_LOCK_GUARD();
+    RAMBLOCK_FOREACH(block) {
+        CheriTagMem *tags = block->cheri_tags;
+        CheriProvenance *table =
+            tags ? qatomic_load_acquire(&tags->provenance) : NULL;
+        if (!table) {
+            continue;
+        }
+        for (size_t blk = find_first_bit(tags->populated, tags->nblocks);
+             blk < tags->nblocks;
+             blk = find_next_bit(tags->populated, tags->nblocks, blk + 1)) {
+            unsigned long *bitmap = tags->blocks[blk].tag_bitmap;
+            for (size_t i = find_first_bit(bitmap, CAP_TAGBLK_SIZE);
+                 i < CAP_TAGBLK_SIZE;
+                 i = find_next_bit(bitmap, CAP_TAGBLK_SIZE, i + 1)) {
+                size_t tag = blk * CAP_TAGBLK_SIZE + i;
+                if (table[tag].epoch == epoch) {
+                    fprintf(f, "%s 0x%zx 0x%" PRIx64 " %u\n", block->idstr,
+                            tag * CHERI_CAP_SIZE, table[tag].pc,
+                            table[tag].asid);
+                }
+            }
+        }
+    }
+    fclose(f);
+}
+
+void hmp_info_cheri_provenance(Monitor *mon, const QDict *qdict)
+{
+    uint64_t addr = qdict_get_int(qdict, "addr");
+    Error *err = NULL;
+    CheriProvenanceInfo *info = qmp_query_cheri_provenance(addr, &err);
+
+    if (hmp_handle_error(mon, err)) {
+        return;
+    }
+    if (!info->tagged) {
+        monitor_printf(mon, "0x%" PRIx64 ": untagged\n", addr);
+    } else if (!info->has_pc) {
+        monitor_printf(mon, "0x%" PRIx64 ": tagged, provenance unknown\n",
+                       addr);
+    } else {
+        monitor_printf(mon, "0x%" PRIx64 ": tagged, stored by pc=0x%" PRIx64
+                       " ASID=%" PRIu32 "\n", addr, info->pc, info->asid);
+    }
+    qapi_free_CheriProvenanceInfo(info);
+}
+
+void hmp_cheri_provenance(Monitor *mon, const QDict *qdict)
+{
+    bool enable = qdict_get_bool(qdict, "enable");
+
+    /* Tags set while tracking was off have no (or a stale) entry. */
+    if (enable && !cheri_provenance_enabled) {
+        cheri_provenance_invalidate_all();
+    }
+    cheri_provenance_enabled = enable;
+}
+
+void hmp_cheri_provenance_dump(Monitor *mon, const QDict *qdict)
+{
+    Error *err = NULL;
+
+    qmp_cheri_provenance_dump(qdict_get_str(qdict, "filename"), &err);
+    hmp_handle_error(mon, err);
+}
+
+/*
+ * Migration support: tags are sent for each populated tag block, identified by
+ * RAMBlock name and block index. To avoid resending unchanged blocks during
+ * iterative precopy, we keep a copy of the last sent contents of each block
+ * (in demand-zero memory, so only populated blocks use host memory) and only
+ * send blocks that differ from it. The setup stage tells the destination to
+ * clear the tags of each migrated RAMBlock, so the initial all-zero copy
+ * matches the destination state.
+ */
+#define CHERI_TAGS_FLAG_EOS      0x1
+#define CHERI_TAGS_FLAG_RAMBLOCK 0x2
+#define CHERI_TAGS_FLAG_BLOCK    0x4
+#define CHERI_TAGS_FLAG_CLEAR    0x8
+#define CHERI_TAGS_FLAG_MASK     0xf
+#define CHERI_TAGS_FLAG_SHIFT    4
+
+static struct {
+    bool registered;
+    /* Bytes of tag blocks found to be dirty but not sent in the last pass. */
+    uint64_t pending_bytes;
+} cheri_tags_migration;
+
+/*
+ * With x-ignore-shared, RAM mapped from a shared file is not migrated since the
+ * destination maps the same file. The same applies to tags in a shared file.
+ */
+static bool cheri_tags_ignored(CheriTagMem *tags)
+{
+    return tags->file_backed && tags->shared && migrate_ignore_shared();
+}
+
+static void cheri_tags_put_ramblock(QEMUFile *f, RAMBlock *block)
+{
+    size_t len = strlen(block->idstr);
+
+    qemu_put_be64(f, CHERI_TAGS_FLAG_RAMBLOCK);
+    qemu_put_byte(f, len);
+    qemu_put_buffer(f, (uint8_t *)block->idstr, len);
+}
+
+static void cheri_tags_free_sent(CheriTagMem *tags)
+{
+    if (tags->migration_sent) {
+        qemu_anon_ram_free(tags->migration_sent, tags->blocks_size);
+        tags->migration_sent = NULL;
+    }
+}
+
+static int cheri_tags_save_setup(QEMUFile *f, void *opaque)
+{
+    RAMBlock *block;
+
+    RCU_READ_LOCK_GUARD();
+    RAMBLOCK_FOREACH(block) {
+        CheriTagMem *tags = block->cheri_tags;
+        if (!tags) {
+            continue;
+        }
+        cheri_tags_free_sent(tags);
+        if (cheri_tags_ignored(tags)) {
+            continue;
+        }
+        uint64_t align = 0;
+        tags->migration_sent = qemu_anon_ram_alloc(
+            tags->blocks_size, &align, /*shared=*/false, /*noreserve=*/true);
+        if (!tags->migration_sent) {
+            error_report("%s: Can't allocate tag migration state", __func__);
+            return -ENOMEM;
+        }
+        /* Only changed blocks are sent, so start from all tags cleared. */
+        cheri_tags_put_ramblock(f, block);
+        qemu_put_be64(f, CHERI_TAGS_FLAG_CLEAR);
+    }
+    cheri_tags_migration.pending_bytes = 0;
+    qemu_put_be64(f, CHERI_TAGS_FLAG_EOS);
+    return 0;
+}
+
+static void cheri_tags_save_cleanup(void *opaque)
+{
+    RAMBlock *block;
+
+    RCU_READ_LOCK_GUARD();
+    RAMBLOCK_FOREACH(block) {
+        if (block->cheri_tags) {
+            cheri_tags_free_sent(block->cheri_tags);
+        }
+    }
+}
+
+/*
+ * Send all tag blocks that changed since they were last sent. Returns 1 if
+ * everything was sent, 0 if we stopped early due to rate limiting.
+ */
+static int cheri_tags_save(QEMUFile *f, bool final)
+{
+    CheriTagBlock snapshot, le_block;
+    RAMBlock *block;
+    bool rate_limited = false;
+    uint64_t pending = 0;
+    int ret;
+
+    RCU_READ_LOCK_GUARD();
+    RAMBLOCK_FOREACH(block) {
+        CheriTagMem *tags = block->cheri_tags;
+        bool sent_ramblock = false;
+        if (!tags || !tags->migration_sent) {
+            continue;
+        }
+        for (size_t blk = find_first_bit(tags->populated, tags->nblocks);
+             blk < tags->nblocks;
+             blk = find_next_bit(tags->populated, tags->nblocks, blk + 1)) {
+            /* Take a snapshot since vCPUs may still be running. */
+            memcpy(&snapshot, &tags->blocks[blk], sizeof(snapshot));
+            if (!memcmp(&snapshot, &tags->migration_sent[blk],
+                        sizeof(snapshot))) {
+                continue;
+            }
+            if (rate_limited || (!final && qemu_file_rate_limit(f))) {
+                rate_limited = true;
+                pending += sizeof(CheriTagBlock);
+                continue;
+            }
+            if (!sent_ramblock) {
+                cheri_tags_put_ramblock(f, block);
+                sent_ramblock = true;
+            }
+            qemu_put_be64(f, ((uint64_t)blk << CHERI_TAGS_FLAG_SHIFT) |
+                                 CHERI_TAGS_FLAG_BLOCK);
+            bitmap_to_le(le_block.tag_bitmap, snapshot.tag_bitmap,
+                         CAP_TAGBLK_SIZE);
+            qemu_put_buffer(f, (uint8_t *)&le_block, sizeof(le_block));
+            memcpy(&tags->migration_sent[blk], &snapshot, sizeof(snapshot));
+        }
+    }
+    qemu_put_be64(f, CHERI_TAGS_FLAG_EOS);
+    cheri_tags_migration.pending_bytes = pending;
+
+    ret = qemu_file_get_error(f);
+    if (ret < 0) {
+        return ret;
+    }
+    return rate_limited ? 0 : 1;
+}
+
+static int cheri_tags_save_iterate(QEMUFile *f, void *opaque)
+{
+    return cheri_tags_save(f, false);
+}
+
+static int cheri_tags_save_complete(QEMUFile *f, void *opaque)
+{
+    int ret = cheri_tags_save(f, true);
+    return ret < 0 ? ret : 0;
+}
+
+static void cheri_tags_save_pending(QEMUFile *f, void *opaque,
+                                    uint64_t max_size,
+                                    uint64_t *res_precopy_only,
+                                    uint64_t *res_compatible,
+                                    uint64_t *res_postcopy_only)
+{
+    *res_precopy_only += cheri_tags_migration.pending_bytes;
+}
+
+static void cheri_tags_clear_all(CheriTagMem *tags)
+{
+    for (size_t blk = find_first_bit(tags->populated, tags->nblocks);
+         blk < tags->nblocks;
+         blk = find_next_bit(tags->populated, tags->nblocks, blk + 1)) {
+        memset(&tags->blocks[blk], 0, sizeof(CheriTagBlock));
+    }
+}
+
+static int cheri_tags_load_setup(QEMUFile *f, void *opaque)
+{
+    RAMBlock *block;
+
+    /*
+     * Tags that are not part of the stream must end up cleared, also when the
+     * stream has no cheri-tags section at all. Tags mapped from a file are the
+     * snapshot being restored (the source skipped them with x-ignore-shared
+     * or sends an explicit clear record), so they are left alone.
+     */
+    RCU_READ_LOCK_GUARD();
+    RAMBLOCK_FOREACH(block) {
+        CheriTagMem *tags = block->cheri_tags;
+        if (tags && !tags->file_backed) {
+            cheri_tags_clear_all(tags);
+        }
+    }
+    /* Loaded tags do not come with provenance. */
+    cheri_provenance_invalidate_all();
+    return 0;
+}
+
+static int cheri_tags_load(QEMUFile *f, void *opaque, int version_id)
+{
+    CheriTagBlock le_block;
+    RAMBlock *block = NULL;
+    bool populated_new = false;
+    char idstr[256];
+
+    RCU_READ_LOCK_GUARD();
+    for (;;) {
+        uint64_t header = qemu_get_be64(f);
+        uint64_t flags = header & CHERI_TAGS_FLAG_MASK;
+        int ret = qemu_file_get_error(f);
+        if (ret < 0) {
+            return ret;
+        }
+
+        switch (flags) {
+        case CHERI_TAGS_FLAG_EOS:
+            if (populated_new) {
+                /* The TLB may still map these blocks as ALL_ZERO_TAGBLK. */
+                CPUState *cpu;
+                CPU_FOREACH(cpu) {
+                    tlb_flush(cpu);
+                }
+            }
+            return 0;
+        case CHERI_TAGS_FLAG_RAMBLOCK: {
+            size_t len = qemu_get_byte(f);
+            qemu_get_buffer(f, (uint8_t *)idstr, len);
+            idstr[len] = '\0';
+            block = qemu_ram_block_by_name(idstr);
+            if (!block || !block->cheri_tags) {
+                error_report("CHERI tags for unknown RAMBlock '%s'", idstr);
+                return -EINVAL;
+            }
+            break;
+        }
+        case CHERI_TAGS_FLAG_CLEAR: {
+            if (!block) {
+                error_report("CHERI tag clear without a RAMBlock");
+                return -EINVAL;
+            }
+            cheri_tags_clear_all(block->cheri_tags);
+            break;
+        }
+        case CHERI_TAGS_FLAG_BLOCK: {
+            uint64_t blk = header >> CHERI_TAGS_FLAG_SHIFT;
+            if (!block) {
+                error_report("CHERI tag block without a RAMBlock");
+                return -EINVAL;
+            }
+            CheriTagMem *tags = block->cheri_tags;
+            if (blk >= tags->nblocks) {
+                error_report("CHERI tag block %" PRIu64 " out of range for %s",
+                             blk, block->idstr);
+                return -EINVAL;
+            }
+            qemu_get_buffer(f, (uint8_t *)&le_block, sizeof(le_block));
+            if (!test_bit(blk, tags->populated)) {
+                set_bit_atomic(blk, tags->populated);
+                populated_new = true;
+            }
+            bitmap_from_le(tags->blocks[blk].tag_bitmap, le_block.tag_bitmap,
+                           CAP_TAGBLK_SIZE);
+            break;
+        }
+        default:
+            error_report("Unexpected CHERI tag migration flags: %#" PRIx64,
+                         flags);
+            return -EINVAL;
+        }
+    }
+}
+
+static bool cheri_tags_active(void *opaque)
+{
+    return true;
+}
+
+static SaveVMHandlers savevm_cheri_tags_handlers = {
+    .save_setup = cheri_tags_save_setup,
+    .save_live_iterate = cheri_tags_save_iterate,
+    .save_live_complete_precopy = cheri_tags_save_complete,
+    .save_live_pending = cheri_tags_save_pending,
+    .save_cleanup = cheri_tags_save_cleanup,
+    .load_setup = cheri_tags_load_setup,
+    .load_state = cheri_tags_load,
+    .is_active = cheri_tags_active,
+};
+
+static void cheri_tags_register_migration(void)
+{
+    if (!cheri_tags_migration.registered) {
+        register_savevm_live("cheri-tags", 0, 1, &savevm_cheri_tags_handlers,
+                             NULL);
+        cheri_tags_migration.registered = true;
+    }
+}
@@ -34,7 +34,9 @@
 #include "qemu/osdep.h"
 #include "cpu.h"
 #include "exec/cpu-common.h"
+#include "exec/exec-all.h"
 #include "exec/memory.h"
+#include "exec/memopidx.h"
 
 #if defined(TARGET_CHERI)
 
@@ -47,6 +49,20 @@ void cheri_tag_phys_invalidate(CPUArchState *env, RAMBlock *ram,
                                ram_addr_t offset, size_t len,
                                const target_ulong *vaddr);
 void cheri_tag_init(MemoryRegion* mr, uint64_t memory_size);
+/**
+ * Like cheri_tag_init(), but map the tags from the file at @p path. With
+ * @p shared the file is created/extended if needed and tag updates are
+ * written back to it, otherwise it is mapped copy-on-write.
+ */
+bool cheri_tag_init_file(MemoryRegion *mr, uint64_t memory_size,
+                         const char *path, bool shared, Error **errp);
+/**
+ * Return a file descriptor for the tags of @p ram if they are in shared memory
+ * (a shared tag file, or a memfd if @p ram itself is shared), or -1 otherwise.
+ * The tags are a bitmap of host longs with one bit per CHERI_CAP_SIZE
+ * granule of @p ram, and @p size is set to the size of the mapping.
+ */
+int cheri_tag_get_fd(RAMBlock *ram, uint64_t *size);
 /**
  * Generic tag invalidation function to be called for a *single* data store:
  * Note: this will currently invalidate at most two tags (as can happen
@@ -69,6 +85,21 @@ void *cheri_tag_invalidate_aligned(CPUArchState *env, target_ulong vaddr,
 bool cheri_tag_get(CPUArchState *env, target_ulong vaddr, int reg,
                    hwaddr *ret_paddr, int *prot, uintptr_t pc, int mmu_idx,
                    void *host_addr);
+/**
+ * TLB-only fast path for cheri_tag_get(): if @p vaddr hits in the TLB for
+ * plain RAM without any capability flags, return the host address and store
+ * the tag in @p tag. Returns NULL if the caller must fall back to
+ * probe_read() + cheri_tag_get().
+ */
+void *cheri_tag_get_fast(CPUArchState *env, target_ulong vaddr, int mmu_idx,
+                         bool *tag);
+/**
+ * TLB-only fast path for cheri_tag_set()/cheri_tag_invalidate_aligned().
+ * Returns the host address if the tag was updated, or NULL if the caller must
+ * use the slow path (TLB miss, I/O, capability flags, unallocated tag block).
+ */
+void *cheri_tag_set_fast(CPUArchState *env, target_ulong vaddr, int mmu_idx,
+                         bool tag);
 /*
  * Get/set many currently don't have an mmu_idx because no targets currently
  * require it.
@@ -85,6 +116,83 @@ void cheri_tag_set_many(CPUArchState *env, uint32_t tags, target_ulong vaddr,
 void *cheri_tag_set(CPUArchState *env, target_ulong vaddr, int reg,
                     hwaddr *ret_paddr, uintptr_t pc, int mmu_idx);
 
+/*
+ * With MTTCG, the tag and data of a capability-sized granule are protected by
+ * a seqlock selected by the granule's host address @p host. Writers update
+ * tag and data between cheri_tag_write_lock() and cheri_tag_write_unlock(),
+ * readers repeat their accesses while cheri_tag_read_retry() returns true.
+ * Without MTTCG these functions do nothing.
+ */
+unsigned cheri_tag_read_begin(const void *host);
+bool cheri_tag_read_retry(const void *host, unsigned start);
+void cheri_tag_write_lock(const void *host);
+void cheri_tag_write_unlock(const void *host);
+/* Lock or unlock all granules of a capability-aligned host range. */
+void cheri_tag_write_lock_range(const void *host, size_t len);
+void cheri_tag_write_unlock_range(const void *host, size_t len);
+
+/*
+ * Whether the data stores of @p cpu run concurrently with the capability
+ * accesses of other vCPUs (parallel TBs outside an exclusive context). Such
+ * stores write their data and clear the tag with the granule write-locked:
+ * plain stores in the slow path of the softmmu TLB, which pages with a
+ * populated tag block are sent to, and atomics between cheri_tag_store_begin()
+ * and cheri_tag_store_end(). Tag blocks are then only populated in an
+ * exclusive context, see cheri_tagmem_for_addr().
+ */
+static inline bool cheri_tag_stores_locked(CPUState *cpu)
+{
+    return (cpu->tcg_cflags & CF_PARALLEL) && !cpu_in_exclusive_context(cpu);
+}
+
+/**
+ * Atomics in parallel TBs: take any alignment or store fault of the atomic
+ * @p oi at @p vaddr and write-lock its granules. The atomic must then be
+ * performed and cheri_tag_store_end() called, which clears the tags if
+ * @p stored is true (e.g. a compare-and-swap succeeded) and unlocks them.
+ * Writing the data inside the lock guarantees that a capability load never
+ * sees a set tag with data from a racing atomic.
+ * If the atomic faults after cheri_tag_store_begin(), cpu_exec() calls
+ * cheri_tag_store_abort() to drop the locks.
+ */
+void cheri_tag_store_begin(CPUArchState *env, target_ulong vaddr, MemOpIdx oi,
+                           uintptr_t pc);
+void cheri_tag_store_end(CPUArchState *env, bool stored);
+void cheri_tag_store_abort(void);
+
+/**
+ * Like cheri_tag_set() (or cheri_tag_invalidate_aligned() if @p tag is false)
+ * but the tag is updated with the granule write-locked. All faults are raised
+ * before taking the lock.
+ * @return the host address, in which case the caller must write the data and
+ * then call cheri_tag_write_unlock(), or NULL for I/O (no lock is held).
+ */
+void *cheri_tag_set_locked(CPUArchState *env, target_ulong vaddr, int reg,
+                           bool tag, uintptr_t pc, int mmu_idx);
+
+/**
+ * For atomic read-modify-write of a capability: raise any capability store
+ * fault (and, if @p load is set, any load fault) for @p vaddr and then
+ * write-lock the granule. The old tag can be read with cheri_tag_get()
+ * (passing the returned host address) if @p load was set, or with
+ * cheri_tag_get_locked() otherwise. The new one is written with
+ * cheri_tag_update_locked().
+ * @return the host address, or NULL for I/O (no lock is held).
+ */
+void *cheri_tag_rmw_lock(CPUArchState *env, target_ulong vaddr, int reg,
+                         uintptr_t pc, int mmu_idx, bool load);
+/**
+ * Read the tag for @p vaddr, which must have been locked and probed for
+ * writing by cheri_tag_rmw_lock(). No load fault is taken.
+ */
+bool cheri_tag_get_locked(CPUArchState *env, target_ulong vaddr, int mmu_idx);
+/**
+ * Update the tag for @p vaddr, which must have been locked and probed by
+ * cheri_tag_set_locked() or cheri_tag_rmw_lock().
+ */
+void cheri_tag_update_locked(CPUArchState *env, target_ulong vaddr,
+                             int mmu_idx, bool tag);
+
 void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
                             RAMBlock *ram, ram_addr_t ram_offset, size_t size,
                             int *prot, bool tag_write);
@@ -93,5 +201,40 @@ void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
  * Fetch a single tag for use by the debug stub.
  */
 bool cheri_tag_get_debug(RAMBlock *ram, ram_addr_t ram_offset);
+/**
+ * Set a single tag from outside a vCPU (e.g. the qtest protocol), without
+ * checking the capability stored there. Returns false if @p ram has no tags.
+ */
+bool cheri_tag_set_debug(RAMBlock *ram, ram_addr_t ram_offset);
+
+/**
+ * Parameters and results of cheri_tag_revoke_sweep(). Bit i of @p bitmap
+ * (LSB first within each byte) marks capabilities with base
+ * bitmap_base + i * CHERI_CAP_SIZE as revoked.
+ */
+typedef struct CheriRevokeRequest {
+    const uint8_t *bitmap;
+    uint64_t bitmap_base;
+    uint64_t bitmap_bits;
+    /* Number of tagged capabilities visited and tags cleared */
+    uint64_t scanned;
+    uint64_t revoked;
+} CheriRevokeRequest;
+/**
+ * Clear the tags of all capabilities in [@p offset, @p offset + @p len) of
+ * @p ram whose base is marked in the revocation bitmap of @p req, using up to
+ * @p nthreads host threads. Safe to call while vCPUs are running.
+ */
+void cheri_tag_revoke_sweep(RAMBlock *ram, ram_addr_t offset, ram_addr_t len,
+                            CheriRevokeRequest *req, unsigned nthreads);
+
+/* Set by -cheri-provenance and the cheri_provenance monitor command */
+extern bool cheri_provenance_enabled;
+/**
+ * Record that the capability stored at host address @p host (which must be
+ * guest RAM) was written by the instruction at @p pc in address space
+ * @p asid. Only called if cheri_provenance_enabled is set.
+ */
+void cheri_provenance_record(void *host, target_ulong pc, unsigned asid);
 
 #endif /* TARGET_CHERI */
@@ -649,11 +649,21 @@ static inline void cap_increment_offset(cap_register_t *cap, uint64_t offset)
     return cap_set_cursor(cap, new_addr);
 }
 
-#ifndef TARGET_CHERI_RISCV_STD
+/*
+ * Whether each permission is a single bit in PESBT, so that permission checks
+ * can be performed with a mask (e.g. from TCG). This holds for Morello, ISAv9
+ * and the MXLEN=64 RISC-V standard encoding, but the MXLEN=32 RISC-V standard
+ * encoding compresses permissions.
+ */
+#if !defined(TARGET_CHERI_RISCV_STD) || CAP_CC(ADDR_WIDTH) == 64
+#define CHERI_PERMS_ARE_PESBT_BITS 1
+#endif
+
+#ifdef CHERI_PERMS_ARE_PESBT_BITS
 /** Encode the permissions for the in-memory capability representation. */
 static inline target_ulong cap_encode_perms(target_ulong perms)
 {
-    /* This assumes permissions are single-bit checks (Morello, ISAv9) */
+    /* This assumes permissions are single-bit checks */
     cap_register_t reg =
         CAP_cc(make_null_derived_cap_ext)(0, CAP_CC(MANDATORY_LEVEL_BITS));
     assert(reg.cr_pesbt == CAP_MEM_XOR_MASK);
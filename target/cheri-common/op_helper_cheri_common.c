@@ -41,6 +41,7 @@
 #include "exec/exec-all.h"
 #include "exec/helper-proto.h"
 #include "exec/memop.h"
+#include "qemu/atomic128.h"
 
 #include "cheri-helper-utils.h"
 #include "cheri_tagmem.h"
@@ -229,6 +230,17 @@ void CHERI_HELPER_IMPL(cheri_invalidate_tags_condition(
     }
 }
 
+void CHERI_HELPER_IMPL(cheri_tag_store_begin(CPUArchState *env,
+                                             target_ulong vaddr, MemOpIdx oi))
+{
+    cheri_tag_store_begin(env, vaddr, oi, GETPC());
+}
+
+void CHERI_HELPER_IMPL(cheri_tag_store_end(CPUArchState *env, uint32_t stored))
+{
+    cheri_tag_store_end(env, stored);
+}
+
 /// Implementations of individual instructions start here
 
 /// Two operand inspection instructions:
@@ -903,6 +915,15 @@ DEFINE_CHERI_STAT(csetoffset);
 DEFINE_CHERI_STAT(csetaddr);
 DEFINE_CHERI_STAT(candaddr);
 DEFINE_CHERI_STAT(cfromptr);
+
+struct oob_stats_info *const cheri_oob_stats[] = {
+    OOB_INFO(cincoffset),       OOB_INFO(csetoffset),
+    OOB_INFO(csetaddr),         OOB_INFO(candaddr),
+    OOB_INFO(cfromptr),         OOB_INFO(cgetpccsetoffset),
+    OOB_INFO(cgetpccincoffset), OOB_INFO(cgetpccsetaddr),
+    OOB_INFO(misc),
+};
+const size_t cheri_oob_stats_count = ARRAY_SIZE(cheri_oob_stats);
 #endif
 
 static inline QEMU_ALWAYS_INLINE void
@@ -1444,10 +1465,11 @@ static void update_loaded_cap_perms(CPUArchState *env, target_ulong *pesbt,
 #endif
 }
 
-bool load_cap_from_memory_raw_tag_mmu_idx(
+static bool load_cap_from_memory_impl(
     CPUArchState *env, target_ulong *pesbt, target_ulong *cursor, uint32_t cb,
     const cap_register_t *source, target_ulong vaddr, uintptr_t retpc,
-    hwaddr *physaddr, bool *raw_tag, int mmu_idx, bool all_raw)
+    hwaddr *physaddr, target_ulong *raw_pesbt, bool *raw_tag, int mmu_idx,
+    bool all_raw)
 {
     /*
      * If all_raw is set, we return tag, pesbt and cursor exactly as they are
@@ -1457,12 +1479,13 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
      * must have checked permissions for the memory read. We use the
      * authorizing capability's permission to fix up the mem capability (e.g.
      * clear the tag, strip W for missing LM, ...). In the all_raw case, there
-     * is no such fixup, cb/source are not needed. raw_tag isn't needed either,
-     * the function returns the raw tag.
+     * is no such fixup, cb/source are not needed. raw_pesbt and raw_tag aren't
+     * needed either, the function returns the raw values.
      */
     if (all_raw) {
         cheri_debug_assert(cb == 0);
         cheri_debug_assert(source == NULL);
+        cheri_debug_assert(raw_pesbt == NULL);
         cheri_debug_assert(raw_tag == NULL);
     }
 
@@ -1473,8 +1496,24 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
      * Note: In-memory capabilities pesbt is xored with a mask to ensure that
      * NULL capabilities have an all zeroes representation.
      */
-    /* No TLB fault possible, should be safe to get a host pointer now */
-    void *host = probe_read(env, vaddr, CHERI_CAP_SIZE, mmu_idx, retpc);
+    /*
+     * Fast path: a TLB hit on plain RAM without any capability flags lets us
+     * read the tag directly, skipping probe_read() and the iotlb lookup in
+     * cheri_tag_get(). The fast path requires that no TLBENTRYCAP flags are
+     * set, so prot stays zero.
+     */
+    int prot = 0;
+    bool tag = false;
+    bool have_tag = false;
+    void *host = NULL;
+    if (likely(physaddr == NULL)) {
+        host = cheri_tag_get_fast(env, vaddr, mmu_idx, &tag);
+        have_tag = host != NULL;
+    }
+    if (!have_tag) {
+        /* No TLB fault possible, should be safe to get a host pointer now */
+        host = probe_read(env, vaddr, CHERI_CAP_SIZE, mmu_idx, retpc);
+    }
     // When writing back pesbt we have to XOR with the NULL mask to ensure that
     // NULL capabilities have an all-zeroes representation.
     if (likely(host)) {
@@ -1486,9 +1525,20 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
 #else
 #error "Unhandled target long width"
 #endif
-        *pesbt = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_METADATA) ^
-                 CAP_MEM_XOR_MASK;
-        *cursor = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_CURSOR);
+        unsigned seq;
+        do {
+            seq = cheri_tag_read_begin(host);
+            *pesbt = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_METADATA) ^
+                     CAP_MEM_XOR_MASK;
+            *cursor = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_CURSOR);
+            if (qemu_tcg_mttcg_enabled()) {
+                /* The tag must be read in the same read section. */
+                smp_rmb();
+                tag = cheri_tag_get(env, vaddr, cb, physaddr, &prot, retpc,
+                                    mmu_idx, host);
+                have_tag = true;
+            }
+        } while (cheri_tag_read_retry(host, seq));
 #undef ld_cap_word_p
     } else {
         // Slow path for e.g. IO regions.
@@ -1499,9 +1549,10 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
             CAP_MEM_XOR_MASK;
         *cursor = cpu_ld_cap_word_ra(env, vaddr + CHERI_MEM_OFFSET_CURSOR, retpc);
     }
-    int prot;
-    bool tag =
-        cheri_tag_get(env, vaddr, cb, physaddr, &prot, retpc, mmu_idx, host);
+    if (!have_tag) {
+        tag = cheri_tag_get(env, vaddr, cb, physaddr, &prot, retpc, mmu_idx,
+                            host);
+    }
 
 #if defined(CONFIG_TCG_LOG_INSTR)
     /* Log capability memory access as a single access */
@@ -1524,6 +1575,9 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
 
     /* Skip fixups if the caller wants the exact raw capability, see above. */
     if (!all_raw) {
+        if (raw_pesbt) {
+            *raw_pesbt = *pesbt;
+        }
         if (raw_tag) {
             *raw_tag = tag;
         }
@@ -1550,6 +1604,16 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
     return tag;
 }
 
+bool load_cap_from_memory_raw_tag_mmu_idx(
+    CPUArchState *env, target_ulong *pesbt, target_ulong *cursor, uint32_t cb,
+    const cap_register_t *source, target_ulong vaddr, uintptr_t retpc,
+    hwaddr *physaddr, bool *raw_tag, int mmu_idx, bool all_raw)
+{
+    return load_cap_from_memory_impl(env, pesbt, cursor, cb, source, vaddr,
+                                     retpc, physaddr, NULL, raw_tag, mmu_idx,
+                                     all_raw);
+}
+
 bool load_raw_cap_from_memory(CPUArchState *env, target_ulong *pesbt,
                               target_ulong *cursor, target_ulong vaddr,
                               uintptr_t retpc)
@@ -1560,6 +1624,18 @@ bool load_raw_cap_from_memory(CPUArchState *env, target_ulong *pesbt,
                                                 /* all_raw */ true);
 }
 
+bool load_cap_from_memory_with_raw(CPUArchState *env, target_ulong *pesbt,
+                                   target_ulong *cursor, uint32_t cb,
+                                   const cap_register_t *source,
+                                   target_ulong vaddr, uintptr_t retpc,
+                                   target_ulong *raw_pesbt, bool *raw_tag)
+{
+    return load_cap_from_memory_impl(env, pesbt, cursor, cb, source, vaddr,
+                                     retpc, NULL, raw_pesbt, raw_tag,
+                                     cpu_mmu_index(env, false),
+                                     /* all_raw */ false);
+}
+
 bool load_cap_from_memory_raw_tag(CPUArchState *env, target_ulong *pesbt,
                                   target_ulong *cursor, uint32_t cb,
                                   const cap_register_t *source,
@@ -1593,7 +1669,8 @@ cap_register_t load_and_decompress_cap_from_memory_raw(
 #ifdef TARGET_CHERI_RISCV_STD
     lvbits = env_archcpu(env)->cfg.lvbits;
 #endif
-    CAP_cc(decompress_raw_ext)(pesbt, cursor, tag, lvbits, &result);
+    CAP_cc(decompress_raw_cached)(&cheri_get_gpcrs(env)->decode_cache, pesbt,
+                                  cursor, tag, lvbits, &result);
     result.cr_extra = CREG_FULLY_DECOMPRESSED;
     return result;
 }
@@ -1610,21 +1687,11 @@ void load_cap_from_memory(CPUArchState *env, uint32_t cd, uint32_t cb,
 }
 
 /*
- * cs is the register of the capability that will be stored
- * cb is the register of the authorizing capability
+ * The tag that a store of capability register cs authorized by cb writes to
+ * memory.
  */
-void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
-                                   uint32_t cb __attribute__((unused)),
-                                   target_ulong vaddr, uintptr_t retpc,
-                                   int mmu_idx)
+static bool tag_for_cap_store(CPUArchState *env, uint32_t cs, uint32_t cb)
 {
-    target_ulong cursor = get_capreg_cursor(env, cs);
-    target_ulong pesbt_for_mem = get_capreg_pesbt(env, cs) ^ CAP_MEM_XOR_MASK;
-#ifdef CONFIG_DEBUG_TCG
-    if (get_capreg_state(cheri_get_gpcrs(env), cs) == CREG_INTEGER) {
-        tcg_debug_assert(pesbt_for_mem == 0 && "Integer values should have NULL PESBT");
-    }
-#endif
     bool tag = get_capreg_tag_filtered(env, cs);
 #if defined(TARGET_CHERI_RISCV_STD)
     RISCVCPU *cpu = env_archcpu(env);
@@ -1645,8 +1712,27 @@ void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
             tag = false;
         }
     }
+#endif
+    return tag;
+}
 
+/*
+ * cs is the register of the capability that will be stored
+ * cb is the register of the authorizing capability
+ */
+void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
+                                   uint32_t cb __attribute__((unused)),
+                                   target_ulong vaddr, uintptr_t retpc,
+                                   int mmu_idx)
+{
+    target_ulong cursor = get_capreg_cursor(env, cs);
+    target_ulong pesbt_for_mem = get_capreg_pesbt(env, cs) ^ CAP_MEM_XOR_MASK;
+#ifdef CONFIG_DEBUG_TCG
+    if (get_capreg_state(cheri_get_gpcrs(env), cs) == CREG_INTEGER) {
+        tcg_debug_assert(pesbt_for_mem == 0 && "Integer values should have NULL PESBT");
+    }
 #endif
+    bool tag = tag_for_cap_store(env, cs, cb);
     if (cs == NULL_CAPREG_INDEX) {
         tcg_debug_assert(pesbt_for_mem == 0 && "Wrong value for cnull?");
         tcg_debug_assert(cursor == 0 && "Wrong value for cnull?");
@@ -1656,17 +1742,29 @@ void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
      * Touching the tags will take both the data write TLB fault and
      * capability write TLB fault before updating anything.  Thereafter, the
      * data stores will not take additional faults, so there is no risk of
-     * accidentally tagging a shorn data write.  This, like the rest of the
-     * tag logic, is not multi-TCG-thread safe.
+     * accidentally tagging a shorn data write.  With MTTCG, the tag and data
+     * are updated with the granule write-locked so that concurrent capability
+     * loads never observe a torn capability.
      */
 
     env->statcounters_cap_write++;
-    void *host = NULL;
     if (tag) {
         env->statcounters_cap_write_tagged++;
-        host = cheri_tag_set(env, vaddr, cs, NULL, retpc, mmu_idx);
+    }
+    void *host;
+    if (qemu_tcg_mttcg_enabled()) {
+        host = cheri_tag_set_locked(env, vaddr, cs, tag, retpc, mmu_idx);
     } else {
-        host = cheri_tag_invalidate_aligned(env, vaddr, retpc, mmu_idx);
+        /* Try updating the tag via the TLB directly before the slow path. */
+        host = cheri_tag_set_fast(env, vaddr, mmu_idx, tag);
+        if (unlikely(!host)) {
+            if (tag) {
+                host = cheri_tag_set(env, vaddr, cs, NULL, retpc, mmu_idx);
+            } else {
+                host = cheri_tag_invalidate_aligned(env, vaddr, retpc,
+                                                    mmu_idx);
+            }
+        }
     }
     // When writing back pesbt we have to XOR with the NULL mask to ensure that
     // NULL capabilities have an all-zeroes representation.
@@ -1681,6 +1779,11 @@ void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
         // Fast path, host address in TLB
         st_cap_word_p((char*)host + CHERI_MEM_OFFSET_METADATA, pesbt_for_mem);
         st_cap_word_p((char*)host + CHERI_MEM_OFFSET_CURSOR, cursor);
+        if (unlikely(cheri_provenance_enabled) && tag) {
+            target_ulong pc = cpu_get_current_pc(env, retpc, false);
+            cheri_provenance_record(host, pc, cpu_get_asid(env, pc));
+        }
+        cheri_tag_write_unlock(host);
 #undef st_cap_word_p
     } else {
         // Slow path for e.g. IO regions.
@@ -1723,6 +1826,200 @@ void store_cap_to_memory(CPUArchState *env, uint32_t cs, uint32_t cb,
                                          cpu_mmu_index(env, false));
 }
 
+#if TARGET_LONG_BITS == 32
+#define ld_cap_word_p ldl_p
+#define st_cap_word_p stl_p
+#else
+#define ld_cap_word_p ldq_p
+#define st_cap_word_p stq_p
+#endif
+
+/*
+ * Replace the data of the capability at host with new_pesbt/new_cursor if it
+ * still holds old_pesbt/old_cursor (all in memory representation). This uses
+ * a host compare-and-swap, so that accesses to the same location that do not
+ * take the granule lock cannot be lost. Without a 128-bit compare-and-swap,
+ * rmw_cap_in_memory() restarts in an exclusive context instead.
+ */
+static bool cmpxchg_cap_words(void *host, target_ulong old_pesbt,
+                              target_ulong old_cursor, target_ulong new_pesbt,
+                              target_ulong new_cursor)
+{
+    QEMU_ALIGNED(CHERI_CAP_SIZE) uint8_t old_mem[CHERI_CAP_SIZE];
+    QEMU_ALIGNED(CHERI_CAP_SIZE) uint8_t new_mem[CHERI_CAP_SIZE];
+
+    st_cap_word_p(old_mem + CHERI_MEM_OFFSET_METADATA, old_pesbt);
+    st_cap_word_p(old_mem + CHERI_MEM_OFFSET_CURSOR, old_cursor);
+    st_cap_word_p(new_mem + CHERI_MEM_OFFSET_METADATA, new_pesbt);
+    st_cap_word_p(new_mem + CHERI_MEM_OFFSET_CURSOR, new_cursor);
+#if CHERI_CAP_SIZE == 8
+    uint64_t cmp = *(uint64_t *)old_mem;
+    return qatomic_cmpxchg__nocheck((uint64_t *)host, cmp,
+                                    *(uint64_t *)new_mem) == cmp;
+#elif HAVE_CMPXCHG128
+    Int128 cmp = *(Int128 *)old_mem;
+    return int128_eq(atomic16_cmpxchg(host, cmp, *(Int128 *)new_mem), cmp);
+#else
+    g_assert_not_reached();
+#endif
+}
+
+/*
+ * Atomic read-modify-write of the capability at vaddr for MTTCG. The granule
+ * is locked, so the old tag and data are read and the new ones written
+ * without any other vCPU observing an intermediate state.
+ *
+ * On entry *pesbt, *cursor and *tag hold the expected raw memory contents if
+ * compare is set. On return they hold the raw memory contents before the
+ * operation. Returns true if cs was stored.
+ *
+ * If load_prot is non-NULL the old value is also the result of a load: the
+ * store is skipped if that load would trap and *load_prot is set to the
+ * PAGE_LC_* bits for the caller to apply.
+ */
+static bool rmw_cap_in_memory(CPUArchState *env, uint32_t cs, uint32_t cb,
+                              target_ulong vaddr, uintptr_t retpc,
+                              bool compare, target_ulong *pesbt,
+                              target_ulong *cursor, bool *tag, int *load_prot)
+{
+    int mmu_idx = cpu_mmu_index(env, false);
+    target_ulong new_cursor = get_capreg_cursor(env, cs);
+    target_ulong new_pesbt = get_capreg_pesbt(env, cs) ^ CAP_MEM_XOR_MASK;
+    bool new_tag = tag_for_cap_store(env, cs, cb);
+    target_ulong old_pesbt, old_cursor;
+    bool old_tag, stored;
+    int prot = 0;
+
+    /* The replay after cpu_loop_exit_atomic() takes the serial path. */
+    tcg_debug_assert(cap_rmw_needs_atomic(env));
+#if CHERI_CAP_SIZE == 16 && !HAVE_CMPXCHG128
+    /* No host compare-and-swap for the whole capability: stop the world. */
+    cpu_loop_exit_atomic(env_cpu(env), retpc);
+#endif
+    void *host = cheri_tag_rmw_lock(env, vaddr, cb, retpc, mmu_idx,
+                                    /*load=*/load_prot != NULL);
+    if (unlikely(!host)) {
+        /* Not RAM (e.g. I/O), fall back to stopping the world. */
+        cpu_loop_exit_atomic(env_cpu(env), retpc);
+    }
+    do {
+        old_pesbt = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_METADATA);
+        old_cursor = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_CURSOR);
+        if (load_prot) {
+            old_tag = cheri_tag_get(env, vaddr, cb, NULL, &prot, retpc,
+                                    mmu_idx, host);
+        } else {
+            /* SC.C only compares, it must not take a load fault. */
+            old_tag = cheri_tag_get_locked(env, vaddr, mmu_idx);
+        }
+        if (compare && (old_tag != *tag || old_cursor != *cursor ||
+                        (old_pesbt ^ CAP_MEM_XOR_MASK) != *pesbt)) {
+            stored = false;
+            break;
+        }
+        if (load_prot && ((old_tag && (prot & PAGE_LC_TRAP)) ||
+                          (prot & PAGE_LC_TRAP_ANY))) {
+            stored = false;
+            break;
+        }
+        /* A racing integer atomic changed the data: compare or swap again. */
+        stored = cmpxchg_cap_words(host, old_pesbt, old_cursor, new_pesbt,
+                                   new_cursor);
+    } while (!stored && !compare);
+    if (stored) {
+        cheri_tag_update_locked(env, vaddr, mmu_idx, new_tag);
+        if (unlikely(cheri_provenance_enabled) && new_tag) {
+            target_ulong pc = cpu_get_current_pc(env, retpc, false);
+            cheri_provenance_record(host, pc, cpu_get_asid(env, pc));
+        }
+    }
+    cheri_tag_write_unlock(host);
+
+    *pesbt = old_pesbt ^ CAP_MEM_XOR_MASK;
+    *cursor = old_cursor;
+    *tag = old_tag;
+    if (load_prot) {
+        *load_prot = prot;
+    }
+#if defined(CONFIG_TCG_LOG_INSTR)
+    /* Log like the serial load + store_cap_to_memory() sequence. */
+    if (qemu_log_instr_enabled(env)) {
+        cap_register_t loaded_cap;
+        CAP_cc(decompress_raw)(*pesbt, old_cursor, old_tag, &loaded_cap);
+        qemu_log_instr_ld_cap(env, vaddr, &loaded_cap);
+    }
+#endif
+#if defined(TARGET_RISCV) && defined(CONFIG_RVFI_DII)
+    env->rvfi_dii_trace.MEM.rvfi_mem_addr = vaddr;
+    /* The read that is part of the cmpxchg is not visible in traces. */
+    if (load_prot) {
+        env->rvfi_dii_trace.MEM.rvfi_mem_rdata[0] = old_cursor;
+        env->rvfi_dii_trace.MEM.rvfi_mem_rdata[1] = old_pesbt;
+        env->rvfi_dii_trace.MEM.rvfi_mem_rdata[2] = old_tag;
+        env->rvfi_dii_trace.MEM.rvfi_mem_rmask = (1 << CHERI_CAP_SIZE) - 1;
+        env->rvfi_dii_trace.available_fields |= RVFI_MEM_DATA;
+    }
+#endif
+    if (stored) {
+        env->statcounters_cap_write++;
+        if (new_tag) {
+            env->statcounters_cap_write_tagged++;
+        }
+#if defined(TARGET_RISCV) && defined(CONFIG_RVFI_DII)
+        env->rvfi_dii_trace.MEM.rvfi_mem_wdata[0] = new_cursor;
+        env->rvfi_dii_trace.MEM.rvfi_mem_wdata[1] = new_pesbt;
+        env->rvfi_dii_trace.MEM.rvfi_mem_wdata[2] = new_tag;
+        env->rvfi_dii_trace.MEM.rvfi_mem_wmask = (1 << CHERI_CAP_SIZE) - 1;
+        env->rvfi_dii_trace.available_fields |= RVFI_MEM_DATA;
+#endif
+#if defined(CONFIG_TCG_LOG_INSTR)
+        if (qemu_log_instr_enabled(env)) {
+            cap_register_t stored_cap;
+            CAP_cc(decompress_raw)(new_pesbt ^ CAP_MEM_XOR_MASK, new_cursor,
+                                   new_tag, &stored_cap);
+            qemu_log_instr_st_cap(env, vaddr, &stored_cap);
+        }
+#endif
+    }
+    return stored;
+}
+
+bool cmpxchg_cap_in_memory(CPUArchState *env, uint32_t cs, uint32_t cb,
+                           target_ulong vaddr, uintptr_t retpc,
+                           target_ulong expected_pesbt,
+                           target_ulong expected_cursor, bool expected_tag)
+{
+    return rmw_cap_in_memory(env, cs, cb, vaddr, retpc, /*compare=*/true,
+                             &expected_pesbt, &expected_cursor, &expected_tag,
+                             NULL);
+}
+
+bool xchg_cap_in_memory(CPUArchState *env, uint32_t cs, uint32_t cb,
+                        const cap_register_t *source, target_ulong vaddr,
+                        uintptr_t retpc, target_ulong *pesbt,
+                        target_ulong *cursor)
+{
+    bool tag;
+    int prot;
+
+    if (!rmw_cap_in_memory(env, cs, cb, vaddr, retpc, /*compare=*/false,
+                           pesbt, cursor, &tag, &prot)) {
+        /* Nothing was stored, raise the load trap. */
+        raise_load_tag_exception(env, vaddr, cb, retpc);
+    }
+    env->statcounters_cap_read++;
+    tag = cheri_tag_prot_clear_or_trap(env, vaddr, cb, source, prot, retpc,
+                                       tag);
+    if (tag) {
+        env->statcounters_cap_read_tagged++;
+        update_loaded_cap_perms(env, pesbt, source);
+    }
+    return tag;
+}
+
+#undef ld_cap_word_p
+#undef st_cap_word_p
+
 target_ulong CHERI_HELPER_IMPL(cloadtags(CPUArchState *env, uint32_t cb))
 {
     static const uint32_t perms = CAP_PERM_LOAD | CAP_PERM_LOAD_CAP;
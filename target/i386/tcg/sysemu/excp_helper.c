@@ -403,8 +403,11 @@ static int handle_mmu_fault(CPUState *cs, vaddr addr, int size,
         paddr &= TARGET_PAGE_MASK;
 
         assert(prot & (1 << is_write1));
-        tlb_set_page_with_attrs(cs, vaddr, paddr, cpu_get_mem_attrs(env),
-                                prot, mmu_idx, page_size);
+        /* With nested paging the guest page may span several host pages. */
+        tlb_set_page_leaf(cs, vaddr, paddr, cpu_get_mem_attrs(env),
+                          prot, mmu_idx, page_size,
+                          env->hflags2 & HF2_NPT_MASK ? TARGET_PAGE_SIZE
+                                                      : page_size);
         return 0;
     } else {
         if (env->intercept_exceptions & (1 << EXCP0E_PAGE)) {
@@ -818,7 +818,7 @@ static inline void generate_cap_load(DisasContext *ctx, int32_t rd, int32_t cb,
     gen_load_gpr(t1, rt);
     tcg_gen_addi_tl(t1, t1, cload_sign_extend(offset) * memop_size(op));
 
-    generate_cap_load_check(vaddr, cb, t1, op);
+    generate_cap_load_check(vaddr, ctx, cb, t1, op);
     tcg_gen_qemu_ld_tl_with_checked_addr(t1, vaddr, ctx->mem_idx, op);
     gen_store_gpr(t1, rd);
 
@@ -900,7 +900,7 @@ static inline void generate_cstore(DisasContext *ctx, int32_t rs, int32_t cb,
     gen_load_gpr(t0, rt);  // t0 <- register offset
     tcg_gen_addi_tl(t0, t0, cload_sign_extend(offset) * size);
 
-    generate_cap_store_check(taddr, cb, t0, op);
+    generate_cap_store_check(taddr, ctx, cb, t0, op);
 
     gen_load_gpr(t0, rs); // t0 <- load value to store
     tcg_gen_qemu_st_tl_with_checked_addr(t0, taddr, ctx->mem_idx, op);
@@ -942,6 +942,15 @@ static inline void generate_clc(DisasContext *ctx, int32_t cd, int32_t cb,
 
 static inline void generate_cllc(DisasContext *ctx, int32_t cd, int32_t cb)
 {
+    if (tb_cflags(ctx->base.tb) & CF_PARALLEL) {
+        /*
+         * The link is not tracked across vCPUs, so stop the world and single
+         * step the CLLC/CSCC pair.
+         */
+        gen_helper_exit_atomic(cpu_env);
+        ctx->base.is_jmp = DISAS_NORETURN;
+        return;
+    }
     TCGv_i32 tcd = tcg_const_i32(cd);
     TCGv_i32 tcb = tcg_const_i32(cb);
     gen_helper_cllc_without_tcg(cpu_env, tcd, tcb);
@@ -980,6 +989,11 @@ static inline void generate_csc(DisasContext *ctx, int32_t cs, int32_t cb,
 static inline void generate_cscc(DisasContext *ctx, int32_t cs, int32_t cb,
         int32_t rd)
 {
+    if (tb_cflags(ctx->base.tb) & CF_PARALLEL) {
+        gen_helper_exit_atomic(cpu_env);
+        ctx->base.is_jmp = DISAS_NORETURN;
+        return;
+    }
     TCGv_i32 tcs = tcg_const_i32(cs);
     TCGv_i32 tcb = tcg_const_i32(cb);
     TCGv t0 = tcg_temp_local_new();
@@ -40,6 +40,11 @@
 #include "monitor/monitor.h"
 
 #include "rvfi_dii.h"
+#ifdef CONFIG_RVFI_DII
+#include <poll.h>
+#include <sys/mman.h>
+#include "qemu/processor.h"
+#endif
 #include "helper_utils.h"
 
 #ifdef TARGET_CHERI
@@ -516,12 +521,45 @@ void restore_state_to_opc(CPURISCVState *env, TranslationBlock *tb,
 #ifdef CONFIG_RVFI_DII
 extern int rvfi_client_fd;
 extern bool rvfi_debug_output;
+extern const char *rvfi_shm_path;
+// Non-NULL once the client has switched to the shared-memory transport
+static struct rvfi_dii_shm_header *rvfi_shm;
+// Ring geometry, checked when the file is mapped
+static struct rvfi_dii_ring_map rvfi_shm_commands;
+static struct rvfi_dii_ring_map rvfi_shm_traces;
+
+// Called while spinning on a ring, exits if the client has gone away.
+static void rvfi_dii_shm_wait(uint64_t *spins)
+{
+    if ((++*spins & 0xffff) != 0) {
+        cpu_relax();
+        return;
+    }
+    struct pollfd pfd = { .fd = rvfi_client_fd, .events = POLLIN };
+    if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR))) {
+        error_report("RVFI-DII client disconnected");
+        exit(EXIT_FAILURE);
+    }
+    sched_yield();
+}
 
 static void send_rvfi_dii_packet(const void *data, size_t len)
 {
     if (rvfi_debug_output) {
         qemu_hexdump(stderr, "PACKET", data, len);
     }
+    if (rvfi_shm) {
+        uint64_t spins = 0;
+        while (len) {
+            size_t n = rvfi_dii_ring_write(&rvfi_shm_traces, data, len);
+            data = (const uint8_t *)data + n;
+            len -= n;
+            if (len) {
+                rvfi_dii_shm_wait(&spins);
+            }
+        }
+        return;
+    }
     ssize_t nbytes = write(rvfi_client_fd, data, len);
     if (nbytes != len) {
         error_report("Failed to write packet to socket: %zd (%s)", nbytes,
@@ -530,6 +568,63 @@ static void send_rvfi_dii_packet(const void *data, size_t len)
     }
 }
 
+static void read_rvfi_dii_command(rvfi_dii_command_t *cmd)
+{
+    if (rvfi_shm) {
+        uint64_t spins = 0;
+        // The client may publish a command in pieces, wait for all of it.
+        while (rvfi_dii_ring_used(&rvfi_shm_commands) < sizeof(*cmd)) {
+            rvfi_dii_shm_wait(&spins);
+        }
+        rvfi_dii_ring_read(&rvfi_shm_commands, cmd, sizeof(*cmd));
+        return;
+    }
+    // Should be blocking, so we only read fewer bytes on EOF
+    ssize_t nbytes = read(rvfi_client_fd, cmd, sizeof(*cmd));
+    if (nbytes != sizeof(*cmd)) {
+        error_report("GOT EOF/Error reading from socket: %zd (%s)", nbytes,
+                     strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Maps the file passed with -rvfi-dii-shm, returns NULL if not available.
+static struct rvfi_dii_shm_header *rvfi_dii_shm_map(void)
+{
+    if (!rvfi_shm_path) {
+        return NULL;
+    }
+    int fd = open(rvfi_shm_path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0 || ftruncate(fd, RVFI_DII_SHM_SIZE) != 0) {
+        warn_report("RVFI-DII: cannot create %s: %s, using the socket",
+                    rvfi_shm_path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    void *ptr = mmap(NULL, RVFI_DII_SHM_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        warn_report("RVFI-DII: cannot map %s: %s, using the socket",
+                    rvfi_shm_path, strerror(errno));
+        return NULL;
+    }
+    struct rvfi_dii_shm_header *shm = ptr;
+    rvfi_dii_shm_init(shm);
+    if (!rvfi_dii_ring_attach(&rvfi_shm_commands, shm, &shm->commands,
+                              RVFI_DII_SHM_SIZE) ||
+        !rvfi_dii_ring_attach(&rvfi_shm_traces, shm, &shm->traces,
+                              RVFI_DII_SHM_SIZE)) {
+        warn_report("RVFI-DII: invalid ring layout in %s, using the socket",
+                    rvfi_shm_path);
+        munmap(ptr, RVFI_DII_SHM_SIZE);
+        return NULL;
+    }
+    return shm;
+}
+
 static void rvfi_dii_send_v1_trace(CPURISCVState* env)
 {
     struct rvfi_dii_trace_v1 trace;
@@ -653,13 +748,7 @@ void rvfi_dii_communicate(CPUState* cs, CPURISCVState* env, bool was_trap) {
             memset(&env->rvfi_dii_trace, 0, sizeof(env->rvfi_dii_trace));
             env->rvfi_dii_trace.INST.rvfi_order = old_instret;
         }
-        // Should be blocking, so we only read fewer bytes on EOF
-        ssize_t nbytes = read(rvfi_client_fd, &cmd_buf, sizeof(cmd_buf));
-        if (nbytes != sizeof(cmd_buf)) {
-            error_report("GOT EOF/Error reading from socket: %zd (%s)", nbytes,
-                         strerror(errno));
-            exit(EXIT_FAILURE);
-        }
+        read_rvfi_dii_command(&cmd_buf);
         if (rvfi_debug_output) {
             info_report("Handling RVFI-DII command %d", cmd_buf.rvfi_dii_cmd);
         }
@@ -729,6 +818,32 @@ void rvfi_dii_communicate(CPUState* cs, CPURISCVState* env, bool was_trap) {
             send_rvfi_dii_packet(&version_response, sizeof(version_response));
             continue;
         }
+        case 's': { /* Switch to the shared-memory transport */
+            struct {
+                char msg[8];
+                uint64_t size;
+            } shm_response = {"shm-ring", 0};
+            // The response is still sent over the socket, everything after it
+            // goes through the rings if the size is non-zero.
+            if (!rvfi_shm) {
+                rvfi_shm = rvfi_dii_shm_map();
+                if (rvfi_shm) {
+                    info_report("RVFI-DII: using shared-memory rings in %s",
+                                rvfi_shm_path);
+                }
+            }
+            if (rvfi_shm) {
+                shm_response.size = rvfi_shm->total_size;
+            }
+            ssize_t nbytes =
+                write(rvfi_client_fd, &shm_response, sizeof(shm_response));
+            if (nbytes != sizeof(shm_response)) {
+                error_report("Failed to write packet to socket: %zd (%s)",
+                             nbytes, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
         case 'B': {
             fprintf(stderr, "*BLINK*\n");
             info_report("*BLINK*\n");
@@ -894,6 +894,14 @@ FIELD(TB_FLAGS, XL, 20, 2)
 /* If PointerMasking should be applied */
 FIELD(TB_FLAGS, PM_MASK_ENABLED, 22, 1)
 FIELD(TB_FLAGS, PM_BASE_ENABLED, 23, 1)
+/*
+ * State the translator would otherwise read from env. TBs may be translated
+ * by tb-spec worker threads, which must not touch the vCPU's env.
+ */
+FIELD(TB_FLAGS, VIRT_ENABLED, 24, 1)
+FIELD(TB_FLAGS, VSTART_EQ_ZERO, 25, 1)
+/* CHERI register access is enabled for the current mode */
+FIELD(TB_FLAGS, CRE, 26, 1)
 
 #ifdef TARGET_RISCV32
 #define riscv_cpu_mxl(env)  ((void)(env), MXL_RV32)
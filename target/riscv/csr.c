@@ -912,7 +912,7 @@ static RISCVException write_misa(CPURISCVState *env, int csrno,
 
     /* flush translation cache */
     tb_flush(env_cpu(env));
-    env->misa_ext = val;
+    qatomic_set(&env->misa_ext, val);
     env->xl = riscv_cpu_mxl(env);
     return RISCV_EXCP_NONE;
 }
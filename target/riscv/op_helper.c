@@ -194,18 +194,23 @@ static void do_cbo_zero(CPURISCVState *env, target_ulong address, uintptr_t ra)
         RAMBlock *r;
         ram_addr_t offs;
 
-        /* TODO: Memory update and tag change must be atomic. */
-        assert(!qemu_tcg_mttcg_enabled() ||
-                cpu_in_exclusive_context(env_cpu(env)));
-
         rcu_read_lock(); /* protect r from changes while we use it */
+        /*
+         * Like other data stores with MTTCG, clear the tags and write the
+         * data with the granules locked so that no capability load sees a
+         * tag from a racing capability store together with the zeroes.
+         */
+        cheri_tag_write_lock_range(mem, cbozlen);
         r = qemu_ram_block_from_host(mem, /* round to page? */ false, &offs);
         if (r) {
             cheri_tag_phys_invalidate(env, r, offs, cbozlen, NULL);
         }
-        rcu_read_unlock();
 #endif
         memset(mem, 0, cbozlen);
+#ifdef TARGET_CHERI
+        cheri_tag_write_unlock_range(mem, cbozlen);
+        rcu_read_unlock();
+#endif
     } else {
         /*
          * This means that we're dealing with an I/O page. Section 4.2
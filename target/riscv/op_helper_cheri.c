@@ -280,9 +280,6 @@ void HELPER(amoswap_cap)(CPUArchState *env, uint32_t dest_reg,
                          uint32_t addr_reg, uint32_t val_reg)
 {
     uintptr_t _host_return_address = GETPC();
-    assert(!qemu_tcg_mttcg_enabled() ||
-           (cpu_in_exclusive_context(env_cpu(env)) &&
-            "Should have raised EXCP_ATOMIC"));
     target_long addr = get_capreg_cursor(env, addr_reg);
     if (!cheri_in_capmode(env)) {
         addr = cheri_ddc_relative_addr(env, addr);
@@ -325,12 +322,20 @@ void HELPER(amoswap_cap)(CPUArchState *env, uint32_t dest_reg,
     // load_cap_from_memory call overwrites that register
     target_ulong loaded_pesbt;
     target_ulong loaded_cursor;
-    bool loaded_tag =
-        load_cap_from_memory_raw(env, &loaded_pesbt, &loaded_cursor, addr_reg,
-                                 cbp, addr, _host_return_address, NULL);
-    // The store may still trap, so we must only update the dest register after
-    // the store succeeded.
-    store_cap_to_memory(env, val_reg, addr_reg, addr, _host_return_address);
+    bool loaded_tag;
+    if (cap_rmw_needs_atomic(env)) {
+        loaded_tag = xchg_cap_in_memory(env, val_reg, addr_reg, cbp, addr,
+                                        _host_return_address, &loaded_pesbt,
+                                        &loaded_cursor);
+    } else {
+        loaded_tag = load_cap_from_memory_raw(env, &loaded_pesbt,
+                                              &loaded_cursor, addr_reg, cbp,
+                                              addr, _host_return_address, NULL);
+        // The store may still trap, so we must only update the dest register
+        // after the store succeeded.
+        store_cap_to_memory(env, val_reg, addr_reg, addr,
+                            _host_return_address);
+    }
     // Store succeeded -> we can update cd
     update_compressed_capreg(env, dest_reg, loaded_pesbt, loaded_tag,
                              loaded_cursor);
@@ -339,9 +344,6 @@ void HELPER(amoswap_cap)(CPUArchState *env, uint32_t dest_reg,
 static void lr_c_impl(CPUArchState *env, uint32_t dest_reg, uint32_t auth_reg,
                       target_ulong addr, uintptr_t _host_return_address)
 {
-    assert(!qemu_tcg_mttcg_enabled() ||
-           (cpu_in_exclusive_context(env_cpu(env)) &&
-            "Should have raised EXCP_ATOMIC"));
     const cap_register_t *cbp = get_load_store_base_cap(env, auth_reg);
     if (!cbp->cr_tag) {
         raise_cheri_exception(env, CapEx_TagViolation, auth_reg);
@@ -363,34 +365,28 @@ static void lr_c_impl(CPUArchState *env, uint32_t dest_reg, uint32_t auth_reg,
     }
     /*
      * For the reservation, we need the raw memory content without any fixups
-     * (tag clearing, W stripped due to missing LM, ...).
+     * (tag clearing, W stripped due to missing LM, ...), whereas cd gets the
+     * value with fixups applied. Both must come from a single access: with
+     * MTTCG, a second load could observe an A->B->A change and the SC would
+     * then succeed against data that this LR never returned.
      */
     target_ulong pesbt;
     target_ulong cursor;
-    bool tag = load_raw_cap_from_memory(env, &pesbt, &cursor, addr,
-                                        _host_return_address);
+    target_ulong raw_pesbt;
+    bool raw_tag;
+    bool tag = load_cap_from_memory_with_raw(env, &pesbt, &cursor, auth_reg,
+                                             cbp, addr, _host_return_address,
+                                             &raw_pesbt, &raw_tag);
     /* If this didn't trap, update the lr state: */
     env->load_res = addr;
     env->load_val = cursor;
-    env->load_pesbt = pesbt;
-    env->load_tag = tag;
+    env->load_pesbt = raw_pesbt;
+    env->load_tag = raw_tag;
     log_changed_special_reg(env, "load_res", env->load_res, ~0u, 0);
     log_changed_special_reg(env, "load_val", env->load_val, ~0u, 0);
     log_changed_special_reg(env, "load_pesbt", env->load_pesbt, ~0u, 0);
     log_changed_special_reg(env, "load_tag", (target_ulong)env->load_tag, ~0u,
                             0);
-    /*
-     * For the memory content that we store in cd, we have to read and apply
-     * the fixups.
-     *
-     * TODO: This is inefficient. We may have to review the format of the
-     * internal reservation.
-     *
-     * TODO: Could load_cap_from_memory_raw return an indication if fixups had
-     * to be applied or not?
-     */
-    tag = load_cap_from_memory_raw(env, &pesbt, &cursor, auth_reg, cbp, addr,
-                                   _host_return_address, NULL);
     update_compressed_capreg(env, dest_reg, pesbt, tag, cursor);
 }
 
@@ -422,9 +418,6 @@ static target_ulong sc_c_impl(CPUArchState *env, uint32_t addr_reg,
                               uint32_t val_reg, target_ulong addr,
                               uintptr_t _host_return_address)
 {
-    assert(!qemu_tcg_mttcg_enabled() ||
-        (cpu_in_exclusive_context(env_cpu(env)) &&
-            "Should have raised EXCP_ATOMIC"));
     const cap_register_t *auth_cap = get_load_store_base_cap(env, addr_reg);
 
     if (!auth_cap->cr_tag) {
@@ -459,12 +452,32 @@ static target_ulong sc_c_impl(CPUArchState *env, uint32_t addr_reg,
     // Clear the load reservation, since an SC must fail if there is
     // an SC to any address, in between an LR and SC pair.
     // We do this regardless of success/failure.
-    env->load_res = -1;
-    log_changed_special_reg(env, "load_res", env->load_res, ~0u, 0);
     if (addr != expected_addr) {
+        env->load_res = -1;
+        log_changed_special_reg(env, "load_res", env->load_res, ~0u, 0);
         goto sc_failed;
     }
 
+    if (cap_rmw_needs_atomic(env)) {
+        /*
+         * Compare and store atomically with respect to the other vCPUs. This
+         * may restart the SC in an exclusive context, so the reservation must
+         * only be cleared once the compare-and-swap has happened.
+         */
+        bool stored = cmpxchg_cap_in_memory(env, val_reg, addr_reg, addr,
+                                            _host_return_address,
+                                            env->load_pesbt, env->load_val,
+                                            env->load_tag);
+        env->load_res = -1;
+        log_changed_special_reg(env, "load_res", env->load_res, ~0u, 0);
+        if (!stored) {
+            goto sc_failed;
+        }
+        return 0; // success
+    }
+    env->load_res = -1;
+    log_changed_special_reg(env, "load_res", env->load_res, ~0u, 0);
+
 #ifdef CONFIG_RVFI_DII
     /* The read that is part of the cmpxchg should not be visible in traces. */
     uint32_t old_rmask = env->rvfi_dii_trace.MEM.rvfi_mem_rmask;
@@ -38,6 +38,7 @@
 #define _RISCV_RVFI_DII_H
 
 #include <stdint.h>
+#include "qemu/atomic.h"
 
 /// The old trace packet for backwards compatibility with older TestRIG versions:
 struct rvfi_dii_trace_v1 {
@@ -227,4 +228,122 @@ typedef struct rvfi_dii_command {
     uint8_t padding;
 } QEMU_PACKED rvfi_dii_command_t; // 8 bytes
 
+/*
+ * Shared-memory transport (negotiated with the 's' command on the socket).
+ *
+ * The shared file starts with a struct rvfi_dii_shm_header followed by two
+ * single-producer/single-consumer byte rings. The command ring carries
+ * rvfi_dii_command_t entries from the client to QEMU, so that a whole
+ * instruction sequence can be queued at once. The trace ring carries exactly
+ * the same byte stream (version responses and v1/v2 traces) that would
+ * otherwise be sent over the socket.
+ */
+#define RVFI_DII_SHM_MAGIC "rvfi-shm"
+#define RVFI_DII_SHM_CMD_RING_SIZE (64 * 1024)
+#define RVFI_DII_SHM_TRACE_RING_SIZE (1024 * 1024)
+
+struct rvfi_dii_ring {
+    uint64_t head;        // Total bytes written, only updated by the producer
+    uint64_t pad0[7];     // Keep head and tail on separate cache lines
+    uint64_t tail;        // Total bytes read, only updated by the consumer
+    uint64_t pad1[7];
+    uint64_t size;        // Size of the data area, must be a power of two
+    uint64_t data_offset; // Offset of the data from the start of the header
+    uint64_t pad2[6];
+};
+
+struct rvfi_dii_shm_header {
+    char magic[8];                 // must be "rvfi-shm"
+    uint64_t total_size;           // Size of the whole mapping
+    uint64_t pad[6];
+    struct rvfi_dii_ring commands; // Client -> QEMU
+    struct rvfi_dii_ring traces;   // QEMU -> client
+};
+
+#define RVFI_DII_SHM_SIZE                                                      \
+    (4096 + RVFI_DII_SHM_CMD_RING_SIZE + RVFI_DII_SHM_TRACE_RING_SIZE)
+
+static inline void rvfi_dii_shm_init(struct rvfi_dii_shm_header *shm)
+{
+    memset(shm, 0, sizeof(*shm));
+    memcpy(shm->magic, RVFI_DII_SHM_MAGIC, sizeof(shm->magic));
+    shm->total_size = RVFI_DII_SHM_SIZE;
+    shm->commands.size = RVFI_DII_SHM_CMD_RING_SIZE;
+    shm->commands.data_offset = 4096;
+    shm->traces.size = RVFI_DII_SHM_TRACE_RING_SIZE;
+    shm->traces.data_offset = 4096 + RVFI_DII_SHM_CMD_RING_SIZE;
+}
+
+/*
+ * A ring as seen by one side. The geometry is copied out of the shared header
+ * and checked once by rvfi_dii_ring_attach(), so that the other side cannot
+ * make later accesses go out of bounds by changing it.
+ */
+struct rvfi_dii_ring_map {
+    struct rvfi_dii_ring *ring; // Only head and tail are read from here
+    uint8_t *data;
+    uint64_t size;
+};
+
+/*
+ * Sets up map for one of the rings in the map_size bytes mapped at shm.
+ * Returns false if the header describes a ring outside of the mapping or one
+ * whose size is not a power of two.
+ */
+static inline bool rvfi_dii_ring_attach(struct rvfi_dii_ring_map *map,
+                                        struct rvfi_dii_shm_header *shm,
+                                        struct rvfi_dii_ring *ring,
+                                        uint64_t map_size)
+{
+    uint64_t size = ring->size;
+    uint64_t offset = ring->data_offset;
+
+    if (size == 0 || (size & (size - 1)) != 0 || offset < sizeof(*shm) ||
+        offset > map_size || size > map_size - offset) {
+        return false;
+    }
+    map->ring = ring;
+    map->data = (uint8_t *)shm + offset;
+    map->size = size;
+    return true;
+}
+
+/* Returns the number of bytes that can currently be read from the ring */
+static inline uint64_t rvfi_dii_ring_used(const struct rvfi_dii_ring_map *map)
+{
+    uint64_t used = qatomic_load_acquire(&map->ring->head) - map->ring->tail;
+    return MIN(used, map->size);
+}
+
+/* Copies up to len bytes into the ring, returns the number of bytes written */
+static inline size_t rvfi_dii_ring_write(struct rvfi_dii_ring_map *map,
+                                         const void *data, size_t len)
+{
+    uint64_t head = map->ring->head;
+    uint64_t used = head - qatomic_load_acquire(&map->ring->tail);
+    size_t n = MIN(len, map->size - MIN(used, map->size));
+    size_t start = head & (map->size - 1);
+    size_t first = MIN(n, map->size - start);
+
+    memcpy(map->data + start, data, first);
+    memcpy(map->data, (const uint8_t *)data + first, n - first);
+    qatomic_store_release(&map->ring->head, head + n);
+    return n;
+}
+
+/* Copies up to len bytes out of the ring, returns the number of bytes read */
+static inline size_t rvfi_dii_ring_read(struct rvfi_dii_ring_map *map,
+                                        void *data, size_t len)
+{
+    uint64_t tail = map->ring->tail;
+    size_t n = MIN(len, rvfi_dii_ring_used(map));
+    size_t start = tail & (map->size - 1);
+    size_t first = MIN(n, map->size - start);
+
+    memcpy(data, map->data + start, first);
+    memcpy((uint8_t *)data + first, map->data, n - first);
+    qatomic_store_release(&map->ring->tail, tail + n);
+    return n;
+}
+
 #endif
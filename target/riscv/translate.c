@@ -113,7 +113,7 @@ typedef struct DisasContext {
      */
     int8_t lmul;
     uint8_t sew;
-    target_ulong vstart;
+    bool vstart_eq_zero;
     bool vl_eq_vlmax;
     uint8_t ntemp;
     CPUState *cs;
@@ -126,6 +126,8 @@ typedef struct DisasContext {
     /* PointerMasking extension */
     bool pm_mask_enabled;
     bool pm_base_enabled;
+    /* Bitmask of the goto_tb slots already emitted in this TB */
+    uint8_t goto_tb_used;
 } DisasContext;
 
 #ifdef CONFIG_DEBUG_TCG
@@ -281,7 +283,13 @@ static void gen_goto_tb(DisasContext *ctx, int n, target_ulong dest,
     if (bounds_check)
         gen_check_branch_target(ctx, dest);
 
-    if (translator_use_goto_tb(&ctx->base, dest)) {
+    /*
+     * A TB only has two chainable exits. Once a side exit (see gen_branch)
+     * has taken a slot, later exits through it go via the TB lookup.
+     */
+    if (translator_use_goto_tb(&ctx->base, dest) &&
+        !(ctx->goto_tb_used & (1 << n))) {
+        ctx->goto_tb_used |= 1 << n;
         tcg_gen_goto_tb(n);
         gen_set_pc_imm(ctx, dest);
         tcg_gen_exit_tb(ctx->base.tb, n);
@@ -639,6 +647,15 @@ static void gen_set_fpr_d(DisasContext *ctx, int reg_num, TCGv_i64 t)
     }
 }
 
+/*
+ * x1 and x5 are link registers for return address stack prediction, see
+ * the JALR hints in the unprivileged ISA.
+ */
+static inline bool is_link_reg(int reg)
+{
+    return reg == 1 || reg == 5;
+}
+
 static void gen_jal(DisasContext *ctx, int rd, target_ulong imm)
 {
     target_ulong next_pc;
@@ -654,6 +671,9 @@ static void gen_jal(DisasContext *ctx, int rd, target_ulong imm)
     }
     /* For CHERI ISAv8 the result is an offset relative to PCC.base */
     gen_set_gpr_const(ctx, rd, ctx->pc_succ_insn - pcc_reloc(ctx));
+    if (is_link_reg(rd)) {
+        translator_push_return(&ctx->base, ctx->pc_succ_insn);
+    }
 
     gen_goto_tb(ctx, 0, ctx->base.pc_next + imm, /*bounds_check=*/true); /* must use this for safety */
     ctx->base.is_jmp = DISAS_NORETURN;
@@ -684,8 +704,15 @@ static void gen_jalr(DisasContext *ctx, int rd, int rs1, target_ulong imm)
 
     /* For CHERI ISAv8 the result is an offset relative to PCC.base */
     gen_set_gpri(ctx, rd, ctx->pc_succ_insn - pcc_reloc(ctx));
-    /* No chaining with JALR. */
-    tcg_gen_lookup_and_goto_ptr();
+    /* No chaining with JALR, but it only changes the pc. */
+    if (is_link_reg(rd)) {
+        translator_push_return(&ctx->base, ctx->pc_succ_insn);
+        translator_lookup_and_goto_ptr(&ctx->base, cpu_pc);
+    } else if (is_link_reg(rs1)) {
+        translator_return_and_goto_ptr(&ctx->base, cpu_pc, -1);
+    } else {
+        translator_lookup_and_goto_ptr(&ctx->base, cpu_pc);
+    }
 
     if (misaligned) {
         gen_set_label(misaligned);
@@ -1242,7 +1269,8 @@ static uint32_t opcode_at(DisasContextBase *dcbase, target_ulong pc)
 static inline TCGv_cap_checked_ptr _get_capmode_dependent_addr(
     DisasContext *ctx, int reg_num, target_long regoffs,
 #ifdef TARGET_CHERI
-    void (*gen_check_cap)(TCGv_cap_checked_ptr, uint32_t, target_long, MemOp),
+    void (*gen_check_cap)(TCGv_cap_checked_ptr, DisasContext *, uint32_t,
+                          target_long, MemOp),
     void (*check_ddc)(TCGv_cap_checked_ptr, DisasContext *, TCGv, target_ulong),
 #endif
     MemOp mop)
@@ -1252,7 +1280,7 @@ static inline TCGv_cap_checked_ptr _get_capmode_dependent_addr(
 #ifdef TARGET_CHERI
     // XXX-AM: Unsupported pointer masking extensions
     if (ctx->capmode) {
-        gen_check_cap(result, reg_num, regoffs, mop);
+        gen_check_cap(result, ctx, reg_num, regoffs, mop);
     } else {
         generate_get_ddc_checked_gpr_plus_offset(result, ctx, reg_num, regoffs,
                                                  mop, check_ddc);
@@ -1426,19 +1454,16 @@ static void riscv_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     ctx->cheri_v9_semantics = cpu->cfg.ext_cheri_v9;
 #endif
     ctx->hybrid = riscv_feature(env, RISCV_FEATURE_CHERI_HYBRID);
-    ctx->cre = riscv_cpu_mode_cre(env);
+    ctx->cre = FIELD_EX32(tb_flags, TB_FLAGS, CRE);
 #endif
     ctx->priv_ver = env->priv_ver;
-#if !defined(CONFIG_USER_ONLY)
-    if (riscv_has_ext(env, RVH)) {
-        ctx->virt_enabled = riscv_cpu_virt_enabled(env);
-    } else {
-        ctx->virt_enabled = false;
-    }
-#else
-    ctx->virt_enabled = false;
-#endif
-    ctx->misa_ext = env->misa_ext;
+    ctx->virt_enabled = FIELD_EX32(tb_flags, TB_FLAGS, VIRT_ENABLED);
+    /*
+     * The remaining env fields are fixed at realize time, except misa_ext.
+     * A write to misa flushes all TBs, including any that a tb-spec worker is
+     * translating with the old value, so an atomic read is enough here.
+     */
+    ctx->misa_ext = qatomic_read(&env->misa_ext);
     ctx->frm = -1;  /* unknown rounding mode */
     ctx->cfg_ptr = &(cpu->cfg);
     ctx->mstatus_hs_fs = FIELD_EX32(tb_flags, TB_FLAGS, MSTATUS_HS_FS);
@@ -1447,7 +1472,7 @@ static void riscv_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     ctx->vill = FIELD_EX32(tb_flags, TB_FLAGS, VILL);
     ctx->sew = FIELD_EX32(tb_flags, TB_FLAGS, SEW);
     ctx->lmul = sextract32(FIELD_EX32(tb_flags, TB_FLAGS, LMUL), 0, 3);
-    ctx->vstart = env->vstart;
+    ctx->vstart_eq_zero = FIELD_EX32(tb_flags, TB_FLAGS, VSTART_EQ_ZERO);
     ctx->vl_eq_vlmax = FIELD_EX32(tb_flags, TB_FLAGS, VL_EQ_VLMAX);
     ctx->misa_mxl_max = env->misa_mxl_max;
     ctx->xl = FIELD_EX32(tb_flags, TB_FLAGS, XL);
@@ -1458,6 +1483,7 @@ static void riscv_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     memset(ctx->ftemp, 0, sizeof(ctx->ftemp));
     ctx->pm_mask_enabled = FIELD_EX32(tb_flags, TB_FLAGS, PM_MASK_ENABLED);
     ctx->pm_base_enabled = FIELD_EX32(tb_flags, TB_FLAGS, PM_BASE_ENABLED);
+    ctx->goto_tb_used = 0;
     ctx->zero = tcg_constant_tl(0);
 }
 
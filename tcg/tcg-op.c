@@ -2974,6 +2974,35 @@ void handle_conditional_invalidate(TCGv_cap_checked_ptr checked_addr,
 #endif
 }
 
+/*
+ * In parallel TBs atomics write their data with the granule's tag
+ * write-locked (see cheri_tag_store_begin()), so that a concurrent capability
+ * load cannot pair it with the tag of a racing capability store. Plain stores
+ * do the same in the slow path for pages that have tags (see
+ * cheri_tag_stores_locked()), so their fast path needs no helper call.
+ */
+static void gen_cheri_tag_store_begin(TCGv_cap_checked_ptr addr, MemOp memop,
+                                      TCGArg idx)
+{
+#if defined(TARGET_CHERI)
+    tcg_debug_assert(tcg_ctx->tb_cflags & CF_PARALLEL);
+    gen_helper_cheri_tag_store_begin(
+        cpu_env, addr, tcg_constant_i32(make_memop_idx(memop, idx)));
+#endif
+}
+
+/*
+ * Clear the tags after an atomic (if @stored is NULL or non-zero at runtime)
+ * and unlock them again.
+ */
+static void gen_cheri_tag_store_end(TCGv_i32 stored)
+{
+#if defined(TARGET_CHERI)
+    gen_helper_cheri_tag_store_end(cpu_env,
+                                   stored ? stored : tcg_constant_i32(1));
+#endif
+}
+
 static void tcg_gen_qemu_st_i32_with_checked_addr_cond_invalidate(
     TCGv_i32 val, TCGv_cap_checked_ptr addr, TCGArg idx, MemOp memop,
     bool invalidate)
@@ -3017,7 +3046,8 @@ static void tcg_gen_qemu_st_i32_with_checked_addr_cond_invalidate(
     }
 #endif
 #if defined(TARGET_CHERI)
-    if (invalidate) {
+    /* See gen_cheri_tag_store_begin() for parallel TBs. */
+    if (invalidate && !(tcg_ctx->tb_cflags & CF_PARALLEL)) {
         gen_helper_cheri_invalidate_tags(cpu_env, addr, tcoi);
     }
 #endif
@@ -3164,7 +3194,8 @@ void tcg_gen_qemu_st_i64_with_checked_addr_cond_invalidate(
     }
 #endif
 #if defined(TARGET_CHERI)
-    if (invalidate) {
+    /* See gen_cheri_tag_store_begin() for parallel TBs. */
+    if (invalidate && !(tcg_ctx->tb_cflags & CF_PARALLEL)) {
         gen_helper_cheri_invalidate_tags(cpu_env, addr, tcoi);
     }
 #endif
@@ -3294,7 +3325,6 @@ void tcg_gen_atomic_cmpxchg_i32_with_checked_addr(
         }
         tcg_temp_free_i32(t1);
     } else {
-        ASSERT_IF_CHERI();
         gen_atomic_cx_i32 gen;
         MemOpIdx oi;
 
@@ -3302,7 +3332,19 @@ void tcg_gen_atomic_cmpxchg_i32_with_checked_addr(
         tcg_debug_assert(gen != NULL);
 
         oi = make_memop_idx(memop & ~MO_SIGN, idx);
+        gen_cheri_tag_store_begin(checked_addr, memop, idx);
         gen(retv, cpu_env, (TCGv)checked_addr, cmpv, newv, tcg_constant_i32(oi));
+#ifdef TARGET_CHERI
+        /* The store happened iff the old value matched. */
+        TCGv_i32 equal = tcg_temp_new_i32();
+        tcg_gen_ext_i32(equal, cmpv, memop & MO_SIZE);
+        tcg_gen_setcond_i32(TCG_COND_EQ, equal, retv, equal);
+        gen_cheri_tag_store_end(equal);
+        tcg_temp_free_i32(equal);
+#endif
+#if defined(TARGET_MIPS) || defined(TARGET_RISCV)
+        gen_cheri_break_loadlink(checked_addr);
+#endif
 
         if (memop & MO_SIGN) {
             tcg_gen_ext_i32(retv, retv, memop);
@@ -3346,7 +3388,6 @@ void tcg_gen_atomic_cmpxchg_i64_with_checked_addr(
         }
         tcg_temp_free_i64(t1);
     } else if ((memop & MO_SIZE) == MO_64) {
-        ASSERT_IF_CHERI();
 #ifdef CONFIG_ATOMIC64
         gen_atomic_cx_i64 gen;
         MemOpIdx oi;
@@ -3355,7 +3396,21 @@ void tcg_gen_atomic_cmpxchg_i64_with_checked_addr(
         tcg_debug_assert(gen != NULL);
 
         oi = make_memop_idx(memop, idx);
+        gen_cheri_tag_store_begin(checked_addr, memop, idx);
         gen(retv, cpu_env, (TCGv)checked_addr, cmpv, newv, tcg_constant_i32(oi));
+#ifdef TARGET_CHERI
+        /* The store happened iff the old value matched. */
+        TCGv_i64 equal64 = tcg_temp_new_i64();
+        TCGv_i32 equal = tcg_temp_new_i32();
+        tcg_gen_setcond_i64(TCG_COND_EQ, equal64, retv, cmpv);
+        tcg_gen_extrl_i64_i32(equal, equal64);
+        gen_cheri_tag_store_end(equal);
+        tcg_temp_free_i32(equal);
+        tcg_temp_free_i64(equal64);
+#endif
+#if defined(TARGET_MIPS) || defined(TARGET_RISCV)
+        gen_cheri_break_loadlink(checked_addr);
+#endif
 #else
         gen_helper_exit_atomic(cpu_env);
         /* Produce a result, so that we have a well-formed opcode stream
@@ -3363,7 +3418,6 @@ void tcg_gen_atomic_cmpxchg_i64_with_checked_addr(
         tcg_gen_movi_i64(retv, 0);
 #endif /* CONFIG_ATOMIC64 */
     } else {
-        ASSERT_IF_CHERI();
         TCGv_i32 c32 = tcg_temp_new_i32();
         TCGv_i32 n32 = tcg_temp_new_i32();
         TCGv_i32 r32 = tcg_temp_new_i32();
@@ -3435,22 +3489,18 @@ static void do_atomic_op_i32(TCGv_i32 ret, TCGv_cap_checked_ptr checked_addr,
                              TCGv_i32 val, TCGArg idx, MemOp memop,
                              void *const table[])
 {
-    ASSERT_IF_CHERI();
     gen_atomic_op_i32 gen;
     MemOpIdx oi;
 
     memop = tcg_canonicalize_memop(memop, 0, 0);
+    gen_cheri_tag_store_begin(checked_addr, memop, idx);
 
     gen = table[memop & (MO_SIZE | MO_BSWAP)];
     tcg_debug_assert(gen != NULL);
 
     oi = make_memop_idx(memop & ~MO_SIGN, idx);
     gen(ret, cpu_env, (TCGv)checked_addr, val, tcg_constant_i32(oi));
-#if defined(TARGET_CHERI)
-    TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
-    gen_helper_cheri_invalidate_tags(cpu_env, checked_addr, tcoi);
-    tcg_temp_free_i32(tcoi);
-#endif
+    gen_cheri_tag_store_end(NULL);
 #if defined(TARGET_MIPS) || defined(TARGET_RISCV)
     gen_cheri_break_loadlink(checked_addr);
 #endif
@@ -3486,18 +3536,20 @@ static void do_atomic_op_i64(TCGv_i64 ret, TCGv_cap_checked_ptr checked_addr,
                              TCGv_i64 val, TCGArg idx, MemOp memop,
                              void *const table[])
 {
-    ASSERT_IF_CHERI();
     memop = tcg_canonicalize_memop(memop, 1, 0);
     if ((memop & MO_SIZE) == MO_64) {
 #ifdef CONFIG_ATOMIC64
         gen_atomic_op_i64 gen;
         MemOpIdx oi;
 
+        gen_cheri_tag_store_begin(checked_addr, memop, idx);
+
         gen = table[memop & (MO_SIZE | MO_BSWAP)];
         tcg_debug_assert(gen != NULL);
 
         oi = make_memop_idx(memop & ~MO_SIGN, idx);
         gen(ret, cpu_env, (TCGv)checked_addr, val, tcg_constant_i32(oi));
+        gen_cheri_tag_store_end(NULL);
 #else
         gen_helper_exit_atomic(cpu_env);
         /* Produce a result, so that we have a well-formed opcode stream
@@ -3519,11 +3571,6 @@ static void do_atomic_op_i64(TCGv_i64 ret, TCGv_cap_checked_ptr checked_addr,
             tcg_gen_ext_i64(ret, ret, memop);
         }
     }
-#if defined(TARGET_CHERI)
-    TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
-    gen_helper_cheri_invalidate_tags(cpu_env, checked_addr, tcoi);
-    tcg_temp_free_i32(tcoi);
-#endif
 #if defined(TARGET_MIPS) || defined(TARGET_RISCV)
     gen_cheri_break_loadlink(checked_addr);
 #endif
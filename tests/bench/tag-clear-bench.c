@@ -0,0 +1,134 @@
+/*
+ * Throughput of CHERI tag invalidation for DMA-sized writes.
+ *
+ * Every write to guest RAM that does not come from a vCPU (virtio and other
+ * DMA, qtest) clears the tags of the written range in
+ * invalidate_and_set_dirty() via cheri_tag_phys_invalidate(). This runs a
+ * CHERI system emulator under qtest and times that function for writes from
+ * 4 KiB to 2 MiB, both to RAM whose tag blocks are populated and to RAM that
+ * never held a tag. Run it with QTEST_QEMU_BINARY pointing to the emulator:
+ *
+ *   QTEST_QEMU_BINARY=./qemu-system-riscv64xcheri tests/bench/tag-clear-bench
+ *
+ * Only the first invalidation of a range actually clears tags, but the cost
+ * of clearing a populated block does not depend on which tags are set.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "../qtest/libqos/libqtest.h"
+
+#define MIN_WRITE_SIZE (4 * KiB)
+#define MAX_WRITE_SIZE (2 * MiB)
+
+/* Bytes invalidated per qtest command, to amortize the round trip */
+#define BYTES_PER_COMMAND (256 * MiB)
+
+/* Offsets into guest RAM of the two ranges that are written */
+#define POPULATED_OFFSET   (16 * MiB)
+#define UNPOPULATED_OFFSET (64 * MiB)
+
+static unsigned int duration_ms = 200;
+static unsigned int offset;
+static uint64_t ram_base = 0x80000000;
+static const char *machine_args = "-machine virt -bios none -m 128M";
+
+static const char commands_string[] =
+    " -d = duration of each test in milliseconds\n"
+    " -o = offset of the write from a page boundary in bytes\n"
+    " -r = guest physical address of RAM (default: 0x80000000)\n"
+    " -M = QEMU arguments (default: \"-machine virt -bios none -m 128M\")";
+
+static void usage_complete(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+/* Returns the throughput in bytes of guest writes per second */
+static double run_test(QTestState *qts, uint64_t addr, size_t size)
+{
+    uint64_t count = MAX(1, BYTES_PER_COMMAND / size);
+    int64_t begin = g_get_monotonic_time();
+    int64_t end = begin + duration_ms * 1000ll;
+    int64_t now;
+    uint64_t iterations = 0;
+
+    do {
+        qtest_cheri_tag_invalidate(qts, addr + offset, size, count);
+        iterations += count;
+        now = g_get_monotonic_time();
+    } while (now < end);
+
+    return (double)iterations * size * G_USEC_PER_SEC / (now - begin);
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "hd:o:r:M:");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            usage_complete(argv);
+            exit(0);
+        case 'd':
+            duration_ms = atoi(optarg);
+            break;
+        case 'o':
+            offset = atoi(optarg);
+            break;
+        case 'r':
+            ram_base = g_ascii_strtoull(optarg, NULL, 0);
+            break;
+        case 'M':
+            machine_args = optarg;
+            break;
+        default:
+            usage_complete(argv);
+            exit(1);
+        }
+    }
+    if (offset >= MAX_WRITE_SIZE) {
+        usage_complete(argv);
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t populated, unpopulated;
+    QTestState *qts;
+
+    parse_args(argc, argv);
+    populated = ram_base + POPULATED_OFFSET;
+    unpopulated = ram_base + UNPOPULATED_OFFSET;
+    qts = qtest_init(machine_args);
+
+    /* Tag one capability per page so that all tag blocks are populated */
+    for (uint64_t addr = 0; addr < 2 * MAX_WRITE_SIZE; addr += 4 * KiB) {
+        qtest_cheri_tag_set(qts, populated + addr);
+    }
+
+    printf("Parameters:\n");
+    printf(" write offset:      %u\n", offset);
+    printf(" duration:          %u ms\n", duration_ms);
+    printf("Results (GiB/s of guest writes):\n");
+    printf(" %10s %14s %14s\n", "size", "populated", "unpopulated");
+    for (size_t size = MIN_WRITE_SIZE; size <= MAX_WRITE_SIZE; size *= 2) {
+        double used = run_test(qts, populated, size);
+        double unused = run_test(qts, unpopulated, size);
+
+        printf(" %8zu K %14.2f %14.2f\n", size / KiB, used / GiB,
+               unused / GiB);
+    }
+
+    qtest_quit(qts);
+    return 0;
+}
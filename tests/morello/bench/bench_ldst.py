@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""
+Compare Morello load/store throughput between QEMU binaries.
+
+Builds ldst-loop.S in its capability-base (purecap) and DDC-relative (hybrid)
+variants and reports the throughput in millions of guest instructions per
+second for each QEMU binary passed with --qemu, e.g. a build from before and
+after a change to the TCG capability checks.
+"""
+import argparse
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+qemu_args = "-machine morello -nographic -serial none -monitor none -kernel".split()
+# Two loads, two stores, an add, subs and b.ne
+INSNS_PER_ITERATION = 7
+bench_dir = Path(__file__).parent.absolute()
+
+
+def build(cc: str, out: Path, iterations: int, hybrid: bool) -> Path:
+    command = [cc, "-target", "aarch64-none-elf", "-march=morello",
+               "-nostdlib", "-static", "-fuse-ld=lld",
+               "-Wl,-T," + str(bench_dir / "kernel.ld"),
+               "-DITERATIONS=" + str(iterations),
+               str(bench_dir / "ldst-loop.S"), "-o", str(out)]
+    if hybrid:
+        command.insert(1, "-DHYBRID")
+    subprocess.check_call(command)
+    return out
+
+
+def run(qemu: Path, elf: Path, repeat: int) -> float:
+    best = None
+    for _ in range(repeat):
+        start = time.monotonic()
+        sp = subprocess.run([str(qemu), *qemu_args, str(elf)],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        elapsed = time.monotonic() - start
+        if not sp.stdout.rstrip().endswith(b"OK"):
+            sys.exit("{} did not complete:\n{}{}".format(
+                elf.name, sp.stdout.decode("utf-8"),
+                sp.stderr.decode("utf-8")))
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--qemu", type=Path, action="append", required=True,
+                        help="Path to qemu-system-morello (can be repeated)")
+    parser.add_argument("--cc", default="clang",
+                        help="Morello-capable clang used to build the loop")
+    parser.add_argument("--iterations", type=int, default=100000000)
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="Report the best of this many runs")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        elfs = {
+            "purecap": build(args.cc, Path(tmp, "purecap.elf"),
+                             args.iterations, hybrid=False),
+            "hybrid": build(args.cc, Path(tmp, "hybrid.elf"),
+                            args.iterations, hybrid=True),
+        }
+        insns = args.iterations * INSNS_PER_ITERATION
+        print("{:>50} {:>10} {:>10}".format("MIPS", *elfs.keys()))
+        for qemu in args.qemu:
+            mips = [insns / run(qemu, elf, args.repeat) / 1e6
+                    for elf in elfs.values()]
+            print("{:>50} {:10.1f} {:10.1f}".format(str(qemu)[-50:], *mips))
+
+
+if __name__ == "__main__":
+    main()
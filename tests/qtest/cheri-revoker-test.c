@@ -0,0 +1,192 @@
+/*
+ * QTest testcase for the CHERI revocation sweep device
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2 or later, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest-single.h"
+#include "../../target/cheri-common/cheri-compressed-cap/cheri_compressed_cap.h"
+
+/* RISC-V virt board, 64-bit CHERI (CHERI-128 capability encoding) */
+#define REVOKER_BASE 0x102000
+#define RAM_BASE     0x80000000ULL
+#define CAP_SIZE     CC128_CAP_SIZE
+
+/* See include/hw/riscv/revoker.h */
+#define REVOKER_REGION_SIZE 0x1000
+#define REVOKER_ID_VALUE 0x454b4f5645524301ULL
+#define REVOKER_ID          0x00
+#define REVOKER_SWEEP_START 0x08
+#define REVOKER_SWEEP_END   0x10
+#define REVOKER_BITMAP_ADDR 0x18
+#define REVOKER_BITMAP_BASE 0x20
+#define REVOKER_BITMAP_SIZE 0x28
+#define REVOKER_CTRL        0x30
+#define REVOKER_STATUS      0x38
+#define REVOKER_SCANNED     0x40
+#define REVOKER_REVOKED     0x48
+
+#define REVOKER_CTRL_START 0x1
+
+#define REVOKER_STATUS_OK         0x0
+#define REVOKER_STATUS_BAD_BITMAP 0x1
+#define REVOKER_STATUS_BAD_RANGE  0x2
+
+/* Capabilities to sweep, a second set lives in a different tag block */
+#define CAPS_ADDR    (RAM_BASE + 0x10000)
+#define FAR_CAP_ADDR (RAM_BASE + 0x200000)
+#define NCAPS        8
+
+/* Revocation bitmap and the allocations its bits cover */
+#define BITMAP_ADDR  (RAM_BASE + 0x1000)
+#define BITMAP_SIZE  0x100
+#define HEAP_BASE    (RAM_BASE + 0x100000)
+#define OBJ_SIZE     0x100
+
+static uint64_t revoker_readq(uint64_t reg)
+{
+    return readq(REVOKER_BASE + reg);
+}
+
+static void revoker_writeq(uint64_t reg, uint64_t value)
+{
+    writeq(REVOKER_BASE + reg, value);
+}
+
+/* Store an in-bounds capability to object @obj of the heap at @addr. */
+static void store_cap(uint64_t addr, unsigned obj, bool tagged)
+{
+    uint64_t base = HEAP_BASE + obj * OBJ_SIZE;
+    cc128_cap_t cap = cc128_make_max_perms_cap(base, base, base + OBJ_SIZE);
+
+    writeq(addr, base);
+    writeq(addr + 8, cc128_compress_mem(&cap));
+    /* The stores above clear the tag, so set it afterwards. */
+    if (tagged) {
+        qtest_cheri_tag_set(global_qtest, addr);
+    }
+    g_assert_cmpint(qtest_cheri_tag_get(global_qtest, addr), ==, tagged);
+}
+
+/* Mark object @obj of the heap as revoked. */
+static void revoke_obj(unsigned obj)
+{
+    uint64_t bit = obj * OBJ_SIZE / CAP_SIZE;
+    uint64_t addr = BITMAP_ADDR + bit / 8;
+
+    writeb(addr, readb(addr) | (1 << (bit % 8)));
+}
+
+static void start_sweep(uint64_t start, uint64_t end)
+{
+    revoker_writeq(REVOKER_SWEEP_START, start);
+    revoker_writeq(REVOKER_SWEEP_END, end);
+    revoker_writeq(REVOKER_BITMAP_ADDR, BITMAP_ADDR);
+    revoker_writeq(REVOKER_BITMAP_BASE, HEAP_BASE);
+    revoker_writeq(REVOKER_BITMAP_SIZE, BITMAP_SIZE);
+    revoker_writeq(REVOKER_CTRL, REVOKER_CTRL_START);
+    /* The sweep is synchronous and the start bit self-clearing */
+    g_assert_cmphex(revoker_readq(REVOKER_CTRL), ==, 0);
+}
+
+static void test_id(void)
+{
+    g_assert_cmphex(revoker_readq(REVOKER_ID), ==, REVOKER_ID_VALUE);
+    /* Read-only registers ignore writes */
+    revoker_writeq(REVOKER_ID, 0);
+    g_assert_cmphex(revoker_readq(REVOKER_ID), ==, REVOKER_ID_VALUE);
+}
+
+static void test_sweep(void)
+{
+    unsigned i;
+
+    qtest_memset(global_qtest, BITMAP_ADDR, 0, BITMAP_SIZE);
+    for (i = 0; i < NCAPS; i++) {
+        store_cap(CAPS_ADDR + i * CAP_SIZE, i, true);
+        if (i % 2) {
+            revoke_obj(i);
+        }
+    }
+    /* Revoked but untagged: neither scanned nor counted as revoked */
+    store_cap(CAPS_ADDR + NCAPS * CAP_SIZE, 1, false);
+    /* Revoked, in another tag block */
+    store_cap(FAR_CAP_ADDR, 3, true);
+    /* Tagged, revoked, but outside the sweep range */
+    store_cap(FAR_CAP_ADDR + 0x10000, 5, true);
+
+    start_sweep(CAPS_ADDR, FAR_CAP_ADDR + CAP_SIZE);
+
+    g_assert_cmphex(revoker_readq(REVOKER_STATUS), ==, REVOKER_STATUS_OK);
+    g_assert_cmpuint(revoker_readq(REVOKER_SCANNED), ==, NCAPS + 1);
+    g_assert_cmpuint(revoker_readq(REVOKER_REVOKED), ==, NCAPS / 2 + 1);
+    for (i = 0; i < NCAPS; i++) {
+        g_assert_cmpint(qtest_cheri_tag_get(global_qtest,
+                                            CAPS_ADDR + i * CAP_SIZE),
+                        ==, !(i % 2));
+    }
+    g_assert_false(qtest_cheri_tag_get(global_qtest,
+                                       CAPS_ADDR + NCAPS * CAP_SIZE));
+    g_assert_false(qtest_cheri_tag_get(global_qtest, FAR_CAP_ADDR));
+    g_assert_true(qtest_cheri_tag_get(global_qtest, FAR_CAP_ADDR + 0x10000));
+
+    /* A second sweep finds nothing left to revoke */
+    start_sweep(CAPS_ADDR, FAR_CAP_ADDR + CAP_SIZE);
+    g_assert_cmpuint(revoker_readq(REVOKER_SCANNED), ==, NCAPS / 2);
+    g_assert_cmpuint(revoker_readq(REVOKER_REVOKED), ==, 0);
+}
+
+static void test_bad_args(void)
+{
+    store_cap(CAPS_ADDR, 1, true);
+    revoke_obj(1);
+
+    /* The bitmap must be RAM */
+    revoker_writeq(REVOKER_BITMAP_ADDR, REVOKER_BASE);
+    revoker_writeq(REVOKER_BITMAP_BASE, HEAP_BASE);
+    revoker_writeq(REVOKER_BITMAP_SIZE, BITMAP_SIZE);
+    revoker_writeq(REVOKER_SWEEP_START, CAPS_ADDR);
+    revoker_writeq(REVOKER_SWEEP_END, CAPS_ADDR + CAP_SIZE);
+    revoker_writeq(REVOKER_CTRL, REVOKER_CTRL_START);
+    g_assert_cmphex(revoker_readq(REVOKER_STATUS), ==,
+                    REVOKER_STATUS_BAD_BITMAP);
+    g_assert_cmpuint(revoker_readq(REVOKER_REVOKED), ==, 0);
+    g_assert_true(qtest_cheri_tag_get(global_qtest, CAPS_ADDR));
+
+    /* So must the sweep range */
+    start_sweep(REVOKER_BASE, REVOKER_BASE + REVOKER_REGION_SIZE);
+    g_assert_cmphex(revoker_readq(REVOKER_STATUS), ==,
+                    REVOKER_STATUS_BAD_RANGE);
+    g_assert_cmpuint(revoker_readq(REVOKER_REVOKED), ==, 0);
+    g_assert_true(qtest_cheri_tag_get(global_qtest, CAPS_ADDR));
+}
+
+int main(int argc, char **argv)
+{
+    int r;
+
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_start("-machine virt -bios none");
+
+    qtest_add_func("/cheri-revoker/id", test_id);
+    qtest_add_func("/cheri-revoker/sweep", test_sweep);
+    qtest_add_func("/cheri-revoker/bad-args", test_bad_args);
+
+    r = g_test_run();
+
+    qtest_end();
+
+    return r;
+}
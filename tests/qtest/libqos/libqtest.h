@@ -541,6 +541,41 @@ void qtest_bufwrite(QTestState *s, uint64_t addr,
  */
 void qtest_memset(QTestState *s, uint64_t addr, uint8_t patt, size_t size);
 
+/**
+ * qtest_cheri_tag_set:
+ * @s: #QTestState instance to operate on.
+ * @addr: Guest physical address of the capability.
+ *
+ * Set the CHERI tag of the capability at @addr without checking the data
+ * stored there. Only supported by CHERI targets.
+ */
+void qtest_cheri_tag_set(QTestState *s, uint64_t addr);
+
+/**
+ * qtest_cheri_tag_get:
+ * @s: #QTestState instance to operate on.
+ * @addr: Guest physical address of the capability.
+ *
+ * Read the CHERI tag of the capability at @addr. Only supported by CHERI
+ * targets.
+ *
+ * Returns: Whether the capability is tagged.
+ */
+bool qtest_cheri_tag_get(QTestState *s, uint64_t addr);
+
+/**
+ * qtest_cheri_tag_invalidate:
+ * @s: #QTestState instance to operate on.
+ * @addr: Guest physical address to start at.
+ * @size: Number of bytes.
+ * @count: Number of times to repeat the invalidation.
+ *
+ * Clear the CHERI tags of a range of guest memory as a DMA write to it would,
+ * @count times in a row. Only supported by CHERI targets.
+ */
+void qtest_cheri_tag_invalidate(QTestState *s, uint64_t addr, size_t size,
+                                uint64_t count);
+
 /**
  * qtest_clock_step_next:
  * @s: #QTestState instance to operate on.
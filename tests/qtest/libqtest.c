@@ -1252,6 +1252,25 @@ void qtest_memset(QTestState *s, uint64_t addr, uint8_t pattern, size_t size)
     qtest_rsp(s);
 }
 
+void qtest_cheri_tag_set(QTestState *s, uint64_t addr)
+{
+    qtest_sendf(s, "cheri_tag_set 0x%" PRIx64 "\n", addr);
+    qtest_rsp(s);
+}
+
+bool qtest_cheri_tag_get(QTestState *s, uint64_t addr)
+{
+    return qtest_read(s, "cheri_tag_get", addr);
+}
+
+void qtest_cheri_tag_invalidate(QTestState *s, uint64_t addr, size_t size,
+                                uint64_t count)
+{
+    qtest_sendf(s, "cheri_tag_invalidate 0x%" PRIx64 " 0x%zx 0x%" PRIx64 "\n",
+                addr, size, count);
+    qtest_rsp(s);
+}
+
 void qtest_qmp_assert_success(QTestState *qts, const char *fmt, ...)
 {
     va_list ap;
@@ -0,0 +1,272 @@
+/*
+ * Replay an instruction trace against QEMU in RVFI-DII mode
+ *
+ * Connects to a QEMU started with -rvfi-dii-port (and optionally
+ * -rvfi-dii-shm), injects the instructions from a file (one hex instruction
+ * word per line, '#' starts a comment) after a reset, and reads back one v2
+ * trace per instruction. This is a minimal stand-in for TestRIG that can be
+ * used to compare the socket and shared-memory transports.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qemu/error-report.h"
+#include "qemu/processor.h"
+#include "qemu/sockets.h"
+#include <sys/mman.h>
+#include "rvfi_dii.h"
+
+/* At most this many commands are queued before reading the traces back */
+#define BATCH_SIZE 1024
+
+static int sock_fd = -1;
+static struct rvfi_dii_shm_header *shm;
+static struct rvfi_dii_ring_map shm_commands, shm_traces;
+static bool verbose;
+
+static void transport_read(void *buf, size_t len)
+{
+    while (len) {
+        ssize_t n;
+        if (shm) {
+            n = rvfi_dii_ring_read(&shm_traces, buf, len);
+            if (!n) {
+                cpu_relax();
+            }
+        } else {
+            n = read(sock_fd, buf, len);
+            if (n <= 0) {
+                fprintf(stderr, "EOF/error reading from QEMU: %s\n",
+                        strerror(errno));
+                exit(1);
+            }
+        }
+        buf = (uint8_t *)buf + n;
+        len -= n;
+    }
+}
+
+static void transport_write(const void *buf, size_t len)
+{
+    while (len) {
+        ssize_t n;
+        if (shm) {
+            n = rvfi_dii_ring_write(&shm_commands, buf, len);
+            if (!n) {
+                cpu_relax();
+            }
+        } else {
+            n = write(sock_fd, buf, len);
+            if (n <= 0) {
+                fprintf(stderr, "Error writing to QEMU: %s\n", strerror(errno));
+                exit(1);
+            }
+        }
+        buf = (const uint8_t *)buf + n;
+        len -= n;
+    }
+}
+
+static void send_command(uint8_t cmd, uint32_t insn)
+{
+    rvfi_dii_command_t c = { .rvfi_dii_insn = insn, .rvfi_dii_cmd = cmd };
+    transport_write(&c, sizeof(c));
+}
+
+/* Reads a version or shm-ring response: an 8 byte tag followed by a value */
+static uint64_t read_response(const char *tag, bool from_socket)
+{
+    struct {
+        char msg[8];
+        uint64_t value;
+    } response;
+    struct rvfi_dii_shm_header *saved = shm;
+
+    if (from_socket) {
+        shm = NULL;
+    }
+    transport_read(&response, sizeof(response));
+    shm = saved;
+    if (memcmp(response.msg, tag, sizeof(response.msg)) != 0) {
+        fprintf(stderr, "Unexpected response, expected '%s'\n", tag);
+        exit(1);
+    }
+    return response.value;
+}
+
+static void read_trace(void)
+{
+    struct rvfi_dii_trace_v2 trace;
+    uint8_t extra[256];
+
+    transport_read(&trace, sizeof(trace));
+    if (memcmp(trace.magic, "trace-v2", sizeof(trace.magic)) != 0 ||
+        trace.trace_size < sizeof(trace) ||
+        trace.trace_size - sizeof(trace) > sizeof(extra)) {
+        fprintf(stderr, "Invalid trace packet\n");
+        exit(1);
+    }
+    transport_read(extra, trace.trace_size - sizeof(trace));
+    if (verbose) {
+        printf("%6" PRIu64 " pc=0x%016" PRIx64 " insn=0x%08" PRIx64
+               " trap=%u halt=%u\n",
+               trace.basic_info.rvfi_order, trace.pc_data.rvfi_pc_rdata,
+               trace.basic_info.rvfi_insn, trace.basic_info.rvfi_trap,
+               trace.basic_info.rvfi_halt);
+    }
+}
+
+static void map_shm(const char *path)
+{
+    send_command('s', 0);
+    uint64_t size = read_response("shm-ring", true);
+    if (!size) {
+        fprintf(stderr, "QEMU declined shared memory, using the socket\n");
+        return;
+    }
+    if (size < sizeof(struct rvfi_dii_shm_header)) {
+        fprintf(stderr, "Shared memory too small: %" PRIu64 " bytes\n", size);
+        exit(1);
+    }
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED ||
+        memcmp(ptr, RVFI_DII_SHM_MAGIC, strlen(RVFI_DII_SHM_MAGIC)) != 0) {
+        fprintf(stderr, "Cannot map %s\n", path);
+        exit(1);
+    }
+    struct rvfi_dii_shm_header *header = ptr;
+    if (!rvfi_dii_ring_attach(&shm_commands, header, &header->commands,
+                              size) ||
+        !rvfi_dii_ring_attach(&shm_traces, header, &header->traces, size)) {
+        fprintf(stderr, "Invalid ring layout in %s\n", path);
+        exit(1);
+    }
+    shm = header;
+}
+
+static size_t load_trace(const char *path, uint32_t **insns)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    size_t n = 0, allocated = 0;
+
+    if (!f) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char *end;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        unsigned long insn = strtoul(line, &end, 16);
+        if (end == line) {
+            continue;
+        }
+        if (n == allocated) {
+            allocated = MAX(16, allocated * 2);
+            *insns = g_renew(uint32_t, *insns, allocated);
+        }
+        (*insns)[n++] = insn;
+    }
+    fclose(f);
+    return n;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [-v] [-p port] [-s shm-file] [-r repeat] trace-file\n"
+            " -p = TCP port passed to -rvfi-dii-port (default: 6000)\n"
+            " -s = file passed to -rvfi-dii-shm to use shared memory\n"
+            " -r = number of times to replay the trace (default: 1)\n"
+            " -v = print every trace packet\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *port = "6000";
+    const char *shm_path = NULL;
+    unsigned long repeat = 1;
+    uint32_t *insns = NULL;
+    Error *err = NULL;
+    int c;
+
+    while ((c = getopt(argc, argv, "hvp:s:r:")) != -1) {
+        switch (c) {
+        case 'v':
+            verbose = true;
+            break;
+        case 'p':
+            port = optarg;
+            break;
+        case 's':
+            shm_path = optarg;
+            break;
+        case 'r':
+            repeat = strtoul(optarg, NULL, 0);
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    size_t ninsns = load_trace(argv[optind], &insns);
+
+    g_autofree char *address = g_strdup_printf("localhost:%s", port);
+    sock_fd = inet_connect(address, &err);
+    if (sock_fd < 0) {
+        error_report_err(err);
+        return 1;
+    }
+    if (shm_path) {
+        map_shm(shm_path);
+    }
+    send_command('v', 2);
+    read_response("version=", false);
+
+    int64_t start = g_get_monotonic_time();
+    for (unsigned long i = 0; i < repeat; i++) {
+        /*
+         * Queue whole batches of instructions before reading the traces back.
+         * The batches are small enough that neither direction can fill up
+         * while the other side is blocked.
+         */
+        send_command(0, 0);
+        read_trace();
+        for (size_t j = 0; j < ninsns; j += BATCH_SIZE) {
+            size_t batch = MIN(BATCH_SIZE, ninsns - j);
+            for (size_t k = 0; k < batch; k++) {
+                send_command(1, insns[j + k]);
+            }
+            for (size_t k = 0; k < batch; k++) {
+                read_trace();
+            }
+        }
+    }
+    int64_t elapsed = g_get_monotonic_time() - start;
+
+    printf("%lu x %zu instructions via %s in %" PRId64 " us (%.0f insns/s)\n",
+           repeat, ninsns, shm ? "shared memory" : "socket", elapsed,
+           (double)repeat * ninsns * G_USEC_PER_SEC / MAX(elapsed, 1));
+    send_command('Q', 0);
+    g_free(insns);
+    return 0;
+}
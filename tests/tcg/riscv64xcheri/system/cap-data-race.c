@@ -0,0 +1,48 @@
+/*
+ * Data stores racing with capability loads
+ *
+ * The writer alternately stores a tagged capability and overwrites one half
+ * of it with plain data. A reader must never see a tag together with the
+ * overwritten data: every load returns either the original capability or an
+ * untagged value.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "litmus.h"
+
+static char buf[64] __attribute__((aligned(64)));
+static cap_t volatile slot;
+
+void litmus_main(unsigned long hartid)
+{
+    cap_t a = make_cap(buf, sizeof(buf), 8);
+    volatile uint64_t *words = (volatile uint64_t *)&slot;
+    int errors = 0;
+
+    if (hartid >= NR_HARTS) {
+        return;
+    }
+    slot = a;
+    litmus_start(hartid);
+
+    if (hartid == 0) {
+        for (int i = 0; i < ITERATIONS; i++) {
+            slot = a;
+            /* Alternate between the address and the metadata half */
+            words[i & 1] = 0xffffffffffffffffULL;
+        }
+        writer_finish();
+    }
+
+    while (!__atomic_load_n(&litmus_done, __ATOMIC_RELAXED)) {
+        cap_t c = slot;
+
+        if (__builtin_cheri_tag_get(c) && !same_cap(c, a)) {
+            report_bad_cap("tagged capability with data bytes", c);
+            errors++;
+        }
+    }
+    reader_finish(errors);
+}
@@ -0,0 +1,47 @@
+/*
+ * Capability stores racing with capability loads
+ *
+ * The writer alternately stores two different tagged capabilities to the
+ * same location while the readers load it. Every load must return exactly
+ * one of the two capabilities: a mix of the metadata of one and the address
+ * of the other, or a tag paired with stale data, is a failure.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "litmus.h"
+
+static char buf_a[64] __attribute__((aligned(64)));
+static char buf_b[256] __attribute__((aligned(256)));
+static cap_t volatile slot;
+
+void litmus_main(unsigned long hartid)
+{
+    cap_t a = make_cap(buf_a, sizeof(buf_a), 8);
+    cap_t b = make_cap(buf_b, sizeof(buf_b), 200);
+    int errors = 0;
+
+    if (hartid >= NR_HARTS) {
+        return;
+    }
+    slot = a;
+    litmus_start(hartid);
+
+    if (hartid == 0) {
+        for (int i = 0; i < ITERATIONS; i++) {
+            slot = (i & 1) ? b : a;
+        }
+        writer_finish();
+    }
+
+    while (!__atomic_load_n(&litmus_done, __ATOMIC_RELAXED)) {
+        cap_t c = slot;
+
+        if (!same_cap(c, a) && !same_cap(c, b)) {
+            report_bad_cap("torn capability", c);
+            errors++;
+        }
+    }
+    reader_finish(errors);
+}
@@ -0,0 +1,125 @@
+/*
+ * Helpers for the CHERI-RISC-V MTTCG litmus tests
+ *
+ * Hart 0 is the writer and all other harts are readers. The tests run on
+ * the virt machine: output goes to the NS16550 UART and the result is
+ * reported through the SiFive test device, which makes QEMU exit.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef LITMUS_H
+#define LITMUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NR_HARTS   4
+#define ITERATIONS 200000
+
+#define VIRT_UART  0x10000000UL
+#define VIRT_TEST  0x100000UL
+#define TEST_PASS  0x5555
+#define TEST_FAIL  0x3333
+
+typedef void * __capability cap_t;
+
+static volatile int litmus_ready;
+static volatile int litmus_done;
+static volatile int litmus_finished;
+static volatile int litmus_errors;
+
+static void ml_puts(const char *s)
+{
+    volatile uint8_t *uart = (volatile uint8_t *)VIRT_UART;
+
+    while (*s) {
+        *uart = *s++;
+    }
+}
+
+static void ml_putx(uint64_t v)
+{
+    char buf[19] = "0x";
+
+    for (int i = 0; i < 16; i++) {
+        buf[2 + i] = "0123456789abcdef"[(v >> (60 - 4 * i)) & 0xf];
+    }
+    buf[18] = '\0';
+    ml_puts(buf);
+}
+
+static void __attribute__((noreturn)) litmus_exit(int errors)
+{
+    volatile uint32_t *test = (volatile uint32_t *)VIRT_TEST;
+
+    ml_puts(errors ? "FAIL\n" : "PASS\n");
+    *test = errors ? (errors << 16) | TEST_FAIL : TEST_PASS;
+    for (;;) {
+    }
+}
+
+/* Derive a capability for @len bytes at @p from DDC, with cursor @p + @off */
+static inline cap_t make_cap(void *p, uint64_t len, uint64_t off)
+{
+    cap_t c = __builtin_cheri_global_data_get();
+
+    c = __builtin_cheri_address_set(c, (uint64_t)p);
+    c = __builtin_cheri_bounds_set_exact(c, len);
+    return __builtin_cheri_offset_increment(c, off);
+}
+
+static inline bool same_cap(cap_t a, cap_t b)
+{
+    return __builtin_cheri_tag_get(a) == __builtin_cheri_tag_get(b) &&
+           __builtin_cheri_base_get(a) == __builtin_cheri_base_get(b) &&
+           __builtin_cheri_length_get(a) == __builtin_cheri_length_get(b) &&
+           __builtin_cheri_address_get(a) == __builtin_cheri_address_get(b) &&
+           __builtin_cheri_perms_get(a) == __builtin_cheri_perms_get(b);
+}
+
+static void report_bad_cap(const char *what, cap_t c)
+{
+    ml_puts(what);
+    ml_puts(": base=");
+    ml_putx(__builtin_cheri_base_get(c));
+    ml_puts(" len=");
+    ml_putx(__builtin_cheri_length_get(c));
+    ml_puts(" addr=");
+    ml_putx(__builtin_cheri_address_get(c));
+    ml_puts("\n");
+}
+
+/* Readers call this after they are done and never return. */
+static void __attribute__((noreturn)) reader_finish(int errors)
+{
+    __atomic_fetch_add(&litmus_errors, errors, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&litmus_finished, 1, __ATOMIC_SEQ_CST);
+    for (;;) {
+    }
+}
+
+/* Called by the writer to wait for the readers and report the result. */
+static void __attribute__((noreturn)) writer_finish(void)
+{
+    __atomic_store_n(&litmus_done, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&litmus_finished, __ATOMIC_SEQ_CST) <
+           NR_HARTS - 1) {
+    }
+    litmus_exit(litmus_errors);
+}
+
+/* Hart 0 waits for all readers before it starts writing. */
+static void litmus_start(unsigned long hartid)
+{
+    if (hartid == 0) {
+        while (__atomic_load_n(&litmus_ready, __ATOMIC_SEQ_CST) <
+               NR_HARTS - 1) {
+        }
+    } else {
+        __atomic_fetch_add(&litmus_ready, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+#endif /* LITMUS_H */
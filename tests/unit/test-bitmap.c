@@ -123,6 +123,59 @@ static void check_bitmap_set(void)
     bitmap_set_case(bitmap_set_atomic);
 }
 
+typedef void (*bmap_clear_func)(unsigned long *map, long i, long len);
+static void bitmap_clear_case(bmap_clear_func clear_func)
+{
+    unsigned long *bmap;
+    int offset;
+
+    bmap = bitmap_new(BMAP_SIZE);
+
+    /* Clear one bit at offset in second word */
+    for (offset = 0; offset <= BITS_PER_LONG; offset++) {
+        bitmap_set(bmap, 0, BMAP_SIZE);
+        clear_func(bmap, BITS_PER_LONG + offset, 1);
+        g_assert_cmpint(find_first_zero_bit(bmap, 2 * BITS_PER_LONG),
+                        ==, BITS_PER_LONG + offset);
+        g_assert_cmpint(find_next_bit(bmap, 3 * BITS_PER_LONG,
+                                      BITS_PER_LONG + offset),
+                        ==, BITS_PER_LONG + offset + 1);
+    }
+
+    for (offset = 0; offset <= BITS_PER_LONG; offset++) {
+        bitmap_set(bmap, 0, BMAP_SIZE);
+        /* End Aligned, clear bits [BITS_PER_LONG - offset, 3*BITS_PER_LONG] */
+        clear_func(bmap, BITS_PER_LONG - offset, 2 * BITS_PER_LONG + offset);
+        g_assert_cmpuint(bmap[1], ==, 0);
+        g_assert_cmpuint(bmap[2], ==, 0);
+        g_assert_cmpint(find_first_zero_bit(bmap, BITS_PER_LONG),
+                        ==, BITS_PER_LONG - offset);
+        g_assert_cmpint(find_next_bit(bmap, 4 * BITS_PER_LONG,
+                                      BITS_PER_LONG - offset),
+                        ==, 3 * BITS_PER_LONG);
+    }
+
+    for (offset = 0; offset <= BITS_PER_LONG; offset++) {
+        bitmap_set(bmap, 0, BMAP_SIZE);
+        /* Start Aligned, clear bits [BITS_PER_LONG, 3*BITS_PER_LONG + offset] */
+        clear_func(bmap, BITS_PER_LONG, 2 * BITS_PER_LONG + offset);
+        g_assert_cmpuint(bmap[0], ==, -1ul);
+        g_assert_cmpuint(bmap[1], ==, 0);
+        g_assert_cmpuint(bmap[2], ==, 0);
+        g_assert_cmpint(find_next_bit(bmap, 4 * BITS_PER_LONG + 1,
+                                      BITS_PER_LONG),
+                        ==, 3 * BITS_PER_LONG + offset);
+    }
+
+    g_free(bmap);
+}
+
+static void check_bitmap_clear(void)
+{
+    bitmap_clear_case(bitmap_clear);
+    bitmap_clear_case(bitmap_clear_atomic);
+}
+
 int main(int argc, char **argv)
 {
     g_test_init(&argc, &argv, NULL);
@@ -131,6 +184,8 @@ int main(int argc, char **argv)
                     check_bitmap_copy_with_offset);
     g_test_add_func("/bitmap/bitmap_set",
                     check_bitmap_set);
+    g_test_add_func("/bitmap/bitmap_clear",
+                    check_bitmap_clear);
 
     g_test_run();
 
@@ -240,6 +240,41 @@ void bitmap_clear(unsigned long *map, long start, long nr)
     }
 }
 
+void bitmap_clear_atomic(unsigned long *map, long start, long nr)
+{
+    unsigned long *p = map + BIT_WORD(start);
+    const long size = start + nr;
+    int bits_to_clear = BITS_PER_LONG - (start % BITS_PER_LONG);
+    unsigned long mask_to_clear = BITMAP_FIRST_WORD_MASK(start);
+
+    assert(start >= 0 && nr >= 0);
+
+    /* First word */
+    if (nr - bits_to_clear > 0) {
+        qatomic_and(p, ~mask_to_clear);
+        nr -= bits_to_clear;
+        bits_to_clear = BITS_PER_LONG;
+        mask_to_clear = ~0UL;
+        p++;
+    }
+
+    /* Full words */
+    if (bits_to_clear == BITS_PER_LONG && nr >= BITS_PER_LONG) {
+        memset(p, 0, BIT_WORD(nr) * sizeof(unsigned long));
+        p += BIT_WORD(nr);
+        nr %= BITS_PER_LONG;
+    }
+
+    /* Last word */
+    if (nr) {
+        mask_to_clear &= BITMAP_LAST_WORD_MASK(size);
+        qatomic_and(p, ~mask_to_clear);
+    } else {
+        /* See bitmap_set_atomic() */
+        smp_mb();
+    }
+}
+
 bool bitmap_test_and_clear_atomic(unsigned long *map, long start, long nr)
 {
     unsigned long *p = map + BIT_WORD(start);